@@ -0,0 +1,139 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Checks that training and testing do not allocate memory. Trains and
+					tests the offline and online sample networks with every verbosity
+					flag, the asynchronous log, the results file, the flight recorder
+					and a 3D plot, and counts the allocations made inside the guards
+					of CALMAllocGuard. Must be built, with the library, with
+					CALM_ALLOC_CHECK=1; "make check-alloc" does both. The exit status
+					is 1 if anything was allocated.
+
+					Usage: AllocCheck simdir
+
+					The outputs are written into the copies of the simulations in
+					simdir, which should not be the bundled ones.
+*/
+
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include "CALMGlobal.h"
+#include "CALM.h"
+#include "Rnd.h"
+
+using namespace std;
+
+#if ! CALM_ALLOC_CHECK
+#error AllocCheck must be built with CALM_ALLOC_CHECK=1
+#endif
+
+#define kEpochs			30			// epochs each network is trained for
+#define kRecorder		5			// iterations kept by the flight recorder
+
+CALMAPI*		gCALMAPI;		// pointer to API interface
+static int* volatile sProbe;	// so the allocation of the self test is not optimized away
+
+
+// Trains and tests the network in "dirname", with all output on.
+// Returns the number of allocations made inside the guards, or -1 if it could not be set up.
+long RunNetwork( const char* dirname, bool online )
+{
+	long		violations;
+	int			calmErr;
+
+	// the files of the verbosity flags and the plots are written to the current directory
+	if ( chdir( dirname ) != 0 ) return -1;
+	gCALMAPI = new CALMAPI;
+	ofstream log( "alloc.log" );
+	gCALMAPI->CALMSetDirectory( (char*)dirname );
+	gCALMAPI->CALMSetVerbosity( O_NONE );
+	gCALMAPI->SetCALMLog( &log );
+	SetSeed( 4242 );
+	if ( gCALMAPI->CALMLoadParameters() != kNoErr ) return -1;
+	gCALMAPI->CALMSetupNetwork( &calmErr );
+	if ( calmErr != kNoErr ) return -1;
+	if ( online )
+		gCALMAPI->CALMOnlinePatterns();
+	else if ( gCALMAPI->CALMLoadPatterns() != kNoErr )
+		return -1;
+
+	gCALMAPI->CALMSetVerbosity( O_WINNER | O_ACTASIS | O_ACTPLUS | O_POT | O_WEIGHTS | O_SAVEDWT | O_SAVEACT | O_SAVEMU );
+	gCALMAPI->CALMSetAsyncLog( true );
+	if ( gCALMAPI->CALMOpenResults( "alloc" ) != kNoErr ) return -1;
+	if ( gCALMAPI->CALMSetFlightRecorder( kRecorder, "alloc" ) != kNoErr ) return -1;
+	gCALMAPI->CALMInit3DPlot( "pat", online ? "B" : "out" );
+
+	violations = CALMAllocGuard::GetViolations();
+	for ( int epoch = 0; epoch < kEpochs; epoch++ )
+	{
+		if ( online )
+		{
+			for ( int i = 0; i < gCALMAPI->CALMGetInputLen(); i++ )
+				gCALMAPI->CALMSetOnlineInput( i, PseudoRNG() );
+			gCALMAPI->CALMTrainSingle( epoch );
+			gCALMAPI->CALMTestSingle( epoch );
+			gCALMAPI->CALMTest( 0 );
+		}
+		else
+			gCALMAPI->CALMTrainFile( epoch );
+		{
+			ALLOC_GUARD( "CALM3DPlot" );
+			gCALMAPI->CALM3DPlot();
+		}
+	}
+	if ( ! online ) gCALMAPI->CALMTestFile( 0 );
+	violations = CALMAllocGuard::GetViolations() - violations;
+
+	gCALMAPI->CALMEnd3DPlot();
+	gCALMAPI->CALMCloseResults();
+	delete gCALMAPI;
+	return violations;
+}
+
+
+int main( int argc, char *argv[] )
+{
+	static const char* names[] = { "offline", "online" };
+	char		simDir[PATH_MAX];
+	char		dirname[PATH_MAX+16];
+	long		violations;
+	int			failures = 0;
+
+	if ( argc != 2 )
+	{
+		cerr << "Usage: AllocCheck simdir" << endl;
+		return 1;
+	}
+	// the check changes directories, so the path is made absolute
+	if ( realpath( argv[1], simDir ) == NULL )
+	{
+		cerr << "Could not find " << argv[1] << endl;
+		return 1;
+	}
+	CALMAllocGuard::SetFatal( false );
+
+	// the check itself must see an allocation inside a guard
+	{
+		ALLOC_GUARD( "self test" );
+		sProbe = new int[3];
+	}
+	delete[] sProbe;
+	if ( CALMAllocGuard::GetViolations() != 1 )
+	{
+		cerr << "The library was not built with CALM_ALLOC_CHECK=1" << endl;
+		return 1;
+	}
+
+	for ( int i = 0; i < 2; i++ )
+	{
+		snprintf( dirname, PATH_MAX+16, "%s/%s", simDir, names[i] );
+		violations = RunNetwork( dirname, i == 1 );
+		if ( violations < 0 ) cerr << "Could not set up " << dirname << endl;
+		else cout << names[i] << ": " << violations << " allocations" << endl;
+		if ( violations != 0 ) failures++;
+	}
+	return ( failures > 0 ) ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	The clock shared by the benchmarks: seconds from a monotonic clock,
+					for timing stretches of a run.
+*/
+
+#ifndef __BENCHTIME__
+#define __BENCHTIME__
+
+#include <time.h>
+
+inline double Now( void )
+{
+	struct timespec t;
+
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,252 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Benchmark of growing and pruning modules, on synthetic networks (see
+					SynthNet.h) of increasing size and connectivity. After one epoch of
+					training, which is timed as well, every CALM module in turn is grown
+					by a few nodes and pruned back to its size, at a node in the middle,
+					for a number of cycles. The results are printed as JSON, with the
+					time per resize, the number of calls of operator new and the bytes
+					taken from the network's arena per resize, separately for growing
+					and pruning, and the time of a resize relative to an epoch.
+
+					Usage: ChurnBench [-m modules] [-n sizes] [-f fanins] [-c cycles] [-g depth]
+									  [-t iterations] [-o file] [generator options]
+
+					-m, -n and -f take a list of values separated by commas.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <new>
+#include <iostream>
+#include <fstream>
+#include "CALMGlobal.h"
+#include "CALM.h"
+#include "CALMNetwork.h"
+#include "Rnd.h"
+#include "SynthNet.h"
+#include "BenchTime.h"
+
+using namespace std;
+
+#define kMaxValues		32		// values per list
+
+CALMAPI*		gCALMAPI;		// pointer to API interface
+static long		sAllocations = 0;	// calls of operator new
+
+
+// every allocation of the process, including those of the library, is counted
+void* operator new( size_t size )
+{
+	void* p;
+
+	sAllocations++;
+	p = malloc( size > 0 ? size : 1 );
+	if ( p == NULL ) throw bad_alloc();
+	return p;
+}
+
+void* operator new[]( size_t size ) { return operator new( size ); }
+void operator delete( void* p ) noexcept { free( p ); }
+void operator delete[]( void* p ) noexcept { free( p ); }
+void operator delete( void* p, size_t ) noexcept { free( p ); }
+void operator delete[]( void* p, size_t ) noexcept { free( p ); }
+
+
+struct ResizeCost
+{
+	long		count;
+	double		seconds;
+	long		allocations;
+	double		arenaBytes;
+};
+
+
+int ParseList( char* arg, int* values )
+{
+	int num = 0;
+
+	for ( char* value = strtok( arg, "," ); value != NULL && num < kMaxValues; value = strtok( NULL, "," ) )
+		values[num++] = Max( atoi( value ), 1 );
+	return num;
+}
+
+
+// resize a module and add the time, allocations and arena use to "cost"
+void TimeResize( CALMNetwork* net, int idx, int newsize, int node, ResizeCost* cost )
+{
+	long	allocations = sAllocations;
+	size_t	used = net->GetArena()->GetUsed();
+	double	start = Now();
+
+	net->ResizeModule( idx, newsize, node );
+	cost->seconds += Now() - start;
+	cost->allocations += sAllocations - allocations;
+	cost->arenaBytes += net->GetArena()->GetUsed() - used;
+	cost->count++;
+}
+
+
+// Trains the network in "dirname" for an epoch and returns its duration, then
+// grows and prunes every CALM module "cycles" times by "depth" nodes
+double ChurnNetwork( char* dirname, int iterations, int cycles, int depth, ResizeCost* grow, ResizeCost* prune )
+{
+	ofstream		log( "/dev/null" );
+	CALMNetwork*	net;
+	double			start, epoch;
+	int				calmErr, idx, size, i, c, d;
+
+	gCALMAPI = new CALMAPI;
+	gCALMAPI->CALMSetDirectory( dirname );
+	gCALMAPI->CALMSetBasename( (char*)"synth" );
+	gCALMAPI->CALMSetVerbosity( O_NONE );
+	gCALMAPI->CALMSetNumIterations( iterations );
+	gCALMAPI->SetCALMLog( &log );
+	SetSeed( 1 );
+	if ( gCALMAPI->CALMLoadParameters() != kNoErr ) return 0.0;
+	gCALMAPI->CALMSetupNetwork( &calmErr );
+	if ( calmErr != kNoErr || gCALMAPI->CALMLoadPatterns() != kNoErr ) return 0.0;
+	gCALMAPI->CALMPatternOrder( kPermuted );
+	gCALMAPI->CALMReset( O_WT | O_TIME | O_WIN );
+	gCALMAPI->CALMPermutePatterns();
+	gCALMAPI->CALMTrainFile( 0 );
+	start = Now();
+	gCALMAPI->CALMPermutePatterns();
+	gCALMAPI->CALMTrainFile( 1 );
+	epoch = Now() - start;
+
+	net = gCALMAPI->CALMGetNetwork();
+	memset( grow, 0, sizeof(ResizeCost) );
+	memset( prune, 0, sizeof(ResizeCost) );
+	for ( c = 0; c < cycles; c++ )
+	{
+		for ( i = 0; i < net->GetNumModules(); i++ )
+		{
+			idx = net->GetNumInputs() + i;
+			if ( net->GetModule( idx )->GetModuleType() == O_MAP ) continue;
+			size = net->GetModuleSize( idx );
+			for ( d = 1; d <= depth; d++ ) TimeResize( net, idx, size + d, kUndefined, grow );
+			for ( d = depth - 1; d >= 0; d-- ) TimeResize( net, idx, size + d, ( size + d ) / 2, prune );
+		}
+	}
+	delete gCALMAPI;
+	return epoch;
+}
+
+
+void Usage( void )
+{
+	cerr << "Usage: ChurnBench [-m modules] [-n sizes] [-f fanins] [-c cycles] [-g depth] [-t iterations] [-o file] [generator options]" << endl;
+	cerr << "\t-m : numbers of CALM modules (default 4,16)" << endl;
+	cerr << "\t-n : module sizes (default 8,32,128)" << endl;
+	cerr << "\t-f : incoming connections per module (default 1,2,4)" << endl;
+	cerr << "\t-c : grow and prune cycles per module (default 20)" << endl;
+	cerr << "\t-g : nodes grown and pruned per cycle (default 1)" << endl;
+	cerr << "\t-t : iterations per pattern in the epoch of training (default 20)" << endl;
+	cerr << "\t-o : write the results to a file instead of stdout" << endl;
+	cerr << "generator options for the other settings:" << endl;
+	SynthUsage();
+	exit( 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+	static char	defaultModules[] = "4,16", defaultSizes[] = "8,32,128", defaultFanIns[] = "1,2,4";
+	SynthSpec	spec;
+	ResizeCost	grow, prune;
+	ofstream	outfile;
+	ostream*	os = &cout;
+	char		dirname[PATH_MAX];
+	char		filename[PATH_MAX];
+	int			modules[kMaxValues], sizes[kMaxValues], fanIns[kMaxValues];
+	int			numModules = 0, numSizes = 0, numFanIns = 0;
+	int			cycles = 20, depth = 1, iterations = 20;
+	int			m, n, f, numResizable;
+	double		weights, epoch, resize;
+	bool		first = true, ok = true;
+
+	SynthDefaults( &spec );
+	for ( int arg = 1; arg < argc; arg += 2 )
+	{
+		if ( argv[arg][0] != '-' || arg + 1 >= argc ) Usage();
+		switch ( argv[arg][1] )
+		{
+			case 'm': numModules = ParseList( argv[arg+1], modules ); break;
+			case 'n': numSizes = ParseList( argv[arg+1], sizes ); break;
+			case 'f': numFanIns = ParseList( argv[arg+1], fanIns ); break;
+			case 'c': cycles = Max( atoi( argv[arg+1] ), 1 ); break;
+			case 'g': depth = Max( atoi( argv[arg+1] ), 1 ); break;
+			case 't': iterations = Max( atoi( argv[arg+1] ), 1 ); break;
+			case 'o':
+				outfile.open( argv[arg+1] );
+				if ( outfile.fail() )
+				{
+					cerr << "Could not create " << argv[arg+1] << endl;
+					return 1;
+				}
+				os = &outfile;
+				break;
+			default: if ( ! SynthOption( &spec, argv[arg][1], argv[arg+1] ) ) Usage();
+		}
+	}
+	if ( numModules == 0 ) numModules = ParseList( defaultModules, modules );
+	if ( numSizes == 0 ) numSizes = ParseList( defaultSizes, sizes );
+	if ( numFanIns == 0 ) numFanIns = ParseList( defaultFanIns, fanIns );
+
+	snprintf( dirname, PATH_MAX, "/tmp/ChurnBench-%d", (int)getpid() );
+	if ( mkdir( dirname, 0755 ) != 0 )
+	{
+		cerr << "Could not create " << dirname << endl;
+		return 1;
+	}
+
+	*os << "{\n\t\"benchmark\": \"ChurnBench\",\n\t\"cycles\": " << cycles << ",\n\t\"depth\": " << depth;
+	*os << ",\n\t\"results\": [";
+	for ( m = 0; m < numModules && ok; m++ )
+		for ( n = 0; n < numSizes && ok; n++ )
+			for ( f = 0; f < numFanIns && ok; f++ )
+			{
+				spec.numModules = modules[m];
+				spec.moduleSize = sizes[n];
+				spec.fanIn = fanIns[f];
+				numResizable = spec.numModules - Min( spec.numMaps, spec.numModules );
+				if ( ! SynthWrite( &spec, dirname, "synth", &weights ) ||
+					 ( epoch = ChurnNetwork( dirname, iterations, cycles, depth, &grow, &prune ) ) == 0.0 )
+				{
+					cerr << "Could not generate or train the network in " << dirname << endl;
+					ok = false;
+					break;
+				}
+				resize = ( grow.seconds + prune.seconds ) / Max( grow.count + prune.count, 1 );
+				*os << ( first ? "\n" : ",\n" );
+				*os << "\t\t{ \"modules\": " << spec.numModules << ", \"size\": " << spec.moduleSize;
+				*os << ", \"fanin\": " << spec.fanIn << ", \"weights\": " << weights;
+				*os << ", \"epoch_s\": " << epoch;
+				*os << ", \"grow_us\": " << grow.seconds * 1e6 / Max( grow.count, 1 );
+				*os << ", \"prune_us\": " << prune.seconds * 1e6 / Max( prune.count, 1 );
+				*os << ", \"grow_allocs\": " << (double)grow.allocations / Max( grow.count, 1 );
+				*os << ", \"prune_allocs\": " << (double)prune.allocations / Max( prune.count, 1 );
+				*os << ", \"grow_arena_bytes\": " << grow.arenaBytes / Max( grow.count, 1 );
+				*os << ", \"prune_arena_bytes\": " << prune.arenaBytes / Max( prune.count, 1 );
+				*os << ", \"resize_per_epoch\": " << resize / epoch;
+				*os << ", \"all_modules_per_epoch\": " << numResizable * resize / epoch << " }";
+				first = false;
+			}
+	*os << "\n\t]\n}" << endl;
+
+	const char* exts[] = { "net", "par", "pat" };
+	for ( int i = 0; i < 3; i++ )
+	{
+		snprintf( filename, PATH_MAX, "%s/synth.%s", dirname, exts[i] );
+		unlink( filename );
+	}
+	rmdir( dirname );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Microbenchmarks of the kernels that take most of the time in a
+					simulation: the weighted activation and learning rule of a connection,
+					the activation function of a node, the update of a CALM and a CALMMap
+					module, and the random number generator. Each kernel is timed on
+					modules of increasing size, receiving one connection from an input
+					module of the same size. The results are printed as JSON, one object
+					per kernel and size, with the time per call and the bytes and floating
+					point operations per call turned into GB/s and GFLOP/s. The byte counts
+					are those of the data structures touched, not of the memory traffic
+					measured, so GB/s is only meaningful for comparing runs.
+
+					Usage: KernelBench [-t seconds] [-s maxsize] [-o file]
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include "CALMGlobal.h"
+#include "Rnd.h"
+#include "CALMArena.h"
+#include "Connection.h"
+#include "Module.h"
+#include "ModuleMap.h"
+#include "BenchTime.h"
+
+using namespace std;
+
+#define kMinSize		4			// smallest module size
+#define kMaxSize		1024		// largest module size
+#define kRepeats		3			// the best of this many timings is reported
+#define kWarmUp			10			// module updates before timing
+
+
+// parameters of simulations/gibbons, which give bounded activations and weights
+static data_type sParameters[gNumPars] =
+{
+	0.5, -1.2, -10.0, -1.0, -0.6, 0.4, 1.0, 0.1, 0.6, 0.1, 0.1, 0.05, 1.0, 0.0,
+	1.0, 0.0001, 0.005, 0.5, 0.25, 1.0, 1.0, 0.1, 10.0, 0.0001, 0, 8.8, 10
+};
+
+// a module of a given size, with one connection from an input module of the same size
+struct BenchNetwork
+{
+	CALMArena*	arena;
+	Module*		input;
+	Module*		calm;
+	ModuleMap*	map;
+	RUnit*		units;
+};
+
+// what is known about a kernel apart from its time
+struct BenchKernel
+{
+	const char*	name;
+	double		bytes;			// bytes of data touched per call
+	double		flops;			// floating point operations per call
+};
+
+static double		sSeconds = 0.2;		// minimum duration of a timing
+volatile data_type	gSink;				// keeps results from being optimised away
+
+
+void NewNetwork( BenchNetwork* net, int size )
+{
+	char name[32];
+
+	net->arena = new CALMArena( kArenaChunk );
+	net->input = net->arena->New<Module>( 1, kMemModules );
+	strcpy( name, "inp" );
+	net->input->Initialize( size, name, sParameters, O_INP, 0, net->arena );
+	for ( int i = 0; i < size; i++ ) net->input->ClampUnit( i, PseudoRNG( 0.0, 1.0 ) );
+
+	net->calm = net->arena->New<Module>( 1, kMemModules );
+	strcpy( name, "calm" );
+	net->calm->Initialize( size, name, sParameters, O_CALM, 1, net->arena );
+	net->calm->SetNumConn( 1 );
+	net->calm->Connect( 0, net->input, kNormalLink, 0 );
+
+	net->map = net->arena->New<ModuleMap>( 1, kMemModules );
+	strcpy( name, "map" );
+	net->map->Initialize( size, name, sParameters, O_MAP, 2, net->arena );
+	net->map->SetNumConn( 1 );
+	net->map->Connect( 0, net->input, kNormalLink, 0 );
+
+	net->units = net->arena->New<RUnit>( size, kMemNodes );
+	for ( int i = 0; i < size; i++ )
+	{
+		net->units[i].SetParameter( sParameters );
+		net->units[i].SetActivation( PseudoRNG( -1.0, 1.0 ) );
+	}
+
+	// let the activations settle into the range of a simulation
+	for ( int t = 0; t < kWarmUp; t++ )
+	{
+		net->calm->UpdateActivation();
+		net->calm->SwapActs();
+		net->map->UpdateActivation();
+		net->map->SwapActs();
+	}
+}
+
+
+// calls the kernel for one row (or node) after another, reps times
+double RunKernel( int kernel, BenchNetwork* net, int size, long reps )
+{
+	Connection*	conn = net->calm->GetConnection( 0 );
+	data_type	sum = 0.0, dw_sum = 0.0;
+	double		start = Now();
+	long		r;
+	int			i;
+
+	switch ( kernel )
+	{
+		case 0:
+			for ( r = 0; r < reps; r++ )
+				for ( i = 0; i < size; i++ ) sum += conn->WeightedActivation( i );
+			break;
+		case 1:
+			for ( r = 0; r < reps; r++ )
+				for ( i = 0; i < size; i++ ) conn->UpdateNormal( i, 0.5, 0.001, 0.5, dw_sum );
+			sum = dw_sum;
+			break;
+		case 2:
+			for ( r = 0; r < reps; r++ )
+				for ( i = 0; i < size; i++ ) net->units[i].Update();
+			sum = net->units[0].GetActivation();
+			break;
+		case 3:
+			for ( r = 0; r < reps; r++ ) net->calm->UpdateActivation();
+			sum = net->calm->GetActivationA();
+			break;
+		case 4:
+			for ( r = 0; r < reps; r++ ) net->map->UpdateActivation();
+			sum = net->map->GetActivationA();
+			break;
+		case 5:
+			for ( r = 0; r < reps; r++ )
+				for ( i = 0; i < size; i++ ) sum += PseudoRNG();
+			break;
+	}
+	gSink = sum;
+	return Now() - start;
+}
+
+
+// Bytes and flops of a single call, that is, per row, node or module update.
+// A weight is read (and written by the learning rule) together with the
+// activation of the node it connects from; a module update also reads and
+// writes its R- and V-nodes, and a CALMMap reads its matrix of V-weights.
+void DescribeKernel( int kernel, int size, BenchKernel* k )
+{
+	double w = sizeof(CALMWeight), act = sizeof(RUnit), node = sizeof(RUnit) + sizeof(VUnit);
+
+	switch ( kernel )
+	{
+		case 0:
+			k->name = "Connection::WeightedActivation";
+			k->bytes = size * ( w + act );
+			k->flops = 2.0 * size;
+			break;
+		case 1:
+			k->name = "Connection::UpdateNormal";
+			k->bytes = size * ( 2.0 * w + act );
+			k->flops = 14.0 * size;
+			break;
+		case 2:
+			k->name = "CALMUnit::Update";
+			k->bytes = 3.0 * sizeof(data_type);
+			k->flops = 7.0;
+			break;
+		case 3:
+			k->name = "Module::UpdateActivation";
+			k->bytes = (double)size * size * ( w + act ) + 2.0 * size * node;
+			k->flops = 2.0 * size * size + 24.0 * size;
+			break;
+		case 4:
+			k->name = "ModuleMap::UpdateActivation";
+			k->bytes = (double)size * size * ( w + act + sizeof(data_type) + sizeof(VUnit) ) + 2.0 * size * node;
+			k->flops = 4.0 * size * size + 20.0 * size;
+			break;
+		case 5:
+			k->name = "PseudoRNG";
+			k->bytes = 0.0;
+			k->flops = 0.0;
+			break;
+	}
+}
+
+
+// number of kernel calls per repetition of RunKernel
+inline int CallsPerRep( int kernel, int size )
+{
+	return ( kernel == 3 || kernel == 4 ) ? 1 : size;
+}
+
+
+void Measure( ostream* os, int kernel, BenchNetwork* net, int size, bool first )
+{
+	BenchKernel	k;
+	long		reps = 1;
+	double		t, best;
+	double		calls, ns;
+
+	// double the repetitions until a timing takes long enough
+	while ( ( t = RunKernel( kernel, net, size, reps ) ) < sSeconds && reps < ( 1L << 40 ) )
+		reps = ( t < sSeconds / 16 ) ? reps * 8 : reps * 2;
+	best = t;
+	for ( int i = 1; i < kRepeats; i++ )
+	{
+		t = RunKernel( kernel, net, size, reps );
+		if ( t < best ) best = t;
+	}
+
+	DescribeKernel( kernel, size, &k );
+	calls = (double)reps * CallsPerRep( kernel, size );
+	ns = best * 1e9 / calls;
+	*os << ( first ? "\n" : ",\n" );
+	*os << "\t\t{ \"kernel\": \"" << k.name << "\", \"size\": " << size;
+	*os << ", \"calls\": " << (long)calls << ", \"ns_per_op\": " << ns;
+	*os << ", \"gb_per_s\": " << k.bytes / ns << ", \"gflop_per_s\": " << k.flops / ns << " }";
+}
+
+
+void Usage( void )
+{
+	cerr << "Usage: KernelBench [-t seconds] [-s maxsize] [-o file]" << endl;
+	cerr << "\t-t : minimum duration of each timing (default 0.2)" << endl;
+	cerr << "\t-s : largest module size (default " << kMaxSize << ")" << endl;
+	cerr << "\t-o : write the results to a file instead of stdout" << endl;
+	exit( 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+	BenchNetwork	net;
+	ofstream		outfile;
+	ostream*		os = &cout;
+	int				maxSize = kMaxSize;
+	bool			first = true;
+
+	for ( int arg = 1; arg < argc; arg++ )
+	{
+		if ( argv[arg][0] != '-' || arg + 1 >= argc ) Usage();
+		switch ( argv[arg][1] )
+		{
+			case 't': sSeconds = atof( argv[++arg] ); break;
+			case 's': maxSize = atoi( argv[++arg] ); break;
+			case 'o':
+				outfile.open( argv[++arg] );
+				if ( outfile.fail() )
+				{
+					cerr << "Could not create " << argv[arg] << endl;
+					return 1;
+				}
+				os = &outfile;
+				break;
+			default: Usage();
+		}
+	}
+
+	SetSeed( 1 );
+	*os << "{\n\t\"benchmark\": \"KernelBench\",\n\t\"data_type_size\": " << sizeof(data_type);
+	*os << ",\n\t\"seconds\": " << sSeconds << ",\n\t\"results\": [";
+	for ( int size = kMinSize; size <= maxSize; size *= 2 )
+	{
+		NewNetwork( &net, size );
+		for ( int kernel = 0; kernel < 6; kernel++ )
+		{
+			Measure( os, kernel, &net, size, first );
+			first = false;
+		}
+		delete net.arena;
+		cerr << "size " << size << " done" << endl;
+	}
+	*os << "\n\t]\n}" << endl;
+	return 0;
+}
@@ -0,0 +1,42 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Writes the network, parameter and pattern files of a synthetic
+					network (see SynthNet.h), to be used like the bundled simulations:
+
+						NetGen -m 16 -n 64 -f 3 -d 0.25 -M 2 simulations/synth calm
+						calm -r 1 -e 10 -i 50 -b calm -d simulations/synth -v 0
+*/
+
+#include <stdlib.h>
+#include <iostream>
+#include "CALMGlobal.h"
+#include "SynthNet.h"
+
+using namespace std;
+
+
+void Usage( void )
+{
+	cerr << "Usage: NetGen [options] directory basename" << endl;
+	SynthUsage();
+	exit( 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+	SynthSpec	spec;
+	double		weights;
+	int			arg;
+
+	SynthDefaults( &spec );
+	for ( arg = 1; arg < argc && argv[arg][0] == '-'; arg += 2 )
+		if ( arg + 1 >= argc || ! SynthOption( &spec, argv[arg][1], argv[arg+1] ) ) Usage();
+	if ( argc - arg != 2 ) Usage();
+
+	if ( ! SynthWrite( &spec, argv[arg], argv[arg+1], &weights ) ) return 1;
+	cout << argv[arg] << "/" << argv[arg+1] << ": " << spec.numModules << " modules, ";
+	cout << (long)weights << " weights" << endl;
+	return 0;
+}
@@ -0,0 +1,377 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Scaling benchmark on synthetic networks (see SynthNet.h). The network
+					generated from the options is varied along one or more axes, each
+					given as -x axis=value,value,..., and every combination of values is
+					trained for a few epochs. The axes are the options of the generator
+					(modules, size, inputsize, fanin, delay, maps, patterns, sparsity)
+					and "workers", the number of processes training a copy of the
+					network at the same time. Training a network is not split over
+					threads, and the random number generator is shared by all networks
+					of a process, so workers are processes; their combined throughput
+					shows how the engine scales with the cores and memory of a machine.
+					The results are printed as JSON, with the iterations per second and
+					the weights updated per second (iterations times the number of
+					weights). With -p prefix, the results are also written to
+					"prefix.dat", with a gnuplot script "prefix.gp" that plots the
+					weights per second against the first axis, a line per worker count.
+
+					Usage: ScaleBench [-x axis=values] [-e epochs] [-t iterations] [-o file] [-p prefix] [generator options]
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include "CALMGlobal.h"
+#include "CALM.h"
+#include "Rnd.h"
+#include "Utilities.h"
+#include "SynthNet.h"
+#include "BenchTime.h"
+
+using namespace std;
+
+#define kMaxAxes		8		// axes that can be swept at once
+#define kMaxValues		32		// values per axis
+#define kMaxPoints		4096	// combinations of values
+
+// the generator options and worker count that can be swept
+enum
+{
+	kAxisModules = 0,
+	kAxisSize,
+	kAxisInputSize,
+	kAxisFanIn,
+	kAxisDelay,
+	kAxisMaps,
+	kAxisPatterns,
+	kAxisSparsity,
+	kAxisWorkers,
+	kNumAxisTypes
+};
+
+static const char* sAxisNames[kNumAxisTypes] =
+{
+	"modules", "size", "inputsize", "fanin", "delay", "maps", "patterns", "sparsity", "workers"
+};
+static const char sAxisOptions[kNumAxisTypes] = { 'm', 'n', 'I', 'f', 'd', 'M', 'P', 's', 0 };
+
+struct Axis
+{
+	int			type;
+	int			numValues;
+	char*		values[kMaxValues];
+};
+
+struct ScalePoint
+{
+	double		values[kNumAxisTypes];	// setting of every axis, swept or not
+	double		seconds;
+	double		iterations;			// of all workers together
+	double		weights;			// per network
+};
+
+CALMAPI*		gCALMAPI;			// pointer to API interface
+static Axis		sAxes[kMaxAxes];
+static int		sNumAxes = 0;
+static int		sEpochs = 2;
+static int		sIterations = 20;
+
+
+// Trains the network in "dirname" and returns the number of module update iterations
+long TrainNetwork( char* dirname )
+{
+	ofstream	log( "/dev/null" );
+	long		iterations = 0;
+	int			calmErr;
+
+	gCALMAPI = new CALMAPI;
+	gCALMAPI->CALMSetDirectory( dirname );
+	gCALMAPI->CALMSetBasename( (char*)"synth" );
+	gCALMAPI->CALMSetVerbosity( O_NONE );
+	gCALMAPI->CALMSetNumIterations( sIterations );
+	gCALMAPI->SetCALMLog( &log );
+	SetSeed( 1 );
+	if ( gCALMAPI->CALMLoadParameters() != kNoErr ) return 0;
+	gCALMAPI->CALMSetupNetwork( &calmErr );
+	if ( calmErr != kNoErr || gCALMAPI->CALMLoadPatterns() != kNoErr ) return 0;
+	gCALMAPI->CALMPatternOrder( kPermuted );
+	gCALMAPI->CALMReset( O_WT | O_TIME | O_WIN );
+	for ( int epoch = 0; epoch < sEpochs; epoch++ )
+	{
+		gCALMAPI->CALMPermutePatterns();
+		gCALMAPI->CALMTrainFile( epoch );
+		iterations += gCALMAPI->CALMNumPatterns() * sIterations;
+	}
+	delete gCALMAPI;
+	return iterations;
+}
+
+
+// Generates the network of a point and trains it in "workers" processes at
+// once. Returns false if the network could not be generated or trained.
+bool RunPoint( SynthSpec* spec, int workers, char* dirname, ScalePoint* p )
+{
+	pid_t*	pids = new pid_t[workers];
+	int		fds[2], status;
+	long	iterations;
+	double	start;
+	bool	ok = true;
+
+	if ( ! SynthWrite( spec, dirname, "synth", &p->weights ) || pipe( fds ) != 0 )
+	{
+		delete[] pids;
+		return false;
+	}
+	p->iterations = 0.0;
+	start = Now();
+	for ( int i = 0; i < workers; i++ )
+	{
+		pids[i] = fork();
+		if ( pids[i] == 0 )
+		{
+			close( fds[0] );
+			iterations = TrainNetwork( dirname );
+			if ( write( fds[1], &iterations, sizeof(long) ) != sizeof(long) ) _exit( 1 );
+			_exit( 0 );
+		}
+		if ( pids[i] < 0 ) ok = false;
+	}
+	close( fds[1] );
+	for ( int i = 0; i < workers; i++ )
+	{
+		if ( pids[i] < 0 ) continue;
+		if ( read( fds[0], &iterations, sizeof(long) ) != sizeof(long) || iterations == 0 ) ok = false;
+		else p->iterations += iterations;
+	}
+	for ( int i = 0; i < workers; i++ )
+		if ( pids[i] > 0 ) waitpid( pids[i], &status, 0 );
+	p->seconds = Now() - start;
+	close( fds[0] );
+	delete[] pids;
+	return ok;
+}
+
+
+// gnuplot data, a block per worker count, and the script to plot it
+void WritePlot( const char* prefix, ScalePoint* points, int numPoints )
+{
+	char		filename[PATH_MAX];
+	double		workers[kMaxPoints];
+	int			numWorkers = 0, x = kAxisSize, i, j, k;
+	ofstream	outfile;
+
+	for ( i = 0; i < sNumAxes; i++ )
+		if ( sAxes[i].type != kAxisWorkers )
+		{
+			x = sAxes[i].type;
+			break;
+		}
+	for ( i = 0; i < numPoints; i++ )
+	{
+		for ( j = 0; j < numWorkers; j++ ) if ( workers[j] == points[i].values[kAxisWorkers] ) break;
+		if ( j == numWorkers ) workers[numWorkers++] = points[i].values[kAxisWorkers];
+	}
+
+	snprintf( filename, PATH_MAX, "%s.dat", prefix );
+	outfile.open( filename );
+	if ( outfile.fail() )
+	{
+		FileCreateError( filename );
+		return;
+	}
+	for ( j = 0; j < numWorkers; j++ )
+	{
+		outfile << "# workers " << workers[j] << "\n#";
+		for ( k = 0; k < kNumAxisTypes; k++ ) outfile << ' ' << sAxisNames[k];
+		outfile << " seconds iterations_per_s weights_per_s\n";
+		for ( i = 0; i < numPoints; i++ )
+		{
+			if ( points[i].values[kAxisWorkers] != workers[j] ) continue;
+			for ( k = 0; k < kNumAxisTypes; k++ ) outfile << points[i].values[k] << ' ';
+			outfile << points[i].seconds << ' ' << points[i].iterations / points[i].seconds << ' ';
+			outfile << points[i].iterations * points[i].weights / points[i].seconds << '\n';
+		}
+		outfile << "\n\n";
+	}
+	outfile.close();
+
+	snprintf( filename, PATH_MAX, "%s.gp", prefix );
+	outfile.open( filename );
+	outfile << "set xlabel \"" << sAxisNames[x] << "\"\n";
+	outfile << "set ylabel \"weights updated per second\"\n";
+	outfile << "set logscale y\nset key left top\n";
+	outfile << "plot ";
+	for ( j = 0; j < numWorkers; j++ )
+	{
+		outfile << ( j == 0 ? "" : ", \\\n     " ) << "\"" << prefix << ".dat\" index " << j;
+		outfile << " using " << x + 1 << ":" << kNumAxisTypes + 3 << " with linespoints title \"";
+		outfile << workers[j] << ( workers[j] == 1 ? " worker\"" : " workers\"" );
+	}
+	outfile << "\npause mouse close\n";
+	outfile.close();
+}
+
+
+// Parses "axis=value,value,...". The values are kept as strings, and passed
+// to the generator as if given on the command line.
+bool ParseAxis( char* arg )
+{
+	char*	values = strchr( arg, '=' );
+	Axis*	axis = &sAxes[sNumAxes];
+	char*	value;
+
+	if ( values == NULL || sNumAxes == kMaxAxes ) return false;
+	*values++ = '\0';
+	for ( axis->type = 0; axis->type < kNumAxisTypes; axis->type++ )
+		if ( strcmp( arg, sAxisNames[axis->type] ) == 0 ) break;
+	if ( axis->type == kNumAxisTypes ) return false;
+	axis->numValues = 0;
+	for ( value = strtok( values, "," ); value != NULL && axis->numValues < kMaxValues; value = strtok( NULL, "," ) )
+		axis->values[axis->numValues++] = value;
+	if ( axis->numValues == 0 ) return false;
+	sNumAxes++;
+	return true;
+}
+
+
+void Usage( void )
+{
+	cerr << "Usage: ScaleBench [-x axis=values] [-e epochs] [-t iterations] [-o file] [-p prefix] [generator options]" << endl;
+	cerr << "\t-x : values of an axis, separated by commas; can be given more than once" << endl;
+	cerr << "\t     axes: modules size inputsize fanin delay maps patterns sparsity workers" << endl;
+	cerr << "\t     (default -x size=8,16,32,64,128,256 -x workers=1,2,4,...,cores)" << endl;
+	cerr << "\t-e : epochs of training (default 2)" << endl;
+	cerr << "\t-t : iterations per pattern (default 20)" << endl;
+	cerr << "\t-o : write the results to a file instead of stdout" << endl;
+	cerr << "\t-p : write prefix.dat and the gnuplot script prefix.gp" << endl;
+	cerr << "generator options, the settings of the axes that are not swept:" << endl;
+	SynthUsage();
+	exit( 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+	static char		defaultSizes[] = "size=8,16,32,64,128,256";
+	static char		defaultWorkers[256];
+	static ScalePoint points[kMaxPoints];
+	SynthSpec		base, spec;
+	ofstream		outfile;
+	ostream*		os = &cout;
+	const char*		prefix = NULL;
+	char			dirname[PATH_MAX];
+	char			filename[PATH_MAX];
+	int				index[kMaxAxes];
+	int				numPoints = 0, workers, cores, i, k;
+	bool			hasWorkers = false, ok = true;
+
+	SynthDefaults( &base );
+	for ( int arg = 1; arg < argc; arg += 2 )
+	{
+		if ( argv[arg][0] != '-' || arg + 1 >= argc ) Usage();
+		switch ( argv[arg][1] )
+		{
+			case 'x': if ( ! ParseAxis( argv[arg+1] ) ) Usage(); break;
+			case 'e': sEpochs = Max( atoi( argv[arg+1] ), 1 ); break;
+			case 't': sIterations = Max( atoi( argv[arg+1] ), 1 ); break;
+			case 'p': prefix = argv[arg+1]; break;
+			case 'o':
+				outfile.open( argv[arg+1] );
+				if ( outfile.fail() )
+				{
+					cerr << "Could not create " << argv[arg+1] << endl;
+					return 1;
+				}
+				os = &outfile;
+				break;
+			default: if ( ! SynthOption( &base, argv[arg][1], argv[arg+1] ) ) Usage();
+		}
+	}
+	if ( sNumAxes == 0 ) ParseAxis( defaultSizes );
+	for ( i = 0; i < sNumAxes; i++ ) if ( sAxes[i].type == kAxisWorkers ) hasWorkers = true;
+	if ( ! hasWorkers && sNumAxes < kMaxAxes )
+	{
+		cores = Max( (int)thread::hardware_concurrency(), 1 );
+		k = snprintf( defaultWorkers, 256, "workers=1" );
+		for ( workers = 2; workers < cores && k < 240; workers *= 2 ) k += snprintf( defaultWorkers + k, 256 - k, ",%d", workers );
+		if ( cores > 1 ) snprintf( defaultWorkers + k, 256 - k, ",%d", cores );
+		ParseAxis( defaultWorkers );
+	}
+
+	snprintf( dirname, PATH_MAX, "/tmp/ScaleBench-%d", (int)getpid() );
+	if ( mkdir( dirname, 0755 ) != 0 )
+	{
+		cerr << "Could not create " << dirname << endl;
+		return 1;
+	}
+
+	*os << "{\n\t\"benchmark\": \"ScaleBench\",\n\t\"epochs\": " << sEpochs << ",\n\t\"iterations\": " << sIterations;
+	*os << ",\n\t\"results\": [";
+	// every combination of values, the last axis changing fastest
+	for ( i = 0; i < sNumAxes; i++ ) index[i] = 0;
+	while ( numPoints < kMaxPoints )
+	{
+		ScalePoint* p = &points[numPoints];
+
+		spec = base;
+		workers = 1;
+		for ( i = 0; i < sNumAxes; i++ )
+		{
+			if ( sAxes[i].type == kAxisWorkers )
+				workers = Max( atoi( sAxes[i].values[index[i]] ), 1 );
+			else
+				SynthOption( &spec, sAxisOptions[sAxes[i].type], sAxes[i].values[index[i]] );
+		}
+		p->values[kAxisModules] = spec.numModules;
+		p->values[kAxisSize] = spec.moduleSize;
+		p->values[kAxisInputSize] = ( spec.inputSize > 0 ) ? spec.inputSize : spec.moduleSize;
+		p->values[kAxisFanIn] = spec.fanIn;
+		p->values[kAxisDelay] = spec.delayRatio;
+		p->values[kAxisMaps] = spec.numMaps;
+		p->values[kAxisPatterns] = spec.numPatterns;
+		p->values[kAxisSparsity] = spec.sparsity;
+		p->values[kAxisWorkers] = workers;
+
+		os->flush();	// or the worker processes may write it again
+		if ( ! RunPoint( &spec, workers, dirname, p ) )
+		{
+			cerr << "Could not generate or train the network in " << dirname << endl;
+			ok = false;
+			break;
+		}
+		*os << ( numPoints == 0 ? "\n\t\t{ " : ",\n\t\t{ " );
+		for ( k = 0; k < kNumAxisTypes; k++ ) *os << "\"" << sAxisNames[k] << "\": " << p->values[k] << ", ";
+		*os << "\"weights\": " << p->weights << ", \"seconds\": " << p->seconds;
+		*os << ", \"iterations_per_s\": " << p->iterations / p->seconds;
+		*os << ", \"weights_per_s\": " << p->iterations * p->weights / p->seconds << " }";
+		numPoints++;
+
+		for ( i = sNumAxes - 1; i >= 0; i-- )
+		{
+			if ( ++index[i] < sAxes[i].numValues ) break;
+			index[i] = 0;
+		}
+		if ( i < 0 ) break;
+	}
+	*os << "\n\t]\n}" << endl;
+
+	if ( prefix != NULL ) WritePlot( prefix, points, numPoints );
+	const char* exts[] = { "net", "par", "pat" };
+	for ( i = 0; i < 3; i++ )
+	{
+		snprintf( filename, PATH_MAX, "%s/synth.%s", dirname, exts[i] );
+		unlink( filename );
+	}
+	rmdir( dirname );
+	return ok ? 0 : 1;
+}
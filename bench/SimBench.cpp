@@ -0,0 +1,398 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	End-to-end benchmark over the simulations bundled in simulations/.
+					Each scenario trains and tests one of the sample networks with a
+					fixed seed, in a process of its own, and reports the wall time, the
+					module update iterations per second and the peak resident memory.
+					The winners of the final test and the weights are compared with the
+					golden output stored in bench/golden/, value by value within a
+					tolerance, so a change to the engine that alters the results is
+					caught along with its effect on speed. The results are printed as
+					JSON; the exit status is 1 if any scenario does not match.
+
+					Usage: SimBench [-d simdir] [-g goldendir] [-t tolerance] [-r runs] [-o file] [-w] [scenario ...]
+
+					Each scenario is run a few times and the fastest run is reported.
+					-w writes the golden output instead of comparing with it.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "CALMGlobal.h"
+#include "CALM.h"
+#include "Rnd.h"
+#include "BenchTime.h"
+
+using namespace std;
+
+#define kTolerance		1e-4		// default largest difference with the golden output
+#define kRuns			3			// default number of runs, of which the fastest is reported
+
+// how a scenario is trained
+enum
+{
+	kOffline = 0,		// pattern file, permuted order
+	kOnline = 1,		// random online patterns
+	kSequence = 2		// random online patterns, with feedback, time delays and resizing
+};
+
+// outcome of a scenario
+enum
+{
+	kMatch = 0,
+	kMismatch = 1,
+	kNoGolden = 2,
+	kWritten = 3,
+	kFailed = 4
+};
+
+struct Scenario
+{
+	const char*	name;
+	const char*	dir;			// subdirectory of simulations/
+	const char*	basename;
+	int			kind;
+	bool		feedback;		// load a feedback file
+	bool		resize;			// check for growing and pruning every other epoch
+	int			epochs;
+	int			iterations;
+	long		seed;
+};
+
+static Scenario sScenarios[] =
+{
+	{ "offline",	"offline",	"calm",	kOffline,	false,	false,	200,	50,		4242 },
+	{ "online",		"online",	"calm",	kOnline,	false,	false,	1000,	50,		777 },
+	{ "feedback",	"feedback",	"calm",	kOffline,	true,	false,	50,		100,	4242 },
+	{ "gibbons",	"gibbons",	"calm",	kOffline,	false,	true,	30,		100,	4242 },
+	{ "map",		"map",		"calm",	kOffline,	false,	false,	20,		100,	4242 },
+	{ "multi",		"multi",	"king",	kSequence,	false,	false,	300,	60,		777 }
+};
+
+#define kNumScenarios	(int)( sizeof(sScenarios) / sizeof(Scenario) )
+
+// what a scenario process reports back
+struct ScenarioResult
+{
+	double		seconds;
+	long		iterations;
+	int			status;
+	double		maxDiff;		// largest difference with the golden output
+};
+
+CALMAPI*		gCALMAPI;		// pointer to API interface
+static char		sSimDir[PATH_MAX];
+static char		sGoldenDir[PATH_MAX];
+static double	sTolerance = kTolerance;
+static int		sRuns = kRuns;
+static bool		sWrite = false;
+
+
+// Trains and tests a scenario, and puts the winners of the test and the
+// weights in "output". Returns the number of module update iterations.
+long RunScenario( Scenario* s, ostream* output, bool* ok )
+{
+	char		dirname[PATH_MAX];
+	char		filename[PATH_MAX];
+	ostringstream log;
+	long		iterations = 0;
+	int			calmErr, fbIdx = 0;
+
+	*ok = false;
+	snprintf( dirname, PATH_MAX, "%s/%s", sSimDir, s->dir );
+	gCALMAPI->CALMSetDirectory( dirname );
+	gCALMAPI->CALMSetBasename( (char*)s->basename );
+	gCALMAPI->CALMSetVerbosity( O_NONE );
+	gCALMAPI->CALMSetNumIterations( s->iterations );
+	gCALMAPI->SetCALMLog( &log );
+	SetSeed( s->seed );
+
+	if ( gCALMAPI->CALMLoadParameters() != kNoErr ) return 0;
+	gCALMAPI->CALMSetupNetwork( &calmErr );
+	if ( calmErr != kNoErr ) return 0;
+	if ( s->kind == kOffline )
+	{
+		if ( gCALMAPI->CALMLoadPatterns() != kNoErr ) return 0;
+		if ( s->feedback && gCALMAPI->CALMLoadFeedback() != kNoErr ) return 0;
+		gCALMAPI->CALMPatternOrder( kPermuted );
+	}
+	else
+	{
+		gCALMAPI->CALMOnlinePatterns();
+		if ( s->kind == kSequence ) fbIdx = gCALMAPI->CALMGetModuleIndex( "out" );
+	}
+	gCALMAPI->CALMReset( O_WT | O_TIME | O_WIN );
+
+	for ( int epoch = 0; epoch < s->epochs; epoch++ )
+	{
+		if ( s->kind == kOffline )
+		{
+			gCALMAPI->CALMPermutePatterns();
+			gCALMAPI->CALMTrainFile( epoch );
+			iterations += gCALMAPI->CALMNumPatterns() * s->iterations;
+			if ( s->resize && epoch % 2 == 0 ) gCALMAPI->CALMResizeModule();
+			continue;
+		}
+		for ( int i = 0; i < gCALMAPI->CALMGetInputLen(); i++ )
+		{
+			if ( s->kind == kOnline )
+				gCALMAPI->CALMSetOnlineInput( i, PseudoRNG() );
+			else
+				gCALMAPI->CALMSetOnlineInput( i, PseudoRNG() > 0.5 ? 1.0 : 0.0 );
+		}
+		if ( s->kind == kSequence )
+		{
+		// alternate feedback, and grow the feedback module halfway
+			gCALMAPI->CALMSetFeedback( epoch % 2 );
+			if ( epoch % 50 == 49 ) gCALMAPI->CALMResizeModule();
+			if ( epoch == s->epochs / 3 ) gCALMAPI->CALMResizeModule( fbIdx, 3 );
+		}
+		gCALMAPI->CALMTrainSingle( epoch );
+		iterations += s->iterations;
+	}
+
+	gCALMAPI->CALMReset( O_TIME | O_WIN );
+	if ( s->kind == kOffline )
+	{
+		gCALMAPI->CALMPatternOrder( kLinear );
+		gCALMAPI->CALMTestFile( 0 );
+		iterations += gCALMAPI->CALMNumPatterns() * s->iterations;
+		gCALMAPI->CALMShowWinners( output );
+	}
+	else
+	{
+		for ( int epoch = 0; epoch < 20; epoch++ )
+		{
+			for ( int i = 0; i < gCALMAPI->CALMGetInputLen(); i++ )
+				gCALMAPI->CALMSetOnlineInput( i, ( i + epoch ) % 3 == 0 ? 1.0 : 0.0 );
+			gCALMAPI->CALMTestSingle( epoch );
+			iterations += s->iterations;
+			gCALMAPI->CALMShowOnlineWinners( output );
+		}
+	}
+
+	// the weights, through a temporary file
+	snprintf( filename, PATH_MAX, "/tmp/SimBench-%d", (int)getpid() );
+	gCALMAPI->CALMSaveWeights( filename );
+	strcat( filename, ".wts" );
+	ifstream weights( filename );
+	if ( weights.fail() ) return 0;
+	*output << weights.rdbuf();
+	weights.close();
+	unlink( filename );
+
+	*ok = true;
+	return iterations;
+}
+
+
+// Compares two outputs word by word, and numbers within the tolerance.
+// Returns true if they match, and sets maxDiff to the largest difference.
+bool CompareOutput( const string& output, const string& golden, double* maxDiff )
+{
+	istringstream	a( output ), b( golden );
+	string			wa, wb;
+	char			*enda, *endb;
+	double			va, vb;
+	bool			match = true;
+
+	*maxDiff = 0.0;
+	for ( ;; )
+	{
+		bool moreA = (bool)( a >> wa );
+		bool moreB = (bool)( b >> wb );
+		if ( moreA != moreB ) return false;
+		if ( ! moreA ) break;
+		va = strtod( wa.c_str(), &enda );
+		vb = strtod( wb.c_str(), &endb );
+		if ( *enda != '\0' || *endb != '\0' || enda == wa.c_str() || endb == wb.c_str() )
+		{
+			if ( wa != wb ) match = false;
+			continue;
+		}
+		if ( fabs( va - vb ) > *maxDiff ) *maxDiff = fabs( va - vb );
+		if ( fabs( va - vb ) > sTolerance ) match = false;
+	}
+	return match;
+}
+
+
+// runs in the scenario's own process
+void DoScenario( Scenario* s, ScenarioResult* r )
+{
+	ostringstream	output;
+	char			filename[PATH_MAX];
+	double			start;
+	bool			ok = false;
+
+	r->maxDiff = 0.0;
+	r->seconds = 0.0;
+	// every run starts from the same seed, so only the output of the last is kept
+	for ( int run = 0; run < sRuns; run++ )
+	{
+		output.str( "" );
+		gCALMAPI = new CALMAPI;
+		start = Now();
+		r->iterations = RunScenario( s, &output, &ok );
+		start = Now() - start;
+		delete gCALMAPI;
+		if ( ! ok )
+		{
+			r->status = kFailed;
+			return;
+		}
+		if ( run == 0 || start < r->seconds ) r->seconds = start;
+	}
+
+	snprintf( filename, PATH_MAX, "%s/%s.txt", sGoldenDir, s->name );
+	if ( sWrite )
+	{
+		ofstream golden( filename );
+		golden << output.str();
+		golden.close();
+		r->status = golden.fail() ? kFailed : kWritten;
+		if ( golden.fail() ) cerr << "Could not create " << filename << endl;
+		return;
+	}
+	ifstream golden( filename );
+	if ( golden.fail() )
+	{
+		r->status = kNoGolden;
+		return;
+	}
+	ostringstream expected;
+	expected << golden.rdbuf();
+	r->status = CompareOutput( output.str(), expected.str(), &r->maxDiff ) ? kMatch : kMismatch;
+}
+
+
+// Runs a scenario in a child process, so its peak memory is its own.
+// Returns the peak resident set size in kilobytes.
+long ForkScenario( Scenario* s, ScenarioResult* r )
+{
+	struct rusage	usage;
+	int				fds[2], status;
+	pid_t			pid;
+
+	r->status = kFailed;
+	r->seconds = 0.0;
+	r->iterations = 0;
+	r->maxDiff = 0.0;
+	if ( pipe( fds ) != 0 ) return 0;
+	pid = fork();
+	if ( pid == 0 )
+	{
+		close( fds[0] );
+		DoScenario( s, r );
+		if ( write( fds[1], r, sizeof(ScenarioResult) ) != sizeof(ScenarioResult) ) _exit( 1 );
+		_exit( 0 );
+	}
+	close( fds[1] );
+	if ( pid < 0 || read( fds[0], r, sizeof(ScenarioResult) ) != sizeof(ScenarioResult) ) r->status = kFailed;
+	close( fds[0] );
+	if ( pid < 0 || wait4( pid, &status, 0, &usage ) != pid ) return 0;
+	return usage.ru_maxrss;
+}
+
+
+void Usage( void )
+{
+	cerr << "Usage: SimBench [-d simdir] [-g goldendir] [-t tolerance] [-r runs] [-o file] [-w] [scenario ...]" << endl;
+	cerr << "\t-d : directory with the bundled simulations (default ../simulations)" << endl;
+	cerr << "\t-g : directory with the golden output (default golden)" << endl;
+	cerr << "\t-t : largest difference of a value with the golden output (default " << kTolerance << ")" << endl;
+	cerr << "\t-r : number of runs, of which the fastest is reported (default " << kRuns << ")" << endl;
+	cerr << "\t-o : write the results to a file instead of stdout" << endl;
+	cerr << "\t-w : write the golden output instead of comparing with it" << endl;
+	cerr << "\tscenarios:";
+	for ( int i = 0; i < kNumScenarios; i++ ) cerr << " " << sScenarios[i].name;
+	cerr << endl;
+	exit( 1 );
+}
+
+
+int main( int argc, char *argv[] )
+{
+	static const char* statusNames[] = { "match", "mismatch", "no golden output", "written", "failed" };
+	const char*		simDir = "../simulations";
+	const char*		goldenDir = "golden";
+	ScenarioResult	r;
+	ofstream		outfile;
+	ostream*		os = &cout;
+	bool			selected[kNumScenarios];
+	bool			all = true, first = true;
+	int				i, failures = 0;
+	long			rss;
+
+	for ( i = 0; i < kNumScenarios; i++ ) selected[i] = false;
+	for ( int arg = 1; arg < argc; arg++ )
+	{
+		if ( argv[arg][0] != '-' )
+		{
+			for ( i = 0; i < kNumScenarios; i++ ) if ( strcmp( argv[arg], sScenarios[i].name ) == 0 ) break;
+			if ( i == kNumScenarios ) Usage();
+			selected[i] = true;
+			all = false;
+			continue;
+		}
+		if ( argv[arg][1] == 'w' )
+		{
+			sWrite = true;
+			continue;
+		}
+		if ( arg + 1 >= argc ) Usage();
+		switch ( argv[arg][1] )
+		{
+			case 'd': simDir = argv[++arg]; break;
+			case 'g': goldenDir = argv[++arg]; break;
+			case 't': sTolerance = atof( argv[++arg] ); break;
+			case 'r': sRuns = atoi( argv[++arg] ); sRuns = Max( sRuns, 1 ); break;	// Max evaluates twice
+			case 'o':
+				outfile.open( argv[++arg] );
+				if ( outfile.fail() )
+				{
+					cerr << "Could not create " << argv[arg] << endl;
+					return 1;
+				}
+				os = &outfile;
+				break;
+			default: Usage();
+		}
+	}
+
+	// the API changes directories, so all paths are made absolute
+	if ( sWrite ) mkdir( goldenDir, 0755 );
+	if ( realpath( simDir, sSimDir ) == NULL || realpath( goldenDir, sGoldenDir ) == NULL )
+	{
+		cerr << "Could not find " << simDir << " or " << goldenDir << endl;
+		return 1;
+	}
+
+	*os << "{\n\t\"benchmark\": \"SimBench\",\n\t\"tolerance\": " << sTolerance << ",\n\t\"results\": [";
+	for ( i = 0; i < kNumScenarios; i++ )
+	{
+		if ( ! all && ! selected[i] ) continue;
+		os->flush();	// or the child process may write it again
+		rss = ForkScenario( &sScenarios[i], &r );
+		if ( r.status == kMismatch || r.status == kFailed ) failures++;
+		*os << ( first ? "\n" : ",\n" );
+		*os << "\t\t{ \"scenario\": \"" << sScenarios[i].name << "\", \"status\": \"" << statusNames[r.status];
+		*os << "\", \"seconds\": " << r.seconds << ", \"iterations\": " << r.iterations;
+		*os << ", \"iterations_per_s\": " << ( r.seconds > 0.0 ? r.iterations / r.seconds : 0.0 );
+		*os << ", \"peak_rss_kb\": " << rss << ", \"max_diff\": " << r.maxDiff << " }";
+		first = false;
+	}
+	*os << "\n\t]\n}" << endl;
+	return ( failures > 0 ) ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Checks the order in which CALMPatternStream presents the patterns of
+					a binary pattern file. For several numbers of patterns and window
+					sizes, including ones where the last block is not full, each pass,
+					in file order and permuted, must present every pattern exactly once,
+					with its own values and feedback. The exit status is 1 if not.
+
+					Usage: StreamCheck
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include "CALMGlobal.h"
+#include "CALMPatternFile.h"
+#include "CALMPatternStream.h"
+#include "Rnd.h"
+
+using namespace std;
+
+#define kPasses			20			// permuted passes for each case
+#define kFileName		"StreamCheck.ptb"
+
+struct StreamCase
+{
+	int		numPatterns;
+	int		window;
+};
+
+static StreamCase sCases[] =
+{
+	{ 5,	4 },
+	{ 7,	6 },
+	{ 10,	4 },
+	{ 12,	6 },
+	{ 1,	4 },
+	{ 3,	8 },
+	{ 101,	20 }
+};
+
+#define kNumCases	(int)( sizeof(sCases) / sizeof(StreamCase) )
+
+
+// Presents all patterns once in the current order. Returns false if a pattern
+// is missing, presented twice or does not hold its own values.
+bool CheckPass( CALMPatternStream* stream, int* seen )
+{
+	int n = stream->GetNumPatterns();
+	int idx;
+
+	for ( int p = 0; p < n; p++ ) seen[p] = 0;
+	for ( int p = 0; p < n; p++ )
+	{
+		idx = stream->GetIndex( p );
+		if ( idx < 0 || idx >= n ) return false;
+		if ( stream->GetPattern( 0, p )[0] != (data_type)idx ) return false;
+		if ( stream->GetPattern( 0, p )[1] != (data_type)-idx ) return false;
+		if ( stream->GetFeedback( p ) != idx ) return false;
+		seen[idx]++;
+	}
+	for ( int p = 0; p < n; p++ ) if ( seen[p] != 1 ) return false;
+	return true;
+}
+
+
+// Writes a file of "n" patterns, each holding its own index, and checks the
+// passes over it. Returns the number of passes that failed.
+int RunCase( StreamCase* c )
+{
+	int					sizes[1] = { 2 };
+	data_type*			patterns[1];
+	int*				feedback = new int[c->numPatterns];
+	int*				seen = new int[c->numPatterns];
+	CALMPatternStream	stream;
+	int					failures = 0;
+
+	patterns[0] = new data_type[2 * c->numPatterns];
+	for ( int p = 0; p < c->numPatterns; p++ )
+	{
+		patterns[0][2*p] = p;
+		patterns[0][2*p+1] = -p;
+		feedback[p] = p;
+	}
+	if ( ! CALMPatternFile::Save( kFileName, 1, c->numPatterns, sizes, patterns, feedback ) ||
+		 ! stream.Open( kFileName, c->window ) )
+		failures++;
+	else
+	{
+		if ( ! CheckPass( &stream, seen ) ) failures++;
+		for ( int pass = 0; pass < kPasses; pass++ )
+		{
+			stream.Permute();
+			if ( ! CheckPass( &stream, seen ) ) failures++;
+		}
+		stream.SetOrder( kLinear );
+		if ( ! CheckPass( &stream, seen ) ) failures++;
+		stream.Close();
+	}
+	unlink( kFileName );
+
+	delete[] patterns[0];
+	delete[] feedback;
+	delete[] seen;
+	return failures;
+}
+
+
+int main( void )
+{
+	int failures = 0, f;
+
+	SetSeed( 4242 );
+	for ( int i = 0; i < kNumCases; i++ )
+	{
+		f = RunCase( &sCases[i] );
+		cout << sCases[i].numPatterns << " patterns, window " << sCases[i].window << ": ";
+		if ( f == 0 ) cout << "ok" << endl;
+		else cout << f << " passes failed" << endl;
+		failures += f;
+	}
+	return ( failures > 0 ) ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of the synthetic network generator
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <iostream>
+#include <fstream>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "SynthNet.h"
+
+using namespace std;
+
+// parameters of simulations/gibbons
+static const char* sParNames[gNumPars] =
+{
+	"UP", "DOWN", "CROSS", "FLAT", "HIGH", "LOW", "AE", "ER", "INITWT", "LOWCRIT", "HIGHCRIT",
+	"K_A", "K_Lmax", "K_Lmin", "L_L", "D_L", "WMUE_L", "G_L", "G_W", "F_Bw", "F_Ba", "SIGMA",
+	"P_G", "P_S", "U_L", "A", "B"
+};
+static const double sParValues[gNumPars] =
+{
+	0.5, -1.2, -10.0, -1.0, -0.6, 0.4, 1.0, 0.1, 0.6, 0.1, 0.1, 0.05, 1.0, 0.0,
+	1.0, 0.0001, 0.005, 0.5, 0.25, 1.0, 1.0, 0.1, 10.0, 0.0001, 0, 8.8, 10
+};
+
+
+// xorshift generator, so the files do not depend on the generators of the library or system
+static unsigned int NextRandom( unsigned int* state )
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+
+void SynthDefaults( SynthSpec* spec )
+{
+	spec->numModules = 8;
+	spec->moduleSize = 32;
+	spec->numInputs = 1;
+	spec->inputSize = 0;
+	spec->fanIn = 2;
+	spec->delayRatio = 0.0;
+	spec->maxDelay = 3;
+	spec->numMaps = 0;
+	spec->numPatterns = 20;
+	spec->sparsity = 0.8;
+	spec->seed = 1;
+}
+
+
+// sets the spec value of a command-line option; returns false if there is no such option
+bool SynthOption( SynthSpec* spec, char option, const char* value )
+{
+	switch ( option )
+	{
+		case 'm': spec->numModules = Max( atoi( value ), 1 ); break;
+		case 'n': spec->moduleSize = Max( atoi( value ), 2 ); break;
+		case 'i': spec->numInputs = Max( atoi( value ), 1 ); break;
+		case 'I': spec->inputSize = Max( atoi( value ), 0 ); break;
+		case 'f': spec->fanIn = Max( atoi( value ), 1 ); break;
+		case 'd': spec->delayRatio = atof( value ); break;
+		case 'D': spec->maxDelay = Max( atoi( value ), 1 ); break;
+		case 'M': spec->numMaps = Max( atoi( value ), 0 ); break;
+		case 'P': spec->numPatterns = Max( atoi( value ), 1 ); break;
+		case 's': spec->sparsity = atof( value ); break;
+		case 'S': spec->seed = atoi( value ); break;
+		default: return false;
+	}
+	return true;
+}
+
+
+void SynthUsage( void )
+{
+	cerr << "\t-m : number of CALM modules (default 8)" << endl;
+	cerr << "\t-n : nodes per CALM module (default 32)" << endl;
+	cerr << "\t-i : number of input modules (default 1)" << endl;
+	cerr << "\t-I : nodes per input module (default the same as -n)" << endl;
+	cerr << "\t-f : incoming connections per module (default 2)" << endl;
+	cerr << "\t-d : fraction of connections with a time delay (default 0)" << endl;
+	cerr << "\t-D : longest time delay (default 3)" << endl;
+	cerr << "\t-M : number of the CALM modules that are CALMMap modules (default 0)" << endl;
+	cerr << "\t-P : number of patterns (default 20)" << endl;
+	cerr << "\t-s : fraction of input nodes that are off in a pattern (default 0.8)" << endl;
+	cerr << "\t-S : seed of the generator (default 1)" << endl;
+}
+
+
+// Writes the network, parameter and pattern files. If numWeights is given,
+// it is set to the number of weights on all connections.
+bool SynthWrite( SynthSpec* spec, const char* dirname, const char* basename, double* numWeights )
+{
+	char			filename[PATH_MAX];
+	unsigned int	state = spec->seed * 2654435761u + 1;
+	int				numSources = spec->numInputs + spec->numModules;
+	int				inputSize = ( spec->inputSize > 0 ) ? spec->inputSize : spec->moduleSize;
+	int				*sources, *order;
+	int				i, j, k, n, active;
+	double			weights = 0.0;
+	ofstream		outfile;
+
+	sources = new int[numSources];
+	order = new int[inputSize];
+
+	// network: inputs are "in0", "in1" ..., the CALM modules "m0", "m1" ...
+	snprintf( filename, PATH_MAX, "%s/%s.net", dirname, basename );
+	outfile.open( filename );
+	if ( outfile.fail() )
+	{
+		FileCreateError( filename );
+		delete[] sources;
+		delete[] order;
+		return false;
+	}
+	outfile << "# synthetic network: " << spec->numModules << " modules of " << spec->moduleSize;
+	outfile << " nodes, fan-in " << spec->fanIn << ", delay ratio " << spec->delayRatio;
+	outfile << ", " << spec->numMaps << " maps, seed " << spec->seed << '\n';
+	outfile << spec->numModules << "\n" << spec->numInputs << "\n";
+	for ( i = 0; i < spec->numInputs; i++ ) outfile << "in" << i << "\tinput\t" << inputSize << '\n';
+	for ( i = 0; i < spec->numModules; i++ )
+	{
+		outfile << "m" << i << '\t' << ( ( i >= spec->numModules - spec->numMaps ) ? "map" : "calm" );
+		outfile << '\t' << spec->moduleSize << '\n';
+	}
+	for ( i = 0; i < spec->numModules; i++ )
+	{
+		// the sources of module i are the inputs and modules 0 to i-1, numbered
+		// as such, and the nearest one comes first
+		n = spec->numInputs + i;
+		for ( j = 0; j < n; j++ ) sources[j] = j;
+		k = ( i < spec->numInputs ) ? i : n - 1;
+		sources[k] = 0;
+		sources[0] = k;
+		n = Min( n, spec->fanIn );
+		for ( j = 1; j < n; j++ )
+		{
+			k = j + NextRandom( &state ) % ( spec->numInputs + i - j );
+			int tmp = sources[j];
+			sources[j] = sources[k];
+			sources[k] = tmp;
+		}
+		outfile << 'm' << i << '\t' << n;
+		for ( j = 0; j < n; j++ )
+		{
+			if ( sources[j] < spec->numInputs )
+			{
+				outfile << "\tin" << sources[j];
+				weights += (double)spec->moduleSize * inputSize;
+			}
+			else
+			{
+				outfile << "\tm" << sources[j] - spec->numInputs;
+				weights += (double)spec->moduleSize * spec->moduleSize;
+			}
+			if ( NextRandom( &state ) < spec->delayRatio * 4294967296.0 )
+				outfile << " delay " << 1 + NextRandom( &state ) % spec->maxDelay;
+			else
+				outfile << " normal";
+		}
+		outfile << '\n';
+	}
+	outfile.close();
+
+	// parameters
+	snprintf( filename, PATH_MAX, "%s/%s.par", dirname, basename );
+	outfile.open( filename );
+	for ( i = 0; i < gNumPars; i++ ) outfile << sParValues[i] << "\t\t# " << sParNames[i] << '\n';
+	outfile.close();
+
+	// patterns, all of the first input module, then all of the next one
+	snprintf( filename, PATH_MAX, "%s/%s.pat", dirname, basename );
+	outfile.open( filename );
+	outfile << "# Number of input data\n" << spec->numPatterns << "\n# input data\n";
+	active = (int)( ( 1.0 - spec->sparsity ) * inputSize + 0.5 );
+	active = Min( Max( active, 1 ), inputSize );
+	for ( k = 0; k < spec->numInputs; k++ )
+	{
+		for ( i = 0; i < spec->numPatterns; i++ )
+		{
+			// "active" nodes, chosen at random, are on
+			for ( j = 0; j < inputSize; j++ ) order[j] = 0;
+			for ( j = 0; j < active; j++ )
+			{
+				do n = NextRandom( &state ) % inputSize; while ( order[n] );
+				order[n] = 1;
+			}
+			for ( j = 0; j < inputSize; j++ ) outfile << order[j] << ( j < inputSize - 1 ? ' ' : '\n' );
+		}
+	}
+	outfile.close();
+
+	delete[] sources;
+	delete[] order;
+	if ( outfile.fail() )
+	{
+		FileCreateError( filename );
+		return false;
+	}
+	if ( numWeights != NULL ) *numWeights = weights;
+	return true;
+}
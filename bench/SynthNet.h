@@ -0,0 +1,39 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Generator of synthetic networks, for benchmarks of networks of any
+					size. A network has a number of input modules followed by CALM
+					modules, of which the last ones can be CALMMap modules. Each CALM
+					module receives connections from the input modules and the modules
+					before it, the nearest one always, the others chosen at random;
+					a given fraction of these are time-delay connections. Every input
+					pattern has the same number of active nodes, set by the sparsity.
+					The network, parameter and pattern files are written in the usual
+					formats, as "basename.net", "basename.par" and "basename.pat".
+					The same spec and seed always give the same files.
+*/
+
+#ifndef __SYNTHNET__
+#define __SYNTHNET__
+
+struct SynthSpec
+{
+	int			numModules;		// CALM and CALMMap modules
+	int			moduleSize;		// nodes per CALM module
+	int			numInputs;		// input modules
+	int			inputSize;		// nodes per input module, or 0 for moduleSize
+	int			fanIn;			// incoming connections per module
+	double		delayRatio;		// fraction of connections with a time delay
+	int			maxDelay;		// delays are chosen from 1 to maxDelay
+	int			numMaps;		// number of the modules that are CALMMap modules
+	int			numPatterns;
+	double		sparsity;		// fraction of input nodes that are off in a pattern
+	unsigned int seed;
+};
+
+void	SynthDefaults( SynthSpec* spec );
+bool	SynthOption( SynthSpec* spec, char option, const char* value );
+void	SynthUsage( void );
+bool	SynthWrite( SynthSpec* spec, const char* dirname, const char* basename, double* numWeights );
+
+#endif
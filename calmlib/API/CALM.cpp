@@ -8,6 +8,7 @@
 #include "CALM.h"		// class definition for API interface
 #include "Utilities.h"
 #include "Rnd.h"
+#include "CALMWeightFile.h"
 
 
 // This is the inititialization routine. This has to be called first!
@@ -38,18 +39,32 @@ CALMAPI::CALMAPI( void )
 	strcpy( mDirname, "." );
 	mLogFile = NULL;
 	mCALMLog = &cout;
+	mCheckpointWriter = NULL;
+	mCheckpointBuffers = kCheckpointBuffers;
+	mLogWriter = NULL;
+	mResults = NULL;
+	mRecorder = NULL;
+	mTracing = false;
+	mLatency = new CALMLatency[kNumLatencies];
 }
 
 
 // To terminate usage of the API
 CALMAPI::~CALMAPI( void )
 {
-	// close the log file (if it was opened)
+	// write out pending output and close the log file (if it was opened)
+	if ( mLogWriter != NULL ) delete mLogWriter;
+	mLogWriter = NULL;
 	CloseCALMLog();
 	
-	// Clean up!	
+	// Clean up! Pending checkpoints are written first.
+	if ( mCheckpointWriter != NULL ) delete mCheckpointWriter;
+	if ( mResults != NULL ) delete mResults;
+	if ( mRecorder != NULL ) delete mRecorder;
+	CALMStopTrace();
 	if ( mNetwork != nil ) delete mNetwork;
 	if ( mInput != nil ) delete[] mInput;
+	delete[] mLatency;
 
 	// change back to original working directory
 	chdir( mCALMCurDir );
@@ -84,7 +99,7 @@ int CALMAPI::OpenCALMLog( const char* logname )
 		}
 	}
 	// point internal log to this file
-	mCALMLog = mLogFile;
+	SetCALMLog( mLogFile );
 	return kNoErr;
 }
 
@@ -92,10 +107,10 @@ int CALMAPI::OpenCALMLog( const char* logname )
 void CALMAPI::CloseCALMLog( void )
 {
 	if ( mLogFile == NULL ) return;
+	SetCALMLog( &cout );
 	if ( mLogFile->is_open() ) mLogFile->close();
 	delete mLogFile;
 	mLogFile = NULL;
-	mCALMLog = &cout;
 }
 
 
@@ -148,36 +163,36 @@ int CALMAPI::CALMDirectory( bool originalDir )
 // Display simulation environment to cerr
 void CALMAPI::CALMShow( void )
 {
-	*mCALMLog << "Simulation specifics:" << endl;
-	*mCALMLog << "    number of runs           : " << mNumRuns << endl;
-	*mCALMLog << "    number of epochs         : " << mNumEpochs << endl;
-	*mCALMLog << "    number of iterations     : " << mNumIterations << endl;
-	*mCALMLog << "    presentation order       : ";
+	*Log() << "Simulation specifics:" << endl;
+	*Log() << "    number of runs           : " << mNumRuns << endl;
+	*Log() << "    number of epochs         : " << mNumEpochs << endl;
+	*Log() << "    number of iterations     : " << mNumIterations << endl;
+	*Log() << "    presentation order       : ";
 	if ( mOrder == kLinear )
-		*mCALMLog << "linear" << endl;
+		*Log() << "linear" << endl;
 	else
-		*mCALMLog << "permuted" << endl;
-	*mCALMLog << "    terminate at convergence : ";
+		*Log() << "permuted" << endl;
+	*Log() << "    terminate at convergence : ";
 	if ( mConvstop )
-		*mCALMLog << "yes" << endl;
+		*Log() << "yes" << endl;
 	else
-		*mCALMLog << "no" << endl;
-	*mCALMLog << "    verbosity                : ";
+		*Log() << "no" << endl;
+	*Log() << "    verbosity                : ";
 	CALMShowVerbosity( mVerbosity );
-	*mCALMLog << "    file name                : " << mBasename << endl;
-	*mCALMLog << "    directory                : " << mDirname << endl;
+	*Log() << "    file name                : " << mBasename << endl;
+	*Log() << "    directory                : " << mDirname << endl;
 }
 
 
 // Display pattern file
 void CALMAPI::CALMShowPatterns( void )
 {
-	*mCALMLog << "    loaded patterns:" << endl;
-	mNetwork->PrintPatterns( mCALMLog );
+	*Log() << "    loaded patterns:" << endl;
+	mNetwork->PrintPatterns( Log() );
 	if ( mFBOn )
 	{
-		*mCALMLog << "    loaded feedback: ";
-		mNetwork->PrintFeedback( mCALMLog );
+		*Log() << "    loaded feedback: ";
+		mNetwork->PrintFeedback( Log() );
 	}
 }
 
@@ -185,16 +200,16 @@ void CALMAPI::CALMShowPatterns( void )
 // Output the verbosity level in readable format
 void CALMAPI::CALMShowVerbosity( int verbosity )
 {
-	if ( verbosity == O_NONE ) *mCALMLog << "silent mode";
-	if ( verbosity & O_WINNER ) *mCALMLog << "winner ";
-	if ( verbosity & O_ACTASIS ) *mCALMLog << "act ";
-	if ( verbosity & O_ACTPLUS ) *mCALMLog << "act+ ";
-	if ( verbosity & O_POT ) *mCALMLog << "volt ";
-	if ( verbosity & O_WEIGHTS ) *mCALMLog << "wts ";
-	if ( verbosity & O_SAVEDWT ) *mCALMLog << "dwt ";
-	if ( verbosity & O_SAVEACT ) *mCALMLog << "dact ";
-	if ( verbosity & O_SAVEMU ) *mCALMLog << "dmu ";
-	*mCALMLog << endl;
+	if ( verbosity == O_NONE ) *Log() << "silent mode";
+	if ( verbosity & O_WINNER ) *Log() << "winner ";
+	if ( verbosity & O_ACTASIS ) *Log() << "act ";
+	if ( verbosity & O_ACTPLUS ) *Log() << "act+ ";
+	if ( verbosity & O_POT ) *Log() << "volt ";
+	if ( verbosity & O_WEIGHTS ) *Log() << "wts ";
+	if ( verbosity & O_SAVEDWT ) *Log() << "dwt ";
+	if ( verbosity & O_SAVEACT ) *Log() << "dact ";
+	if ( verbosity & O_SAVEMU ) *Log() << "dmu ";
+	*Log() << endl;
 }	
 
 
@@ -366,6 +381,93 @@ int CALMAPI::CALMLoadFeedback( void )
 }
 
 
+// Save the loaded patterns and feedback to a binary pattern file
+int CALMAPI::CALMSaveBinaryPatterns( void )
+{
+	int 	err = kNoErr;
+	char	filename[256];
+	
+	strcpy( filename, mDirname );
+	strcat( filename, "/" );
+	strcat( filename, mBasename );
+	strcat( filename, ".ptb" );
+
+	if ( chdir( mCALMCurDir ) )
+	{
+		cerr << "cannot change directories!" << endl;
+		return kCALMFileError;
+	}
+	if ( ! mNetwork->SaveBinaryPatterns( filename ) )
+	{
+		err = kCALMFileError;
+	}
+	if ( chdir( mCALMLogDir ) )
+	{
+		cerr << "cannot change directories" << filename << endl;
+		err = kCALMFileError;
+	}
+	return err;
+}
+
+
+// Load a binary pattern file, including feedback if it was compiled in
+int CALMAPI::CALMLoadBinaryPatterns( void )
+{
+	int 	err = kNoErr;
+	char	filename[256];
+	
+	strcpy( filename, mDirname );
+	strcat( filename, "/" );
+	strcat( filename, mBasename );
+	strcat( filename, ".ptb" );
+
+	if ( chdir( mCALMCurDir ) )
+	{
+		cerr << "cannot change directories!" << endl;
+		return kCALMFileError;
+	}
+	if ( ! mNetwork->LoadBinaryPatterns( filename ) )
+	{
+		err = kCALMFileError;
+	}
+	if ( chdir( mCALMLogDir ) )
+	{
+		cerr << "cannot change directories" << filename << endl;
+		err = kCALMFileError;
+	}
+	return err;
+}
+
+
+// Stream patterns from a binary pattern file, keeping at most "window" patterns in memory
+int CALMAPI::CALMStreamPatterns( int window )
+{
+	int 	err = kNoErr;
+	char	filename[256];
+	
+	strcpy( filename, mDirname );
+	strcat( filename, "/" );
+	strcat( filename, mBasename );
+	strcat( filename, ".ptb" );
+
+	if ( chdir( mCALMCurDir ) )
+	{
+		cerr << "cannot change directories!" << endl;
+		return kCALMFileError;
+	}
+	if ( ! mNetwork->StreamPatterns( filename, window ) )
+	{
+		err = kCALMFileError;
+	}
+	if ( chdir( mCALMLogDir ) )
+	{
+		cerr << "cannot change directories" << filename << endl;
+		err = kCALMFileError;
+	}
+	return err;
+}
+
+
 // Load parameter file
 int CALMAPI::CALMLoadParameters( void )
 {
@@ -419,6 +521,9 @@ int CALMAPI::CALMTrainSingle( int epoch )
 	int 	i;
 	bool	converged;
 
+	LATENCY_SCOPE( mLatency + kLatTrainSingle );
+	ALLOC_GUARD( "CALMTrainSingle" );
+	TRACE_SCOPE( "train single", epoch );
 	// reset activations and winning node info
 	mNetwork->Reset( O_ACT | O_WIN );
 	mNetwork->ResetWtChangeSum();
@@ -434,17 +539,18 @@ int CALMAPI::CALMTrainSingle( int epoch )
 		if ( converged && mConvstop ) break;
 		// text output if necessary
 		if ( mVerbosity & O_ACTASIS || mVerbosity & O_ACTPLUS )
-			mNetwork->PrintActs( mCALMLog, epoch, i, mVerbosity, true );
+			ShowActs( epoch, i );
 		if ( mVerbosity & O_POT )
-			mNetwork->PrintPotentials( mCALMLog );
+			ShowPotentials();
 	}
 	// save changes in weights if required
 	CALMSaveChanges();
+	if ( mResults != NULL ) mNetwork->RecordResults( mResults, epoch, 0, true );
 	// text output if necessary
 	if ( mVerbosity & O_WEIGHTS )
-		mNetwork->PrintWeights( mCALMLog, epoch, i );
+		ShowWeights( epoch, i );
 	if ( mVerbosity & O_WINNER )
-		mNetwork->PrintWinners( mCALMLog );
+		mNetwork->PrintWinners( Log() );
 	// should return any errors...
 	return 0;
 }
@@ -457,40 +563,49 @@ int CALMAPI::CALMTrainFile( int epoch )
 	int		i, j;
 	bool	converged = false;
 	
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfTrainFile, kUndefined );
+	ALLOC_GUARD( "CALMTrainFile" );
+	TRACE_SCOPE( "train epoch", epoch );
 	mNetwork->Reset( O_WIN );
 	
 	for ( i = 0; i < numPatterns; i++ )
 	{
+		TRACE_SCOPE( "pattern", i );
 		// reset activations and winning node info
 		mNetwork->Reset( O_ACT );
 		mNetwork->ResetWtChangeSum();
 		// set the current pattern
 		mNetwork->SetInput(i);
 		if ( mFBOn ) mNetwork->SetFeedback(i);	
+		if ( mRecorder != NULL ) mRecorder->Clear();
 		// iterate the pattern
 		for ( j = 0; j < mNumIterations; j++ )
 		{
+			TRACE_SCOPE( CALMTrace::Sampled( j ) ? "iteration" : NULL, j );
 			mNetwork->Learn();
 			// save changes in weights if required
 			// collect the winners
 			converged = mNetwork->CollectWinners( i, j );
+			if ( mRecorder != NULL ) FlightRecord( epoch, j );
 			if ( converged && mConvstop ) break;
 			// text output if necessary
 			if ( mVerbosity & O_ACTASIS )
-				mNetwork->PrintActs( mCALMLog, epoch, j, mVerbosity, true );
+				ShowActs( epoch, j );
 		}	
+		if ( mRecorder != NULL && ! converged ) FlightDump( epoch, i );
 		// save changes in weights if required
 		CALMSaveChanges();
+		if ( mResults != NULL ) mNetwork->RecordResults( mResults, epoch, i, true );
 		// text output if necessary
 		if ( mVerbosity & O_ACTPLUS )
-			mNetwork->PrintActs( mCALMLog, epoch, mNumIterations, mVerbosity, true );
+			ShowActs( epoch, mNumIterations );
 		if ( mVerbosity & O_POT )
-			mNetwork->PrintPotentials( mCALMLog );
+			ShowPotentials();
 		if ( mVerbosity & O_WEIGHTS )
-			mNetwork->PrintWeights( mCALMLog, epoch, i );
+			ShowWeights( epoch, i );
 	}	
 	if ( mVerbosity & O_WINNER )
-		mNetwork->PrintWinners( mCALMLog );
+		mNetwork->PrintWinners( Log() );
 	
 	// should return any errors...
 	return 0;
@@ -505,6 +620,9 @@ int CALMAPI::CALMTestSingle( int epoch )
 	int 	i;
 	bool	converged;
 	
+	LATENCY_SCOPE( mLatency + kLatTestSingle );
+	ALLOC_GUARD( "CALMTestSingle" );
+	TRACE_SCOPE( "test single", epoch );
 	// reset activations and winning node info
 	mNetwork->Reset( O_ACT | O_WIN );
 	// set the current pattern
@@ -518,10 +636,11 @@ int CALMAPI::CALMTestSingle( int epoch )
 		if ( converged && mConvstop ) break;
 		// text output if necessary
 		if ( mVerbosity & O_ACTASIS || mVerbosity & O_ACTPLUS )
-			mNetwork->PrintActs( mCALMLog, epoch, i, mVerbosity, true );
+			ShowActs( epoch, i );
 	}
+	if ( mResults != NULL ) mNetwork->RecordResults( mResults, epoch, 0, false );
 	if ( mVerbosity & O_WINNER )
-		mNetwork->PrintWinners( mCALMLog );
+		mNetwork->PrintWinners( Log() );
 		
 	// should return any errors...
 	return 0;
@@ -535,6 +654,9 @@ int CALMAPI::CALMTestSingle( int epoch, bool useNoise )
 	int 	i;
 	bool	converged;
 	
+	LATENCY_SCOPE( mLatency + kLatTestSingle );
+	ALLOC_GUARD( "CALMTestSingle" );
+	TRACE_SCOPE( "test single", epoch );
 	// reset activations and winning node info except
 	// for clamped units (note that this will also set input to zeros
 	mNetwork->Reset( O_ACT | O_WIN );
@@ -548,9 +670,10 @@ int CALMAPI::CALMTestSingle( int epoch, bool useNoise )
 		if ( converged && mConvstop ) break;
 		// text output if necessary
 		if ( mVerbosity & O_ACTASIS || mVerbosity & O_ACTPLUS )
-			mNetwork->PrintActs( mCALMLog, epoch, i, mVerbosity, true );
+			ShowActs( epoch, i );
 	}
-	if ( mVerbosity & O_WINNER ) mNetwork->PrintCurrentWinners( mCALMLog );
+	if ( mResults != NULL ) mNetwork->RecordResults( mResults, epoch, 0, false );
+	if ( mVerbosity & O_WINNER ) mNetwork->PrintCurrentWinners( Log() );
 		
 	// should return any errors...
 	return 0;
@@ -565,29 +688,38 @@ int CALMAPI::CALMTestFile( int epoch )
 	bool		converged = false;
 //	data_type	tmpER = CALMGetParameter( ER );
 	
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfTestFile, kUndefined );
+	ALLOC_GUARD( "CALMTestFile" );
+	TRACE_SCOPE( "test epoch", epoch );
 	mNetwork->Reset( O_WIN );
 	for ( i = 0; i < numPatterns; i++ )
 	{
+		TRACE_SCOPE( "pattern", i );
 		// reset activations and winning node info
 		mNetwork->Reset( O_ACT );
 		// set the current pattern
 		mNetwork->SetInput(i);
+		if ( mRecorder != NULL ) mRecorder->Clear();
 		// iterate the pattern
 		for ( j = 0; j < mNumIterations; j++ )
 		{
+			TRACE_SCOPE( CALMTrace::Sampled( j ) ? "iteration" : NULL, j );
 			mNetwork->Test();
 			// collect the winners
 			converged = mNetwork->CollectWinners( i, j );
+			if ( mRecorder != NULL ) FlightRecord( epoch, j );
 			if ( converged && mConvstop ) break;
 			// text output if necessary
 			if ( mVerbosity & O_ACTASIS )
-				mNetwork->PrintActs( mCALMLog, epoch, j, mVerbosity, true );
+				ShowActs( epoch, j );
 		}			
+		if ( mRecorder != NULL && ! converged ) FlightDump( epoch, i );
 		if ( mVerbosity & O_ACTPLUS )
-			mNetwork->PrintActs( mCALMLog, epoch, mNumIterations, mVerbosity, true );
+			ShowActs( epoch, mNumIterations );
+		if ( mResults != NULL ) mNetwork->RecordResults( mResults, epoch, i, false );
 	}
 	if ( mVerbosity & O_WINNER )
-		mNetwork->PrintWinners( mCALMLog );
+		mNetwork->PrintWinners( Log() );
 	
 	// should return any errors...
 	return 0;
@@ -600,13 +732,15 @@ bool CALMAPI::CALMTest( int i, bool useNoise )
 {
 	bool	converged;
 	
+	LATENCY_SCOPE( mLatency + kLatTest );
+	ALLOC_GUARD( "CALMTest" );
 	mNetwork->Test( useNoise );
 	// collect the winners
 	converged = mNetwork->CollectWinners( 0, i );
 	if ( converged && mConvstop ) return true;
 	// text output if necessary
 	if ( mVerbosity & O_ACTASIS || mVerbosity & O_ACTPLUS )
-		mNetwork->PrintActs( mCALMLog, 0, i, mVerbosity, true );
+		ShowActs( 0, i );
 	return false;
 }
 
@@ -615,12 +749,42 @@ bool CALMAPI::CALMTest( int i, bool useNoise )
 // Will save various data to file if specified
 void CALMAPI::CALMSaveChanges( void )
 {
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfOutput, kUndefined );
 	if ( mVerbosity & O_SAVEDWT ) mNetwork->SaveWeightChanges();		
 	if ( mVerbosity & O_SAVEACT ) mNetwork->SaveActChanges();		
 	if ( mVerbosity & O_SAVEMU )  mNetwork->SaveMuChanges();		
 }
 
 
+// Starts recording the results of every pattern trained or tested to
+// "filename.res", or to "filename.<column>.npy" with npy set
+int CALMAPI::CALMOpenResults( char const *filename, bool npy )
+{
+	CALMCloseResults();
+	mResults = new CALMResults;
+	if ( mResults->Open( filename, npy ) ) return kNoErr;
+	delete mResults;
+	mResults = NULL;
+	return kCALMFileError;
+}
+
+
+// Writes the remaining results and closes the file(s)
+int CALMAPI::CALMCloseResults( void )
+{
+	bool ok;
+	
+	if ( mResults == NULL ) return kNoErr;
+	ok = mResults->Close();
+	delete mResults;
+	mResults = NULL;
+	if ( ok )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
 void CALMAPI::CALMSetVerbosity( int level )
 {
 	mVerbosity = level;
@@ -631,6 +795,100 @@ void CALMAPI::CALMSetVerbosity( int level )
 }
 
 
+// With an asynchronous log, activation output during training and testing is
+// copied into a buffer and formatted into the log by a background thread. Other
+// output waits for it, so the log reads the same as without.
+void CALMAPI::CALMSetAsyncLog( bool async )
+{
+	if ( async && mLogWriter == NULL )
+		mLogWriter = new CALMLogWriter( mCALMLog );
+	else if ( ! async && mLogWriter != NULL )
+	{
+		delete mLogWriter;
+		mLogWriter = NULL;
+	}
+}
+
+
+// Keeps the activations of the last "numIterations" iterations of each pattern 
+// presented by CALMTrainFile and CALMTestFile. If a pattern does not converge,
+// they are appended to "filename.fdr". Pass zero to stop.
+int CALMAPI::CALMSetFlightRecorder( int numIterations, char const *filename )
+{
+	char tmpname[256];
+	
+	if ( mRecorder != NULL ) delete mRecorder;
+	mRecorder = NULL;
+	if ( numIterations <= 0 ) return kNoErr;
+	
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".fdr" );
+	mRecorder = new CALMFlightRecorder( numIterations );
+	// the slots are allocated now for the network as set up, not while training
+	mRecorder->Reserve( mNetwork->ActsRecordSize( true ) );
+	if ( mRecorder->Open( tmpname ) ) return kNoErr;
+	delete mRecorder;
+	mRecorder = NULL;
+	return kCALMFileError;
+}
+
+
+// Appends the iterations currently held by the flight recorder to its file
+void CALMAPI::CALMDumpFlightRecorder( void )
+{
+	if ( mRecorder != NULL ) mRecorder->Dump( "Requested dump" );
+}
+
+
+void CALMAPI::FlightRecord( int epoch, int ite )
+{
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfOutput, kUndefined );
+	char* slot = mRecorder->Next( mNetwork->ActsRecordSize( true ) );
+	mNetwork->FillActsRecord( slot, epoch, ite, O_ACTASIS, true );
+}
+
+
+void CALMAPI::FlightDump( int epoch, int pIdx )
+{
+	char reason[128];
+	
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfOutput, kUndefined );
+	snprintf( reason, 128, "\nPattern %d did not converge in epoch %d", mNetwork->PatternIndex( pIdx ), epoch );
+	mRecorder->Dump( reason );
+}
+
+
+// activation output for each iteration
+void CALMAPI::ShowActs( int epoch, int ite )
+{
+	PROFILE_SCOPE( mNetwork->GetProfiler(), kProfOutput, kUndefined );
+	if ( mLogWriter != NULL )
+		mNetwork->RecordActs( mLogWriter, epoch, ite, mVerbosity, true );
+	else
+		mNetwork->PrintActs( mCALMLog, epoch, ite, mVerbosity, true );
+}
+
+
+// potentials after a pattern
+void CALMAPI::ShowPotentials( void )
+{
+	if ( mLogWriter != NULL )
+		mNetwork->RecordPotentials( mLogWriter );
+	else
+		mNetwork->PrintPotentials( mCALMLog );
+}
+
+
+// weights after a pattern
+void CALMAPI::ShowWeights( int epoch, int pIdx )
+{
+	if ( mLogWriter != NULL )
+		mNetwork->RecordWeights( mLogWriter, epoch, pIdx );
+	else
+		mNetwork->PrintWeights( mCALMLog, epoch, pIdx );
+}
+
+
 // Saves weights to file. Only pass base name without suffix. 
 // The file will be created in the network files directory with
 // .wts suffixed. 
@@ -642,6 +900,7 @@ void CALMAPI::CALMSaveWeights( char const *filename )
 	strcat( tmpname, "/" );
 	strcpy( tmpname, filename );
 	strcat( tmpname, ".wts" );
+	LATENCY_SCOPE( mLatency + kLatSaveWeights );
 	mNetwork->SaveWeights( tmpname );
 }
 
@@ -657,6 +916,7 @@ int CALMAPI::CALMLoadWeights( char const *filename )
 	strcat( tmpname, "/" );
 	strcpy( tmpname, filename );
 	strcat( tmpname, ".wts" );
+	LATENCY_SCOPE( mLatency + kLatLoadWeights );
 	if ( mNetwork->LoadWeights( tmpname ) )
 		return kNoErr;
 	else
@@ -664,6 +924,132 @@ int CALMAPI::CALMLoadWeights( char const *filename )
 }
 
 
+// Saves weights in binary format. Only pass base name without suffix,
+// .wtb will be added. 
+void CALMAPI::CALMSaveBinaryWeights( char const *filename )
+{
+	char tmpname[256];
+
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".wtb" );
+	LATENCY_SCOPE( mLatency + kLatSaveWeights );
+	mNetwork->SaveBinaryWeights( tmpname );
+}
+
+
+// Loads weights from a binary file. Only pass base name without suffix.
+int CALMAPI::CALMLoadBinaryWeights( char const *filename )
+{
+	char tmpname[256];
+	
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".wtb" );
+	LATENCY_SCOPE( mLatency + kLatLoadWeights );
+	if ( mNetwork->LoadBinaryWeights( tmpname ) )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
+// Saves the complete training state: weights, node activations, module sizes,
+// winners, pattern order and random number generators. Only pass base name 
+// without suffix, .ckp will be added.
+int CALMAPI::CALMSaveCheckpoint( char const *filename )
+{
+	char tmpname[256];
+
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".ckp" );
+	if ( mNetwork->SaveCheckpoint( tmpname ) )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
+// Continues from a checkpoint. Only pass base name without suffix.
+int CALMAPI::CALMLoadCheckpoint( char const *filename )
+{
+	char tmpname[256];
+	
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".ckp" );
+	if ( mNetwork->LoadCheckpoint( tmpname ) )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
+// Takes a snapshot for a checkpoint and writes it to "filename.ckp" in the 
+// background, while training continues. The file is synced to disk before 
+// "done" is called with the result, on the writer thread. Only waits if
+// the previous checkpoints are all still being written.
+void CALMAPI::CALMSaveCheckpointAsync( char const *filename, CALMCheckpointDone done, void* data )
+{
+	char tmpname[256];
+
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".ckp" );
+	if ( mCheckpointWriter == NULL ) mCheckpointWriter = new CALMCheckpointWriter( mCheckpointBuffers );
+	mCheckpointWriter->Submit( mNetwork, tmpname, done, data );
+}
+
+
+// Waits until all background checkpoints are written
+int CALMAPI::CALMWaitCheckpoints( void )
+{
+	if ( mCheckpointWriter == NULL || mCheckpointWriter->Wait() )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
+// Sets the number of checkpoints that can be waiting to be written
+void CALMAPI::CALMSetCheckpointBuffers( int numBuffers )
+{
+	mCheckpointBuffers = numBuffers;
+	if ( mCheckpointWriter != NULL ) delete mCheckpointWriter;
+	mCheckpointWriter = NULL;
+}
+
+
+// Converts the text weight file "filename.wts" to "filename.wtb"
+int CALMAPI::CALMWeightsToBinary( char const *filename )
+{
+	char textname[256];
+	char binname[256];
+	
+	strcpy( textname, filename );
+	strcat( textname, ".wts" );
+	strcpy( binname, filename );
+	strcat( binname, ".wtb" );
+	if ( CALMWeightFile::TextToBinary( textname, binname ) )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
+// Converts the binary weight file "filename.wtb" to "filename.wts"
+int CALMAPI::CALMWeightsToText( char const *filename )
+{
+	char textname[256];
+	char binname[256];
+	
+	strcpy( textname, filename );
+	strcat( textname, ".wts" );
+	strcpy( binname, filename );
+	strcat( binname, ".wtb" );
+	if ( CALMWeightFile::BinaryToText( binname, textname ) )
+		return kNoErr;
+	else
+		return kCALMFileError;
+}
+
+
 int	CALMAPI::CALMReadSpecs( char* filename )
 {
 	ifstream	infile;
@@ -671,6 +1057,7 @@ int	CALMAPI::CALMReadSpecs( char* filename )
 	char		mdlname[32];
 	int			mdltype, mdlsize, mdlidx, mdlconn, link, delay;
 	int			i, j;
+	size_t		memory;
 	
 	// open the file
 	infile.open( filename );
@@ -680,6 +1067,11 @@ int	CALMAPI::CALMReadSpecs( char* filename )
 		return kCALMFileError;
 	}
 	
+	// find out how much memory the network needs, then start over
+	memory = SpecsMemory( &infile );
+	infile.clear();
+	infile.seekg( 0 );
+
 	// read in number of CALM modules
 	SkipComments( &infile );		// ignore any strings starting with #
 	infile >> mNumModules;
@@ -688,7 +1080,7 @@ int	CALMAPI::CALMReadSpecs( char* filename )
 	infile >> mNumInputs;
 
 	// set up the module array
-	mNetwork->SetNumModules( mNumModules, mNumInputs );
+	mNetwork->SetNumModules( mNumModules, mNumInputs, memory );
 	
 	// read in each module. Pattern modules should be specified first, 
 	// before all other module types.
@@ -748,6 +1140,70 @@ int	CALMAPI::CALMReadSpecs( char* filename )
 }
 
 
+// Reads through a network specification file to add up the memory needed for 
+// all modules and connections, so that the network can be set up in one block
+size_t CALMAPI::SpecsMemory( ifstream* infile )
+{
+	char		dummy[32];
+	char		mdlname[32];
+	char		(*names)[32];
+	int*		sizes;
+	int			numModules, numInputs, mdltype, mdlidx, mdlconn, delay;
+	int			i, j, k;
+	size_t		memory;
+	
+	SkipComments( infile );
+	*infile >> numModules;
+	SkipComments( infile );
+	*infile >> numInputs;
+	if ( infile->fail() || numModules < 0 || numInputs < 0 ) return kArenaChunk;
+	
+	names = new char[numModules+numInputs][32];
+	sizes = new int[numModules+numInputs];
+	memory = CALMArena::Aligned( ( numModules + numInputs ) * sizeof(Module*) );
+	for ( i = 0; i < numModules+numInputs; i++ )
+	{
+		SkipComments( infile );
+		*infile >> names[i];
+		SkipComments( infile );
+		*infile >> dummy;
+		SkipComments( infile );
+		*infile >> sizes[i];
+		mdltype = ( strcmp( "map", dummy ) == 0 ) ? O_MAP : ( strcmp( "fb", dummy ) == 0 ) ? O_FB : O_CALM;
+		memory += CALMNetwork::ModuleMemory( mdltype, sizes[i], 0 );
+	}
+	for ( i = 0; i < numModules && ! infile->fail(); i++ )
+	{
+		SkipComments( infile );
+		*infile >> mdlname;
+		for ( mdlidx = 0; mdlidx < numModules+numInputs-1; mdlidx++ )
+			if ( strcmp( mdlname, names[mdlidx] ) == 0 ) break;
+		SkipComments( infile );
+		*infile >> mdlconn;
+		memory += CALMNetwork::ModuleMemory( O_CALM, 0, mdlconn ) - CALMNetwork::ModuleMemory( O_CALM, 0, 0 );
+		for ( j = 0; j < mdlconn; j++ )
+		{	
+			SkipComments( infile );
+			*infile >> mdlname;
+			SkipComments( infile );
+			*infile >> dummy;
+			if ( ConnectionType( dummy ) == kDelayLink )
+			{
+				SkipComments( infile );
+				*infile >> delay;
+			}
+			for ( k = 0; k < numModules+numInputs-1; k++ )
+				if ( strcmp( mdlname, names[k] ) == 0 ) break;
+			memory += CALMNetwork::ConnectionMemory( sizes[mdlidx], sizes[k] );
+		}			
+	}
+	delete[] names;
+	delete[] sizes;
+	
+	return memory;
+}
+
+
 int	CALMAPI::ModuleType( char* typeStr )
 {
 	if ( strcmp( "input", typeStr ) == 0 ) return O_INP;
@@ -771,6 +1227,99 @@ int	CALMAPI::ConnectionType( char* typeStr )
 }
 
 
+// Counts the cycles spent in each phase of training and testing, for each module,
+// from now on, and with "counters", the hardware events of this thread as well.
+// Switching it off again discards the counts.
+void CALMAPI::CALMSetProfiling( bool on, bool counters )
+{
+	mNetwork->SetProfiling( on, counters );
+#if !CALM_PROFILE
+	if ( on ) cerr << "profiling was not compiled in (see CALM_PROFILE)" << endl;
+#endif
+}
+
+
+void CALMAPI::CALMShowProfile( ostream* os )
+{
+	if ( mNetwork->GetProfiler() != NULL ) mNetwork->GetProfiler()->Print( os, mNetwork );
+}
+
+
+// Writes the profile counters as JSON to "filename.prof.json"
+int CALMAPI::CALMSaveProfile( char const *filename )
+{
+	char tmpname[256];
+
+	if ( mNetwork->GetProfiler() == NULL ) return kNoErr;
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".prof.json" );
+	if ( mNetwork->GetProfiler()->Save( tmpname, mNetwork ) ) return kNoErr;
+	return kCALMFileError;
+}
+
+
+// The bytes that module "idx" takes now, with its incoming connections, or
+// with kUndefined, those of the network itself (patterns and winners)
+size_t CALMAPI::CALMGetModuleMemory( int idx )
+{
+	size_t	bytes[kNumMemCategories] = { 0 };
+	size_t	total = 0;
+
+	mNetwork->CountMemory( idx, bytes );
+	for ( int c = 0; c < kNumMemCategories; c++ ) total += bytes[c];
+	return total;
+}
+
+
+// Starts a trace of the run; all threads record into it, including those of
+// other APIs and of AnalysisTools. Fails if tracing was not compiled in, since
+// the trace file would never be written.
+int CALMAPI::CALMStartTrace( char const *filename, int sampling )
+{
+#if CALM_TRACE
+	char tmpname[256];
+
+	strcpy( tmpname, filename );
+	strcat( tmpname, ".trace.json" );
+	mTracing = CALMTrace::Start( tmpname, sampling );
+	return mTracing ? kNoErr : kCALMFileError;
+#else
+	cerr << "tracing was not compiled in (see CALM_TRACE)" << endl;
+	return kCALMFileError;
+#endif
+}
+
+
+// Writes the trace, after the pending log output. To include the checkpoints
+// still being written, call CALMWaitCheckpoints first.
+int CALMAPI::CALMStopTrace( void )
+{
+	bool ok;
+
+	if ( ! mTracing ) return kNoErr;
+	mTracing = false;
+	if ( mLogWriter != NULL ) mLogWriter->Flush();
+	ok = CALMTrace::Stop();
+	return ok ? kNoErr : kCALMFileError;
+}
+
+
+// The latency of "call" in microseconds, at "quantile" of the calls since the
+// last reset
+double CALMAPI::CALMGetLatency( int call, double quantile )
+{
+	return mLatency[call].GetPercentile( quantile ) * 1e-3;
+}
+
+
+// Starts the latency histograms of all calls afresh. This only marks them, so
+// it may be called from another thread as well.
+void CALMAPI::CALMResetLatency( void )
+{
+	for ( int i = 0; i < kNumLatencies; i++ ) mLatency[i].Reset();
+}
+
+
 void CALMAPI::CALMSpeedTest( bool start )
 {
 	if ( start == kStart )
@@ -790,8 +1339,8 @@ void CALMAPI::CALMSpeedTest( bool start )
 		tmpMins = tmpMins % 60;
 		tmpMicro = (long)mCALMEndTime;
 		tmpMicro = tmpMicro % 60;
-		PrintNext( mCALMLog, kReturn );
-		PrintNext( mCALMLog, kIntend );
+		PrintNext( Log(), kReturn );
+		PrintNext( Log(), kIntend );
 		cerr << "\nsimulation took ";
 		if ( tmpHrs > 0 ) 
 			cerr << tmpHrs << " hours, " << tmpMins << " minutes, " << tmpSecs << " seconds and " << tmpMicro << " microsecs\n";
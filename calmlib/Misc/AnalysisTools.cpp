@@ -5,6 +5,8 @@
 					nonlinear dynamics behavior of CALM nets, producing images as output.
 */
 
+#include <limits.h>
+#include <thread>
 #include "CALMGlobal.h"	// contains project wide definitions and the like
 #include "Utilities.h"
 #include "AnalysisTools.h"
@@ -34,9 +36,11 @@ AnalysisTools::AnalysisTools()
 	mRGBPixels = NULL;
 	mBifurcations = NULL;
 	mPhases = NULL;
+	mPhaseValues = NULL;
 	pgmImage = new PGMImage;
 	mTransients = 0;
 	mIterations = 1000;
+	mNumThreads = Max( (int)thread::hardware_concurrency(), 1 );
 }
 
 AnalysisTools::~AnalysisTools()
@@ -46,12 +50,12 @@ AnalysisTools::~AnalysisTools()
 	if ( mRGBPixels != NULL )
 	{
 		for ( int i = 0; i < 3; i++ )
-			DisposeMatrix( mRGBPixels[i], mYRes );
+			DisposePixels( mRGBPixels[i], mYRes, mXRes );
 		delete[] mRGBPixels;
 	}
 
-	if ( mGrayPixels != NULL ) DisposeMatrix( mGrayPixels, mYRes );
-	if ( mBifurcations != NULL ) DisposeMatrix( mBifurcations, mIterations );
+	if ( mGrayPixels != NULL ) DisposePixels( mGrayPixels, mYRes, mXRes );
+	if ( mBifurcations != NULL ) DisposePixels( mBifurcations, mIterations, mXRes );
 
 	if ( mPhases != NULL ) delete mPhases;
 	if ( pgmImage != NULL ) delete pgmImage;
@@ -80,42 +84,119 @@ void AnalysisTools::InitializeBoundaryMatrix( char const *mod, char const *inp,
 	// allocate pixels for convergencemap
 	mRGBPixels = new data_type**[3];
 	for ( int i = 0; i < 3; i++ )
-		mRGBPixels[i] = CreateMatrix( 1.0, mYRes * (mInputLength-1), mXRes * (mInputLength-1));
+		mRGBPixels[i] = NewPixels( 1.0, mYRes * (mInputLength-1), mXRes * (mInputLength-1));
 }
 
-void AnalysisTools::FillBoundaryMatrix( int p, int q )
+// Computes a number of image rows (or columns) using several threads. Each thread 
+// gets its own copy of the network and input pattern, and keeps taking the next 
+// unprocessed item until all are done. This only gives the same image as a 
+// sequential run if the items do not depend on each other, so if parallel is 
+// false, all items are computed in order on the network of the API itself.
+void AnalysisTools::FillParallel( int numItems, ItemFiller fill, int p, int q, bool parallel )
 {
-	data_type	x, y;
-	int			i, j, epoch, ite;
-	int			winner;
-
-	for ( i = 0; i < mYRes; i++ ) 
+	AnalysisWorker*	workers;
+	thread*			threads;
+	atomic<int>		nextItem( 0 );
+	int				numThreads = Min( mNumThreads, numItems );
+	int				t, h;
+
+	TRACE_SCOPE( "image", numItems );
+	if ( ! parallel || numThreads <= 1 )
 	{
-		y = i * mYStep;
-		mInput[p] = y;
+		AnalysisWorker worker = { gCALMAPI->CALMGetNetwork(), mInput, NULL, mRGBPixels, pgmImage };
+		worker.buffer = new data_type[mIterations];
+		FillItems( &worker, &nextItem, numItems, fill, p, q );
+		delete[] worker.buffer;
+		return;
+	}
 
-		for ( j = 0; j < mXRes; j++ ) 
+	// phase plots each need their own image, which is allocated when needed
+	workers = new AnalysisWorker[numThreads];
+	threads = new thread[numThreads];
+	for ( t = 0; t < numThreads; t++ )
+	{
+		workers[t].network = gCALMAPI->CALMGetNetwork()->Clone();
+		workers[t].input = new data_type[mInputLength];
+		for ( h = 0; h < mInputLength; h++ ) workers[t].input[h] = mInput[h];
+		workers[t].buffer = new data_type[mIterations];
+		workers[t].pixels = NULL;
+		workers[t].image = NULL;
+		threads[t] = thread( &AnalysisTools::FillItems, this, &workers[t], &nextItem, numItems, fill, p, q );
+	}
+	for ( t = 0; t < numThreads; t++ )
+	{
+		threads[t].join();
+		delete workers[t].network;
+		delete[] workers[t].input;
+		delete[] workers[t].buffer;
+		if ( workers[t].pixels != NULL )
 		{
-			x = j * mXStep;
-			mInput[q] = x;
+			for ( h = 0; h < 3; h++ ) DisposePixels( workers[t].pixels[h], mYRes, mXRes );
+			delete[] workers[t].pixels;
+		}
+		if ( workers[t].image != NULL ) delete workers[t].image;
+	}
+	delete[] threads;
+	delete[] workers;
+}
 
-			gCALMAPI->CALMReset( O_TIME | O_ACT | O_WIN );
+// thread routine: process items until none are left
+void AnalysisTools::FillItems( AnalysisWorker* worker, atomic<int>* nextItem, int numItems, 
+							   ItemFiller fill, int p, int q )
+{
+	int item;
+	
+	if ( worker->network != gCALMAPI->CALMGetNetwork() ) TRACE_THREAD( "analysis worker" );
+	while ( ( item = nextItem->fetch_add( 1 ) ) < numItems )
+	{
+		TRACE_SCOPE( "tile", item );
+		(this->*fill)( worker, item, p, q );
+	}
+}
 
-			gCALMAPI->CALMSetInput( mPatIdx, mInput );	// set custom input
 
-			for ( epoch = 0; epoch < 10; epoch++ )
-			{
-				gCALMAPI->CALMReset( O_ACT | O_WIN ); // clean winners and activations
-				for ( ite = 0; ite < mIterations; ite++ ) gCALMAPI->CALMTest( ite, false );
-			}
-			winner = gCALMAPI->CALMGetWinnerForModule( mModIdx );
-			if ( winner != kNoWinner )
+// every pixel starts from fully reset activations and time delays, so the rows
+// of the matrix can always be computed in parallel
+void AnalysisTools::FillBoundaryMatrix( int p, int q )
+{
+	FillParallel( mYRes, &AnalysisTools::FillBoundaryMatrixRow, p, q, true );
+}
+
+void AnalysisTools::FillBoundaryMatrixRow( AnalysisWorker* worker, int i, int p, int q )
+{
+	CALMNetwork*	net = worker->network;
+	data_type		x, y;
+	int				j, epoch, ite;
+	int				winner;
+
+	y = i * mYStep;
+	worker->input[p] = y;
+
+	for ( j = 0; j < mXRes; j++ ) 
+	{
+		x = j * mXStep;
+		worker->input[q] = x;
+
+		net->Reset( O_TIME | O_ACT | O_WIN );
+
+		net->SetInput( mPatIdx, worker->input );	// set custom input
+
+		for ( epoch = 0; epoch < 10; epoch++ )
+		{
+			net->Reset( O_ACT | O_WIN ); // clean winners and activations
+			for ( ite = 0; ite < mIterations; ite++ )
 			{
-				mRGBPixels[0][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].r;
-				mRGBPixels[1][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].g;
-				mRGBPixels[2][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].b;
+				net->Test( false );
+				net->CollectWinners( 0, ite );
 			}
 		}
+		winner = net->GetWinner( mModIdx );
+		if ( winner != kNoWinner )
+		{
+			mRGBPixels[0][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].r;
+			mRGBPixels[1][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].g;
+			mRGBPixels[2][i+mYRes*p][j+mXRes*(q-1)] = colors[winner].b;
+		}
 	}
 }
 
@@ -148,7 +229,7 @@ void AnalysisTools::MatrixBoundaryForOnline( int run, data_type* pat, char const
 	if ( mRGBPixels != NULL )
 	{
 		for ( int i = 0; i < 3; i++ )
-			DisposeMatrix( mRGBPixels[i], mYRes * (mInputLength-1) );
+			DisposePixels( mRGBPixels[i], mYRes * (mInputLength-1), mXRes * (mInputLength-1) );
 		delete[] mRGBPixels;
 	}
 	mRGBPixels = NULL;
@@ -172,7 +253,7 @@ void AnalysisTools::InitializeBoundary( char const *mod, char const *inp, int xr
 		
 	// allocate pixels for convergencemap
 	mRGBPixels = new data_type**[3];
-	for ( int i = 0; i < 3; i++ ) mRGBPixels[i] = CreateMatrix( 0.0, mYRes, mXRes );
+	for ( int i = 0; i < 3; i++ ) mRGBPixels[i] = NewPixels( 0.0, mYRes, mXRes );
 
 	// set empty input pattern
 	mInputLength = gCALMAPI->CALMGetModuleSize( mPatIdx );
@@ -180,36 +261,43 @@ void AnalysisTools::InitializeBoundary( char const *mod, char const *inp, int xr
 }
 
 
+// pixels only carry over state from previous pixels through time-delay connections,
+// so without them the rows can be computed in parallel
 void AnalysisTools::FillBoundary( int p, int q )
 {
-	data_type	x, y;
-	int			i, j, ite;
-	int			winner;
+	FillParallel( mYRes, &AnalysisTools::FillBoundaryRow, p, q, 
+				  ! gCALMAPI->CALMGetNetwork()->HasDelayLinks() );
+}
 
-	for ( i = 0; i < mYRes; i++ ) 
-	{
-		y = i * mYStep;
-		mInput[p] = y;
+void AnalysisTools::FillBoundaryRow( AnalysisWorker* worker, int i, int p, int q )
+{
+	CALMNetwork*	net = worker->network;
+	data_type		x, y;
+	int				j, ite;
+	int				winner;
 
-		for ( j = 0; j < mXRes; j++ ) 
-		{
-			x = j * mXStep;
-			mInput[q] = x;
+	y = i * mYStep;
+	worker->input[p] = y;
 
-			gCALMAPI->CALMReset( O_ACT | O_WIN ); 	   // clean winners and activations
-			gCALMAPI->CALMSetInput( mPatIdx, mInput ); // set custom input
+	for ( j = 0; j < mXRes; j++ ) 
+	{
+		x = j * mXStep;
+		worker->input[q] = x;
 
-			for ( ite = 0; ite < mIterations; ite++ )
+		net->Reset( O_ACT | O_WIN ); 	   		// clean winners and activations
+		net->SetInput( mPatIdx, worker->input );	// set custom input
+
+		for ( ite = 0; ite < mIterations; ite++ )
+		{
+			net->Test( false );
+			net->CollectWinners( 0, ite );
+			winner = net->GetWinner( mModIdx );
+			if ( winner != kNoWinner )
 			{
-				gCALMAPI->CALMTest( ite, false );
-				winner = gCALMAPI->CALMGetWinnerForModule( mModIdx );
-				if ( winner != kNoWinner )
-				{
-					mRGBPixels[0][i][j] = colors[winner].r;
-					mRGBPixels[1][i][j] = colors[winner].g;
-					mRGBPixels[2][i][j] = colors[winner].b;
-					break;
-				}
+				mRGBPixels[0][i][j] = colors[winner].r;
+				mRGBPixels[1][i][j] = colors[winner].g;
+				mRGBPixels[2][i][j] = colors[winner].b;
+				break;
 			}
 		}
 	}
@@ -288,10 +376,10 @@ void AnalysisTools::InitializeBifurcationClamp( int xres, int yres, int trans,
 	strcpy( mDirName, "bifs/" );
 		
 	// allocate pixels for bifurcation plot
-	mGrayPixels = CreateMatrix( 255.0, mYRes, mXRes );
+	mGrayPixels = NewPixels( 255.0, mYRes, mXRes );
 	
 	// allocate buffer for bifurcations
-	mBifurcations = CreateMatrix( 1.0, mIterations, mXRes );
+	mBifurcations = NewPixels( 1.0, mIterations, mXRes );
 }
 
 
@@ -391,10 +479,7 @@ void AnalysisTools::InitializeBifurcation( char const *inp, int xres, int yres,
 	strcpy( mDirName, "bifs/" );
 		
 	// allocate pixels for bifurcation plot
-	mGrayPixels = CreateMatrix( 255.0, mYRes, mXRes );
-	
-	// allocate buffer for bifurcations
-	mBifurcations = CreateMatrix( 1.0, mIterations, mXRes );
+	mGrayPixels = NewPixels( 255.0, mYRes, mXRes );
 		
 	// set empty input pattern
 	mInputLength = gCALMAPI->CALMGetModuleSize( mPatIdx );
@@ -402,47 +487,50 @@ void AnalysisTools::InitializeBifurcation( char const *inp, int xres, int yres,
 }
 
 
-void AnalysisTools::FillBifurcation( int p, data_type** maxmins )
+// Each column of a bifurcation plot is scaled on its own, so columns are computed
+// independently, in parallel unless time-delay connections link them together
+void AnalysisTools::FillBifurcation( int p )
 {
+	FillParallel( mXRes, &AnalysisTools::FillBifurcationColumn, p, 0, 
+				  ! gCALMAPI->CALMGetNetwork()->HasDelayLinks() );
+}
+
+void AnalysisTools::FillBifurcationColumn( AnalysisWorker* worker, int j, int p, int q )
+{
+	CALMNetwork*	net = worker->network;
+	data_type*		acts = worker->buffer;
+	data_type		maxi = 0.0, mini = INT_MAX, maxmin;
 	int				bit;
-	data_type		maxmin;
-	int				i, j, ite;
+	int				i, ite;
 
-	for ( j = 0; j < mXRes; j++ )
+	worker->input[p] = j * mStep + mStart;
+	net->SetInput( mPatIdx, worker->input );	// set custom input
+	net->Reset( O_ACT | O_WIN );				// clean winners and activations
+	// remove transients
+	for ( ite = 0; ite < mTransients; ite++ )
 	{
-		maxmins[0][j] = 0.0;
-		maxmins[1][j] = INT_MAX;
+		net->Test( false );
+		net->CollectWinners( 0, ite );
 	}
-	for ( j = 0; j < mXRes; j++ ) 
+	// collect summed acts
+	for ( ite = 0; ite < mIterations; ite++ )
 	{
-		mInput[p] = j * mStep + mStart;
-		gCALMAPI->CALMSetInput( mPatIdx, mInput );	// set custom input
-		gCALMAPI->CALMReset( O_ACT | O_WIN );			// clean winners and activations
-		// remove transients
-		for ( ite = 0; ite < mTransients; ite++ ) gCALMAPI->CALMTest( ite, false );
-		// collect summed acts
-		for ( ite = 0; ite < mIterations; ite++ )
-		{
-			gCALMAPI->CALMTest( ite, false );
-			mBifurcations[ite][j] = gCALMAPI->CALMSumActivation();
-			if ( mBifurcations[ite][j] > maxmins[0][j] ) maxmins[0][j] = mBifurcations[ite][j];
-			if ( mBifurcations[ite][j] < maxmins[1][j] ) maxmins[1][j] = mBifurcations[ite][j];
-		}
+		net->Test( false );
+		net->CollectWinners( 0, ite );
+		acts[ite] = net->SumActivation();
+		if ( acts[ite] > maxi ) maxi = acts[ite];
+		if ( acts[ite] < mini ) mini = acts[ite];
 	}
 
 	// find scale
-	for ( j = 0; j < mXRes; j++ )
+	maxmin = maxi - mini;
+	if ( maxmin == 0.00000000 ) maxmin = 1.0;
+
+	for ( i = 0; i < mIterations; i++ )
 	{
-		maxmin = maxmins[0][j]-maxmins[1][j];
-		if ( maxmin == 0.00000000 ) maxmin = 1.0;
-	
-		for ( i = 0; i < mIterations; i++ )
-		{
-			bit = (int)( mYRes * ( (mBifurcations[i][j] - maxmins[1][j] ) / maxmin ) );
-			if ( bit > ( mYRes - 1 ) ) bit = mYRes - 1;
-			mGrayPixels[bit][j] = 0.0;
-			mBifurcations[i][j] = 1.0; 	// reset
-		}
+		bit = (int)( mYRes * ( (acts[i] - mini ) / maxmin ) );
+		if ( bit > ( mYRes - 1 ) ) bit = mYRes - 1;
+		mGrayPixels[bit][j] = 0.0;
 	}
 }
 
@@ -450,14 +538,9 @@ void AnalysisTools::FillBifurcation( int p, data_type** maxmins )
 void AnalysisTools::BifurcationForOnline( int run, data_type* pat, char const* inp, int xres, int yres, int trans,
 										  int iters, data_type start, data_type end, data_type par )
 {
-	data_type**		maxmins;
-	int				p, h, j;
+	int				p, h;
 
 	InitializeBifurcation( inp, xres, yres, trans, iters, start, end, par );
-	 
-	// allocate array for max and min
-	maxmins = CreateMatrix( 0.0, 2, xres );
-	for ( j = 0; j < mXRes; j++ ) maxmins[1][j] = INT_MAX;
 	
 	for ( p = 0; p < mInputLength; p++ )
 	{
@@ -473,28 +556,21 @@ void AnalysisTools::BifurcationForOnline( int run, data_type* pat, char const* i
 		}
 		cerr << endl;
 
-		FillBifurcation( p, maxmins );
+		FillBifurcation( p );
 		
 		sprintf( mSuffix, "img%d_%d.ppm", run+1, p+1 );
 		WriteToFile( mGrayPixels );
 	}
-
-	DisposeMatrix( maxmins, 2 );
 }
 
 
 void AnalysisTools::BifurcationForOffline( int run, char const *inp, int xres, int yres, int trans, int iters,
 										   data_type start, data_type end, data_type par, int patIdx, int x )
 {
-	data_type **maxmins;
-	int		  h, j;
+	int		  h;
 
 	InitializeBifurcation( inp, xres, yres, trans, iters, start, end, par );
 
-	// allocate array for max and min
-	maxmins = CreateMatrix( 0.0, 2, xres );
-	for ( j = 0; j < mXRes; j++ ) maxmins[1][j] = INT_MAX;
-
 	cerr << "pattern: " << patIdx+1 << endl;
 
 	for ( h = 0; h < mInputLength; h++ ) 
@@ -512,12 +588,10 @@ void AnalysisTools::BifurcationForOffline( int run, char const *inp, int xres, i
 	}
 	cerr << endl;
 	
-	FillBifurcation( x, maxmins );
+	FillBifurcation( x );
 	
 	sprintf( mSuffix, "img%d_%d_%d.ppm", run+1, patIdx+1, x+1 );
 	WriteToFile( mGrayPixels );			
-
-	DisposeMatrix( maxmins, 2 );
 }
 
 
@@ -540,7 +614,7 @@ void AnalysisTools::InitializePhaseClamp( int xres, int trans, int iters, data_t
 	// allocate pixels for bifurcation plot
 	mRGBPixels = new data_type**[3];
 	for ( int i = 0; i < 3; i++ )
-		mRGBPixels[i] = CreateMatrix( 0.0, mYRes, mXRes );
+		mRGBPixels[i] = NewPixels( 0.0, mYRes, mXRes );
 	
 	// allocate buffer for bifurcations
 	mPhases = new data_type[mIterations];
@@ -586,7 +660,7 @@ bool AnalysisTools::FillPhaseClamp( data_type x, data_type rgbStep, int outIdx,
 		bit2 = (int)( mXRes * ( (mPhases[i+1] - mini ) / maxmin ) );
 		if ( bit2 > ( mXRes - 1 ) ) bit2 = mXRes - 1;
 		
-		HSLtoRGB( bit1, bit2, i*rgbStep );
+		HSLtoRGB( mRGBPixels, bit1, bit2, i*rgbStep );
 //		mRGBPixels[0][bit1][bit2] = i * rgbStep;
 //		mRGBPixels[1][bit1][bit2] = 0.0;
 //		mRGBPixels[2][bit1][bit2] = 0.0;
@@ -639,10 +713,7 @@ void AnalysisTools::InitializePhase( char const *inp, int xres, int trans, int i
 	// allocate pixels for bifurcation plot
 	mRGBPixels = new data_type**[3];
 	for ( int i = 0; i < 3; i++ )
-		mRGBPixels[i] = CreateMatrix( 0.0, mYRes, mXRes );
-	
-	// allocate buffer for bifurcations
-	mPhases = new data_type[mIterations];
+		mRGBPixels[i] = NewPixels( 0.0, mYRes, mXRes );
 		
 	// set empty input pattern
 	mInputLength = gCALMAPI->CALMGetModuleSize( mPatIdx );
@@ -650,67 +721,102 @@ void AnalysisTools::InitializePhase( char const *inp, int xres, int trans, int i
 }
 
 
-bool AnalysisTools::FillPhase( data_type x, int p, data_type rgbStep )
+// Every parameter value gives its own phase plot, so plots are computed 
+// independently, in parallel unless time-delay connections link them together.
+// The parameter values are listed beforehand to keep them exactly as they were 
+// when stepping through them one by one.
+void AnalysisTools::FillPhases( int p )
 {
-	data_type	maxi = 0, mini = INT_MAX, maxmin;
-	int			i, ite;
-	int			bit1, bit2;
+	data_type	x;
+	int			numValues = 0;
+
+	for ( x = mStart; x < mEnd; x = x + mStep ) numValues++;
+	mPhaseValues = new data_type[numValues];
+	numValues = 0;
+	for ( x = mStart; x < mEnd; x = x + mStep ) mPhaseValues[numValues++] = x;
+
+	FillParallel( numValues, &AnalysisTools::FillPhase, p, 0, 
+				  ! gCALMAPI->CALMGetNetwork()->HasDelayLinks() );
+
+	delete[] mPhaseValues;
+	mPhaseValues = NULL;
+}
+
+// computes and writes the phase plot for the x-th parameter value, if there is any dynamics
+void AnalysisTools::FillPhase( AnalysisWorker* worker, int x, int p, int q )
+{
+	CALMNetwork*	net = worker->network;
+	data_type*		acts = worker->buffer;
+	data_type		maxi = 0, mini = INT_MAX, maxmin;
+	data_type		rgbStep = 1.0 / (data_type)mIterations;	// color iterator
+	int				i, ite;
+	int				bit1, bit2;
+	char			filename[256];
 	
-	maxi = 0;
-	mini = INT_MAX;
-	mInput[p] = x;
-	gCALMAPI->CALMSetInput( mPatIdx, mInput );	// set custom input
-	gCALMAPI->CALMReset( O_ACT | O_WIN );		// clean winners and activations
+	worker->input[p] = mPhaseValues[x];
+	net->SetInput( mPatIdx, worker->input );	// set custom input
+	net->Reset( O_ACT | O_WIN );				// clean winners and activations
 	// remove transients
-	for ( ite = 0; ite < mTransients; ite++ ) gCALMAPI->CALMTest( ite, false );
+	for ( ite = 0; ite < mTransients; ite++ )
+	{
+		net->Test( false );
+		net->CollectWinners( 0, ite );
+	}
 	// collect summed acts
 	for ( ite = 0; ite < mIterations; ite++ )
 	{
-		gCALMAPI->CALMTest( ite, false );
+		net->Test( false );
+		net->CollectWinners( 0, ite );
 	/*
 		// plot R versus V
 		if ( ite % 2 == 0 )
-			mPhases[ite] = gCALMAPI->CALMSumActivationR();
+			acts[ite] = net->SumActivationR();
 		else
-			mPhases[ite] = gCALMAPI->CALMSumActivationV();
+			acts[ite] = net->SumActivationV();
 	*/
-		mPhases[ite] = gCALMAPI->CALMSumActivationR();
-		if ( mPhases[ite] > maxi ) maxi = mPhases[ite];
-		if ( mPhases[ite] < mini ) mini = mPhases[ite];
+		acts[ite] = net->SumActivationR();
+		if ( acts[ite] > maxi ) maxi = acts[ite];
+		if ( acts[ite] < mini ) mini = acts[ite];
 	}
 
 	// find scale
 	maxmin = maxi - mini;
-	if ( maxmin == 0.00000000 ) return false;
+	if ( maxmin == 0.00000000 ) return;
+
+	if ( worker->pixels == NULL )
+	{
+		worker->pixels = new data_type**[3];
+		for ( i = 0; i < 3; i++ )
+			worker->pixels[i] = NewPixels( 0.0, mYRes, mXRes );
+		worker->image = new PGMImage;
+	}
 
 	for ( i = 0; i < mIterations-1; i++ )
 	{
-		bit1 = (int)( mXRes * ( (mPhases[i] - mini ) / maxmin ) );
+		bit1 = (int)( mXRes * ( (acts[i] - mini ) / maxmin ) );
 		if ( bit1 > ( mXRes - 1 ) ) bit1 = mXRes - 1;
 		
-		bit2 = (int)( mXRes * ( (mPhases[i+1] - mini ) / maxmin ) );
+		bit2 = (int)( mXRes * ( (acts[i+1] - mini ) / maxmin ) );
 		if ( bit2 > ( mXRes - 1 ) ) bit2 = mXRes - 1;
 		
-		HSLtoRGB( bit1, bit2, i*rgbStep );
-//		mRGBPixels[0][bit1][bit2] = i * rgbStep;
-//		mRGBPixels[1][bit1][bit2] = 0.0;
-//		mRGBPixels[2][bit1][bit2] = 0.0;
-		mPhases[i] = 1.0; 	// reset
+		HSLtoRGB( worker->pixels, bit1, bit2, i*rgbStep );
 	}
-	
-	return true;
+
+	// mSuffix holds the start of the file name, the parameter value is added here
+	sprintf( filename, "%s%s%f.ppm", mDirName, mSuffix, mPhaseValues[x] );
+	mWriteLock.lock();
+	worker->image->Write( filename, worker->pixels, mYRes, mXRes );
+	mWriteLock.unlock();
+	ResetPixels( worker->pixels );
 }
 
 
 void AnalysisTools::PhaseForOnline( int run, data_type* pat, char const *inp, int xres, int trans, int iters,
 									data_type start, data_type step, data_type end, data_type par )
 {
-	data_type	x, rgbStep;
 	int			p, h;
 
 	InitializePhase( inp, xres, trans, iters, start, step, end, par );
-	// color iterator
-	rgbStep = 1.0 / (data_type)mIterations;
 
 	for ( p = 0; p < mInputLength; p++ )
 	{
@@ -728,14 +834,8 @@ void AnalysisTools::PhaseForOnline( int run, data_type* pat, char const *inp, in
 		}
 		cerr << endl;
 			
-		for ( x = mStart; x < mEnd; x = x + mStep ) 
-		{
-			if ( FillPhase( x, p, rgbStep ) )
-			{
-				sprintf( mSuffix, "img%d_%d_%f.ppm", run+1, p+1, x );
-				WriteToFile( mRGBPixels );
-			}
-		}
+		sprintf( mSuffix, "img%d_%d_", run+1, p+1 );
+		FillPhases( p );
 	}
 }
 
@@ -744,12 +844,9 @@ void AnalysisTools::PhaseForOffline( int run, char const *inp, int xres, int tra
 									data_type start, data_type step, data_type end,
 									data_type par, int patIdx, int p )
 {
-	data_type	x, rgbStep;
 	int			h, i;
 
 	InitializePhase( inp, xres, trans, iters, start, step, end, par );
-	// color iterator
-	rgbStep = 1.0 / (data_type)mIterations;
 
 	// obtain learned pattern (first one only)
 	for ( i = 0; i < mInputLength; i++ ) mInput[i] = gCALMAPI->CALMGetPattern( mPatIdx, 0, i );
@@ -769,14 +866,21 @@ void AnalysisTools::PhaseForOffline( int run, char const *inp, int xres, int tra
 	}
 	cerr << endl;
 
-	for ( x = mStart; x < mEnd; x = x + mStep ) 
-	{
-		if ( FillPhase( x, p, rgbStep ) )
-		{
-			sprintf( mSuffix, "img%d_%d_%d_%f.ppm", run+1, patIdx+1, p+1, x );
-			WriteToFile( mRGBPixels );
-		}
-	}
+	sprintf( mSuffix, "img%d_%d_%d_", run+1, patIdx+1, p+1 );
+	FillPhases( p );
+}
+
+// pixels are accounted for as images in CALMMemory
+data_type** AnalysisTools::NewPixels( data_type val, int rows, int cols )
+{
+	CALMMemory::Allocated( kMemImages, rows * ( sizeof(data_type*) + cols * sizeof(data_type) ) );
+	return CreateMatrix( val, rows, cols );
+}
+
+void AnalysisTools::DisposePixels( data_type** pixels, int rows, int cols )
+{
+	CALMMemory::Freed( kMemImages, rows * ( sizeof(data_type*) + cols * sizeof(data_type) ) );
+	DisposeMatrix( pixels, rows );
 }
 
 void AnalysisTools::ResetPixels( data_type*** pixels )
@@ -837,7 +941,7 @@ double AnalysisTools::HuetoRGB( double m1, double m2, double h )
    return m1;
 }
 
-void AnalysisTools::HSLtoRGB( int i, int j, data_type hue )
+void AnalysisTools::HSLtoRGB( data_type*** pixels, int i, int j, data_type hue )
 {
 //	data_type	light = 0.45, saturation = 0.75;
 	data_type	light = 0.45, saturation = 1.0;
@@ -848,9 +952,9 @@ void AnalysisTools::HSLtoRGB( int i, int j, data_type hue )
 	else
 		m2 = light + saturation - light * saturation;
 	m1 = 2.0 * light - m2;
-	mRGBPixels[0][i][j] = HuetoRGB( m1, m2, hue + 1.0 / 3.0 );
-	mRGBPixels[1][i][j] = HuetoRGB( m1, m2, hue );
-	mRGBPixels[2][i][j] = HuetoRGB( m1, m2, hue - 1.0 / 3.0 );
+	pixels[0][i][j] = HuetoRGB( m1, m2, hue + 1.0 / 3.0 );
+	pixels[1][i][j] = HuetoRGB( m1, m2, hue );
+	pixels[2][i][j] = HuetoRGB( m1, m2, hue - 1.0 / 3.0 );
 }
 
 
@@ -0,0 +1,54 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMAllocGuard class
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include "CALMGlobal.h"
+#include "CALMAllocGuard.h"
+
+thread_local const char*	CALMAllocGuard::sScope = NULL;
+thread_local int			CALMAllocGuard::sAllowed = 0;
+atomic<long>				CALMAllocGuard::sViolations( 0 );
+bool						CALMAllocGuard::sFatal = true;
+
+
+// Reports with stdio, which does not use operator new
+void CALMAllocGuard::Violation( size_t bytes )
+{
+	sViolations.fetch_add( 1, memory_order_relaxed );
+	fprintf( stderr, "allocation of %zu bytes in %s\n", bytes, sScope );
+	if ( sFatal ) abort();
+}
+
+
+#if CALM_ALLOC_CHECK
+
+// operator new[] and the nothrow versions call these; the default operator
+// delete frees memory from malloc and aligned_alloc alike
+__attribute__((weak)) void* operator new( size_t size )
+{
+	void* p;
+
+	CALMAllocGuard::Check( size );
+	p = malloc( size > 0 ? size : 1 );
+	if ( p == NULL ) throw bad_alloc();
+	return p;
+}
+
+
+__attribute__((weak)) void* operator new( size_t size, align_val_t align )
+{
+	size_t	alignment = (size_t)align;
+	void*	p;
+
+	CALMAllocGuard::Check( size );
+	p = aligned_alloc( alignment, ( size + alignment - 1 ) / alignment * alignment );
+	if ( p == NULL ) throw bad_alloc();
+	return p;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMArena class
+*/
+
+#include "CALMArena.h"
+
+
+CALMArena::CALMArena( size_t chunkSize )
+{
+	mChunkSize = ( chunkSize > 0 ) ? chunkSize : kArenaChunk;
+	mChunks = NULL;
+	mPos = NULL;
+	mEnd = NULL;
+	mUsed = 0;
+	mReserved = 0;
+	for ( int i = 0; i < kNumMemCategories; i++ ) mBytes[i] = 0;
+}
+
+
+// release all blocks at once. Objects in the arena are not destructed,
+// so they should not own any memory outside the arena.
+CALMArena::~CALMArena()
+{
+	char* next;
+	
+	for ( int i = 0; i < kNumMemCategories; i++ ) CALMMemory::Freed( i, mBytes[i] );
+	while ( mChunks != NULL )
+	{
+		next = *(char**)mChunks;
+		::operator delete( mChunks, std::align_val_t( kCacheLine ) );
+		mChunks = next;
+	}
+}
+
+
+// the first cache line of each block holds the pointer to the previous block
+void CALMArena::NewChunk( size_t bytes )
+{
+	size_t	size = ( bytes > mChunkSize ) ? bytes : mChunkSize;
+	char*	chunk;
+	
+	size = size + kCacheLine;
+	chunk = (char*)::operator new( size, std::align_val_t( kCacheLine ) );
+	*(char**)chunk = mChunks;
+	mChunks = chunk;
+	mPos = chunk + kCacheLine;
+	mEnd = chunk + size;
+	mReserved += size;
+}
+
+
+void* CALMArena::Allocate( size_t bytes, int category )
+{
+	void* ptr;
+	
+	bytes = Aligned( bytes );
+	if ( mPos == NULL || bytes > (size_t)( mEnd - mPos ) ) NewChunk( bytes );
+	ptr = mPos;
+	mPos += bytes;
+	mUsed += bytes;
+	mBytes[category] += bytes;
+	CALMMemory::Allocated( category, bytes );
+	return ptr;
+}
+
+
+data_type** CALMArena::NewMatrix( data_type val, int row, int col, int category )
+{
+	data_type**	matrix = New<data_type*>( row, category );
+	data_type*	data = New<data_type>( row * col, category );
+	
+	for ( int i = 0; i < row; i++ ) 
+	{
+		matrix[i] = data + i * col;
+		for ( int j = 0; j < col; j++ ) matrix[i][j] = val;
+	}
+	return matrix;
+}
@@ -0,0 +1,116 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMCheckpointWriter class
+*/
+
+#include <string.h>
+#include "CALMGlobal.h"
+#include "CALMNetwork.h"
+#include "CALMTrace.h"
+#include "CALMCheckpointWriter.h"
+
+
+CALMCheckpointWriter::CALMCheckpointWriter( int numBuffers )
+{
+	mNumJobs = ( numBuffers > 0 ) ? numBuffers : 1;
+	mJobs = new CALMCheckpointJob[mNumJobs];
+	for ( int i = 0; i < mNumJobs; i++ ) mJobs[i].queued = false;
+	mNext = 0;
+	mPending = 0;
+	mFailed = false;
+	mQuit = false;
+	mWriter = std::thread( &CALMCheckpointWriter::WriteBehind, this );
+}
+
+
+// writes out all pending checkpoints before stopping
+CALMCheckpointWriter::~CALMCheckpointWriter()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		mQuit = true;
+	}
+	mSignal.notify_all();
+	mWriter.join();
+	delete[] mJobs;
+}
+
+
+// Take a snapshot of the network and queue it for writing. Call this between
+// epochs, from the thread that trains the network. Only waits if all buffers
+// are still in use. "done" may be NULL.
+void CALMCheckpointWriter::Submit( CALMNetwork* network, const char* filename, CALMCheckpointDone done, void* data )
+{
+	CALMCheckpointJob* job = mJobs + mNext;
+	
+	{
+		TRACE_SCOPE( "checkpoint wait", kUndefined );
+		std::unique_lock<std::mutex> lock( mLock );
+		mSignal.wait( lock, [job]{ return ! job->queued; } );
+	}
+	// the writer does not touch a buffer that is not queued
+	{
+		TRACE_SCOPE( "snapshot", kUndefined );
+		network->Snapshot( &job->snap );
+	}
+	strncpy( job->filename, filename, FILENAME_MAX - 1 );
+	job->filename[FILENAME_MAX-1] = '\0';
+	job->done = done;
+	job->data = data;
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		job->queued = true;
+		mPending++;
+	}
+	mSignal.notify_all();
+	mNext = ( mNext + 1 ) % mNumJobs;
+}
+
+
+// Wait until all queued checkpoints are on disk. Returns false if any of them
+// failed since the previous call.
+bool CALMCheckpointWriter::Wait( void )
+{
+	bool ok;
+	
+	std::unique_lock<std::mutex> lock( mLock );
+	mSignal.wait( lock, [this]{ return mPending == 0; } );
+	ok = ! mFailed;
+	mFailed = false;
+	return ok;
+}
+
+
+// body of the writer thread: write the buffers in the order they were filled
+void CALMCheckpointWriter::WriteBehind( void )
+{
+	CALMCheckpointJob*	job;
+	int					next = 0;
+	bool				ok;
+
+	TRACE_THREAD( "checkpoint writer" );
+	for ( ;; )
+	{
+		job = mJobs + next;
+		{
+			std::unique_lock<std::mutex> lock( mLock );
+			mSignal.wait( lock, [this, job]{ return mQuit || job->queued; } );
+			if ( ! job->queued ) return;
+		}
+		{
+			TRACE_SCOPE( "checkpoint write", kUndefined );
+			ok = job->snap.Save( job->filename, true );
+		}
+		if ( job->done != NULL ) job->done( job->filename, ok, job->data );
+		{
+			std::lock_guard<std::mutex> lock( mLock );
+			job->queued = false;
+			mPending--;
+			if ( ! ok ) mFailed = true;
+		}
+		mSignal.notify_all();
+		next = ( next + 1 ) % mNumJobs;
+	}
+}
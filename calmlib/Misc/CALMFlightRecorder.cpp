@@ -0,0 +1,81 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMFlightRecorder class
+*/
+
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMArena.h"
+#include "CALMLogWriter.h"
+#include "CALMFlightRecorder.h"
+
+
+CALMFlightRecorder::CALMFlightRecorder( int numSlots )
+{
+	mSlots = NULL;
+	mSlotSize = 0;
+	mNumSlots = Max( numSlots, 1 );
+	mNext = 0;
+	mCount = 0;
+}
+
+
+CALMFlightRecorder::~CALMFlightRecorder()
+{
+	if ( mFile.is_open() ) mFile.close();
+	if ( mSlots != NULL ) delete[] mSlots;
+}
+
+
+bool CALMFlightRecorder::Open( const char* filename )
+{
+	if ( mFile.is_open() ) mFile.close();
+	mFile.open( filename, ios::app );
+	if ( mFile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+	return true;
+}
+
+
+// Makes the slots large enough for records of "size" bytes. Records held
+// are lost if the slots grow.
+void CALMFlightRecorder::Reserve( size_t size )
+{
+	if ( size <= mSlotSize ) return;
+	if ( mSlots != NULL ) delete[] mSlots;
+	mSlotSize = CALMArena::Aligned( size );
+	mSlots = new char[mNumSlots * mSlotSize];
+	mNext = 0;
+	mCount = 0;
+}
+
+
+// Returns the slot for a record of "size" bytes, which replaces the oldest
+// record once all slots are used. The slots only grow if a module grew.
+char* CALMFlightRecorder::Next( size_t size )
+{
+	char* slot;
+
+	Reserve( size );
+	slot = mSlots + mNext * mSlotSize;
+	mNext = ( mNext + 1 ) % mNumSlots;
+	if ( mCount < mNumSlots ) mCount++;
+	return slot;
+}
+
+
+// print the records held, oldest first, after a line with the reason
+void CALMFlightRecorder::Dump( const char* reason )
+{
+	int first = ( mNext - mCount + mNumSlots ) % mNumSlots;
+
+	if ( ! mFile.is_open() ) return;
+	mFile << reason << endl;
+	for ( int i = 0; i < mCount; i++ )
+		CALMLogWriter::PrintRecord( &mFile, (CALMLogRecord*)( mSlots + ( ( first + i ) % mNumSlots ) * mSlotSize ) );
+	mFile << flush;
+}
@@ -0,0 +1,159 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMLatency class
+*/
+
+#include <stdio.h>
+#include "CALMGlobal.h"
+#include "CALMLatency.h"
+
+static const char* sCallNames[kNumLatencies] =
+{
+	"trainsingle", "testsingle", "test", "setinput", "loadweights", "saveweights"
+};
+
+
+CALMLatency::CALMLatency()
+{
+	mLow = 0;
+	mHigh = kLatencyBuckets - 1;
+	mResetPending = false;
+	Clear();
+}
+
+
+// Only the thread that calls the API records, so the counters are simply
+// stored, without the cost of an atomic increment
+void CALMLatency::Record( uint64_t ns )
+{
+	int b = Bucket( ns );
+
+	if ( mResetPending.load( memory_order_acquire ) ) Clear();
+	mCounts[b].store( mCounts[b].load( memory_order_relaxed ) + 1, memory_order_relaxed );
+	mSum.store( mSum.load( memory_order_relaxed ) + ns, memory_order_relaxed );
+	if ( ns < mMin.load( memory_order_relaxed ) ) mMin.store( ns, memory_order_relaxed );
+	if ( ns > mMax.load( memory_order_relaxed ) ) mMax.store( ns, memory_order_relaxed );
+	mCount.store( mCount.load( memory_order_relaxed ) + 1, memory_order_release );
+	if ( b < mLow ) mLow = b;
+	if ( b > mHigh ) mHigh = b;
+}
+
+
+// clears the buckets used since the last clear, on the recording thread
+void CALMLatency::Clear( void )
+{
+	for ( int i = mLow; i <= mHigh; i++ ) mCounts[i].store( 0, memory_order_relaxed );
+	mCount.store( 0, memory_order_relaxed );
+	mSum.store( 0, memory_order_relaxed );
+	mMin.store( UINT64_MAX, memory_order_relaxed );
+	mMax.store( 0, memory_order_relaxed );
+	mLow = kLatencyBuckets;
+	mHigh = kUndefined;
+	mResetPending.store( false, memory_order_release );
+}
+
+
+uint64_t CALMLatency::GetCount( void )
+{
+	if ( mResetPending.load( memory_order_acquire ) ) return 0;
+	return mCount.load( memory_order_acquire );
+}
+
+
+uint64_t CALMLatency::GetMax( void )
+{
+	if ( GetCount() == 0 ) return 0;
+	return mMax.load( memory_order_relaxed );
+}
+
+
+uint64_t CALMLatency::GetMin( void )
+{
+	if ( GetCount() == 0 ) return 0;
+	return mMin.load( memory_order_relaxed );
+}
+
+
+double CALMLatency::GetMean( void )
+{
+	uint64_t count = GetCount();
+
+	if ( count == 0 ) return 0.0;
+	return (double)mSum.load( memory_order_relaxed ) / count;
+}
+
+
+// While calls are being recorded, the buckets are counted first, so that the
+// rank is consistent with the buckets walked
+uint64_t CALMLatency::GetPercentile( double quantile )
+{
+	uint64_t	total = 0, rank, seen = 0;
+	int			b;
+
+	if ( GetCount() == 0 ) return 0;
+	if ( quantile >= 1.0 ) return GetMax();
+	for ( b = 0; b < kLatencyBuckets; b++ ) total += mCounts[b].load( memory_order_relaxed );
+	rank = (uint64_t)( quantile * total + 0.999999 );
+	if ( rank == 0 ) rank = 1;
+	for ( b = 0; b < kLatencyBuckets; b++ )
+	{
+		seen += mCounts[b].load( memory_order_relaxed );
+		if ( seen >= rank ) break;
+	}
+	if ( b == kLatencyBuckets ) return GetMax();
+	return Min( BucketEnd( b ), GetMax() );
+}
+
+
+// Below 2^(kLatencySubBits+1), every nanosecond has a bucket of its own;
+// above, the top kLatencySubBits+1 bits of the latency pick the bucket
+int CALMLatency::Bucket( uint64_t ns )
+{
+	int msb, shift;
+
+	if ( ns < 2 * kLatencySubBuckets ) return (int)ns;
+	msb = 63 - __builtin_clzll( ns );
+	if ( msb > kLatencyMaxBits ) return kLatencyBuckets - 1;
+	shift = msb - kLatencySubBits;
+	return shift * kLatencySubBuckets + (int)( ns >> shift );
+}
+
+
+// the largest latency that falls in "bucket"
+uint64_t CALMLatency::BucketEnd( int bucket )
+{
+	int shift;
+
+	if ( bucket < 2 * kLatencySubBuckets ) return bucket;
+	shift = bucket / kLatencySubBuckets - 1;
+	return ( (uint64_t)( bucket % kLatencySubBuckets + kLatencySubBuckets + 1 ) << shift ) - 1;
+}
+
+
+const char* CALMLatency::CallName( int call )
+{
+	return sCallNames[call];
+}
+
+
+// Prints the latencies of all calls made, in microseconds
+void CALMLatency::Print( ostream* os, CALMLatency* latency )
+{
+	char line[256];
+
+	snprintf( line, 256, "%-12s %10s %10s %10s %10s %10s %10s %10s", "call", "count", "mean", "p50",
+			  "p90", "p99", "p999", "max" );
+	*os << line << endl;
+	for ( int i = 0; i < kNumLatencies; i++ )
+	{
+		if ( latency[i].GetCount() == 0 ) continue;
+		snprintf( line, 256, "%-12s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f", CallName( i ),
+				  (unsigned long long)latency[i].GetCount(), latency[i].GetMean() * 1e-3,
+				  latency[i].GetPercentile( 0.5 ) * 1e-3, latency[i].GetPercentile( 0.9 ) * 1e-3,
+				  latency[i].GetPercentile( 0.99 ) * 1e-3, latency[i].GetPercentile( 0.999 ) * 1e-3,
+				  latency[i].GetMax() * 1e-3 );
+		*os << line << endl;
+	}
+	*os << "(microseconds)" << endl;
+}
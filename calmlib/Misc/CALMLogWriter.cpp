@@ -0,0 +1,205 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMLogWriter class
+*/
+
+#include "CALMGlobal.h"
+#include "CALMArena.h"
+#include "Module.h"
+#include "Connection.h"
+#include "CALMTrace.h"
+#include "CALMLogWriter.h"
+
+
+CALMLogWriter::CALMLogWriter( ostream* os, size_t bufferSize )
+{
+	// round up to a power of two, so positions can be masked
+	for ( mSize = kCacheLine; mSize < bufferSize; mSize <<= 1 ) ;
+	mBuffer = new char[mSize];
+	mHead = 0;
+	mTail = 0;
+	mWritten = 0;
+	mReserved = 0;
+	mStream = os;
+	mText.copyfmt( *mStream );
+	mSleeping = false;
+	mQuit = false;
+	mWriter = std::thread( &CALMLogWriter::WriteBehind, this );
+}
+
+
+// pending records are formatted first
+CALMLogWriter::~CALMLogWriter()
+{
+	Flush();
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		mQuit = true;
+	}
+	mSignal.notify_all();
+	mWriter.join();
+	delete[] mBuffer;
+}
+
+
+// Returns contiguous space for a record of "size" bytes, to be filled in and
+// passed on with Commit. Waits while the buffer is full. Returns NULL if the
+// record can never fit, in which case the caller has to print it directly.
+char* CALMLogWriter::Reserve( size_t size )
+{
+	size_t	head = mHead.load( std::memory_order_relaxed );
+	size_t	offset = head & ( mSize - 1 );
+	size_t	padding = 0;
+
+	size = CALMArena::Aligned( size );
+	if ( size > mSize / 2 ) return NULL;
+	if ( offset + size > mSize ) padding = mSize - offset;
+	while ( head + padding + size - mTail.load( std::memory_order_acquire ) > mSize )
+		std::this_thread::yield();
+
+	if ( padding )
+	{
+		CALMLogRecord* record = (CALMLogRecord*)( mBuffer + offset );
+		record->size = padding;
+		record->numModules = kUndefined;
+		head += padding;
+		offset = 0;
+	}
+	((CALMLogRecord*)( mBuffer + offset ))->size = size;
+	mReserved = head + size;
+	return mBuffer + offset;
+}
+
+
+// hand the reserved record to the writer thread
+void CALMLogWriter::Commit( void )
+{
+	mHead.store( mReserved );
+	if ( mSleeping.load() )
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		mSignal.notify_all();
+	}
+}
+
+
+// wait until all committed records are in the log
+void CALMLogWriter::Flush( void )
+{
+	size_t head = mHead.load( std::memory_order_relaxed );
+
+	if ( mWritten.load( std::memory_order_acquire ) == head ) return;
+	TRACE_SCOPE( "log flush", kUndefined );
+	std::unique_lock<std::mutex> lock( mLock );
+	mSignal.wait( lock, [this,head]{ return mWritten.load() == head; } );
+}
+
+
+void CALMLogWriter::SetStream( ostream* os )
+{
+	Flush();
+	mStream = os;
+	mText.copyfmt( *mStream );
+}
+
+
+// body of the writer thread
+void CALMLogWriter::WriteBehind( void )
+{
+	size_t			tail = 0;
+	CALMLogRecord*	record;
+
+	TRACE_THREAD( "log writer" );
+	for ( ;; )
+	{
+		if ( mHead.load( std::memory_order_acquire ) == tail )
+		{
+			WriteText( tail );
+			std::unique_lock<std::mutex> lock( mLock );
+			mSleeping = true;
+			mSignal.notify_all();		// wakes up Flush
+			mSignal.wait( lock, [this,tail]{ return mQuit || mHead.load() != tail; } );
+			mSleeping = false;
+			if ( mHead.load() == tail ) return;
+			continue;
+		}
+		record = (CALMLogRecord*)( mBuffer + ( tail & ( mSize - 1 ) ) );
+		if ( record->numModules != kUndefined ) Format( record );
+		tail += record->size;
+		mTail.store( tail, std::memory_order_release );
+		if ( mText.tellp() >= kLogBatchSize ) WriteText( tail );
+	}
+}
+
+
+// The text is collected first, so that the log is not flushed at every line.
+void CALMLogWriter::Format( CALMLogRecord* record )
+{
+	PrintRecord( &mText, record );
+}
+
+
+// print a record the same way as the CALMNetwork function that it replaces
+void CALMLogWriter::PrintRecord( ostream* os, CALMLogRecord* record )
+{
+	char*			pos = (char*)( record + 1 );
+	CALMLogModule*	module;
+	CALMLogModule*	from;
+	int				i, k;
+
+	if ( record->kind == kLogPotentials )
+	{
+		for ( i = 0; i < record->numModules; i++ )
+		{
+			module = (CALMLogModule*)pos;
+			pos += sizeof(CALMLogModule);
+			Module::PrintPotentials( os, module->name, module->size, (data_type*)pos );
+			pos += module->size * sizeof(data_type);
+		}
+		*os << endl;
+		return;
+	}
+	if ( record->kind == kLogWeights )
+	{
+		*os << endl << "Weights for epoch " << record->epoch << " and pattern " << record->ite << endl;
+		for ( i = 0; i < record->numModules; i++ )
+		{
+			module = (CALMLogModule*)pos;
+			pos += sizeof(CALMLogModule);
+			*os << module->name << ":" << endl;
+			for ( k = 0; k < module->numConn; k++ )
+			{
+				from = (CALMLogModule*)pos;
+				pos += sizeof(CALMLogModule);
+				Connection::PrintWeights( os, from->name, module->size, from->size, (data_type*)pos );
+				pos += module->size * from->size * sizeof(data_type);
+			}
+		}
+		*os << endl;
+		return;
+	}
+
+	*os << endl << "Activations for epoch " << record->epoch << " and iteration " << record->ite << endl;
+	for ( i = 0; i < record->numModules; i++ )
+	{
+		module = (CALMLogModule*)pos;
+		pos += sizeof(CALMLogModule);
+		Module::PrintActs( os, module->name, module->type, module->size, (data_type*)pos, record->format );
+		pos += ( 2 * module->size + 2 ) * sizeof(data_type);
+	}
+	*os << endl;
+}
+
+
+// pass the collected text, up to position "end", on to the log
+void CALMLogWriter::WriteText( size_t end )
+{
+	if ( mText.tellp() > 0 )
+	{
+		TRACE_SCOPE( "log write", kUndefined );
+		*mStream << mText.str() << flush;
+		mText.str( "" );
+	}
+	mWritten.store( end, std::memory_order_release );
+}
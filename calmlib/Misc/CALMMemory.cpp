@@ -0,0 +1,140 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMMemory class
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "CALMGlobal.h"
+#include "CALMNetwork.h"
+#include "Module.h"
+#include "Connection.h"
+#include "CALMMemory.h"
+
+atomic<size_t>	CALMMemory::sBytes[kNumMemCategories];
+atomic<size_t>	CALMMemory::sPeak[kNumMemCategories];
+atomic<size_t>	CALMMemory::sAllocations[kNumMemCategories];
+atomic<size_t>	CALMMemory::sReallocations[kNumMemCategories];
+atomic<size_t>	CALMMemory::sTotal( 0 );
+atomic<size_t>	CALMMemory::sTotalPeak( 0 );
+
+static const char* sCategoryNames[kNumMemCategories] =
+{
+	"modules", "nodes", "weights", "wtact", "patterns", "winners", "images"
+};
+
+
+// Networks are cloned and images drawn on several threads at once, so the
+// counters are atomic
+void CALMMemory::Allocated( int category, size_t bytes )
+{
+	sAllocations[category].fetch_add( 1, memory_order_relaxed );
+	Raise( &sPeak[category], sBytes[category].fetch_add( bytes, memory_order_relaxed ) + bytes );
+	Raise( &sTotalPeak, sTotal.fetch_add( bytes, memory_order_relaxed ) + bytes );
+}
+
+
+void CALMMemory::Freed( int category, size_t bytes )
+{
+	sBytes[category].fetch_sub( bytes, memory_order_relaxed );
+	sTotal.fetch_sub( bytes, memory_order_relaxed );
+}
+
+
+void CALMMemory::ResetPeaks( void )
+{
+	for ( int i = 0; i < kNumMemCategories; i++ ) sPeak[i].store( GetBytes( i ), memory_order_relaxed );
+	sTotalPeak.store( GetBytes(), memory_order_relaxed );
+}
+
+
+// raise "peak" to "bytes", unless another thread raised it higher already
+void CALMMemory::Raise( atomic<size_t>* peak, size_t bytes )
+{
+	size_t old = peak->load( memory_order_relaxed );
+
+	while ( bytes > old && ! peak->compare_exchange_weak( old, bytes, memory_order_relaxed ) ) {}
+}
+
+
+const char* CALMMemory::CategoryName( int category )
+{
+	return sCategoryNames[category];
+}
+
+
+// Prints the counters of the process, and the memory that each module of "net"
+// takes now, with its incoming connections. Memory of the arena that is no
+// longer used by any module was left behind when modules grew.
+void CALMMemory::Print( ostream* os, CALMNetwork* net )
+{
+	char	line[256];
+	size_t	bytes[kNumMemCategories], arena[kNumMemCategories];
+	size_t	total, live = 0;
+	int		i, c, k;
+	Module*	module;
+
+	snprintf( line, 256, "%-12s %14s %14s %12s %12s", "memory", "bytes", "peak", "allocations", "reallocs" );
+	*os << line << endl;
+	for ( c = 0; c < kNumMemCategories; c++ )
+	{
+		snprintf( line, 256, "%-12s %14zu %14zu %12zu %12zu", CategoryName( c ), GetBytes( c ), GetPeak( c ),
+				  GetAllocations( c ), GetReallocations( c ) );
+		*os << line << endl;
+	}
+	snprintf( line, 256, "%-12s %14zu %14zu", "all", GetBytes(), GetPeak() );
+	*os << line << endl;
+	if ( net == NULL || net->GetArena() == NULL ) return;
+
+	*os << endl;
+	snprintf( line, 256, "%-20s", "module" );
+	for ( c = 0; c < kNumMemCategories - 1; c++ ) snprintf( line + strlen( line ), 256 - strlen( line ), " %10s", CategoryName( c ) );
+	snprintf( line + strlen( line ), 256 - strlen( line ), " %12s", "total" );
+	*os << line << endl;
+	for ( c = 0; c < kNumMemCategories; c++ ) arena[c] = 0;
+	for ( i = kUndefined; i < net->GetNumInputs() + net->GetNumModules(); i++ )
+	{
+		for ( c = 0; c < kNumMemCategories; c++ ) bytes[c] = 0;
+		net->CountMemory( i, bytes );
+		total = 0;
+		snprintf( line, 256, "%-20s", ( i == kUndefined ) ? "network" : net->GetModule( i )->GetModuleName() );
+		for ( c = 0; c < kNumMemCategories - 1; c++ )
+		{
+			snprintf( line + strlen( line ), 256 - strlen( line ), " %10zu", bytes[c] );
+			total += bytes[c];
+			arena[c] += bytes[c];
+		}
+		snprintf( line + strlen( line ), 256 - strlen( line ), " %12zu", total );
+		*os << line << endl;
+		if ( i == kUndefined ) continue;
+		// and each incoming connection
+		module = net->GetModule( i );
+		for ( k = 0; k < module->GetNumInConn(); k++ )
+		{
+			for ( c = 0; c < kNumMemCategories; c++ ) bytes[c] = 0;
+			module->GetConnection( k )->CountMemory( bytes );
+			snprintf( line, 256, "  <- %-15s %10s %10s %10zu %10zu", module->GetConnModuleName( k ), "", "",
+					  bytes[kMemWeights], bytes[kMemWtAct] );
+			*os << line << endl;
+		}
+	}
+	for ( c = kMemModules; c <= kMemWtAct; c++ ) live += arena[c];
+	*os << "arena: " << net->GetArena()->GetUsed() << " bytes used, " << live << " by the modules now, ";
+	*os << net->GetArena()->GetUsed() - live << " left behind by reallocations, ";
+	*os << net->GetArena()->GetReserved() << " reserved" << endl;
+}
+
+
+// Writes the counters of the process as a JSON object
+void CALMMemory::Save( ostream* os )
+{
+	*os << "{";
+	for ( int c = 0; c < kNumMemCategories; c++ )
+	{
+		*os << ( c == 0 ? "\n" : ",\n" ) << "\t\t\"" << CategoryName( c ) << "\": { \"bytes\": " << GetBytes( c );
+		*os << ", \"peak\": " << GetPeak( c ) << ", \"allocations\": " << GetAllocations( c );
+		*os << ", \"reallocations\": " << GetReallocations( c ) << " }";
+	}
+	*os << ",\n\t\t\"all\": { \"bytes\": " << GetBytes() << ", \"peak\": " << GetPeak() << " }\n\t}";
+}
@@ -9,7 +9,15 @@
 #include "CALMPatterns.h"
 #include "ModuleMap.h"
 #include "Feedback.h"
+#include "Connection.h"
 #include "Rnd.h"
+#include "CALMWeightFile.h"
+#include "CALMPatternFile.h"
+#include "CALMPatternStream.h"
+#include "CALMTokenizer.h"
+#include "CALMLogWriter.h"
+#include "CALMResults.h"
+#include "CALMTrace.h"
 #include "CALMNetwork.h"
 
 
@@ -23,8 +31,13 @@ CALMNetwork::CALMNetwork()
 	mPatternOrder = kPermuted;
 	mFeedback = kNoWinner;
 	mModules = NULL;
+	mArena = NULL;
+	mProfiler = NULL;
 	mPatternList = NULL;
+	mPatternFile = NULL;
+	mPatternStream = NULL;
 	mFeedbackList = NULL;
+	mFeedbackMemory = 0;
 	mPermutations = NULL;
 	mWinners = NULL;
 	mConvTimes = NULL;
@@ -35,48 +48,291 @@ CALMNetwork::CALMNetwork()
 // destructor: Free up allocated memory
 CALMNetwork::~CALMNetwork() 
 {
-	int i;
+	// all modules, nodes, connections and weights are in the arena, 
+	// so they are released all at once
+	if ( mArena != NULL ) delete mArena;
+	if ( mProfiler != NULL ) delete mProfiler;
+
+	DeleteFeedback();
+	DeletePatterns();
+	
+	if ( mGnuPlot != NULL ) delete mGnuPlot;
+
+	if ( mWeightChangeFile.is_open() ) mWeightChangeFile.close();
+	if ( mActChangeFile.is_open() ) mActChangeFile.close();
+	if ( mMuChangeFile.is_open() ) mMuChangeFile.close();
+}
+
+
+// Creates an independent copy of the network. The copy holds its own modules,
+// connections, weights and node activations, with all internal pointers relinked
+// to the copied objects, so it can be run in a different thread than the original.
+// The copy is made in a single block of memory, as large as the memory in use here.
+// Pattern data is not copied: the copy is meant to be fed with custom input.
+CALMNetwork* CALMNetwork::Clone( void )
+{
+	CALMNetwork*	net = new CALMNetwork;
+	int				i, j;
 
-	// thanks to polymorphism we can get rid of all modules in once, whether they
-	// are derived Module classes or not. 
-	if ( mModules != NULL )
+	for ( i = 0; i < gNumPars; i++ ) net->mParameters[i] = mParameters[i];
+	net->mWtChangeSum = mWtChangeSum;
+	net->mPatternOrder = mPatternOrder;
+	net->mFeedback = mFeedback;
+
+	// first copy all modules, then their connections, which refer to the copies
+	net->SetNumModules( mNumModules, mNumInputModules, mArena->GetUsed() );
+	for ( i = 0; i < mNumModules+mNumInputModules; i++ )
+		net->mModules[i] = mModules[i]->Clone( net->mParameters, net->mArena );
+	for ( i = 0; i < mNumModules+mNumInputModules; i++ )
+		net->mModules[i]->CopyConnections( mModules[i], net->mModules );
+
+	// winner information, so that winners can be collected as in the original
+	net->mNumPatterns = mNumPatterns;
+	if ( mPermutations != NULL )
 	{
-		for ( i = 0; i < mNumModules+mNumInputModules; i++ ) delete mModules[i];
-		delete[] mModules;
+		net->mPermutations = new int[mNumPatterns];
+		for ( j = 0; j < mNumPatterns; j++ ) net->mPermutations[j] = mPermutations[j];
+		CALMMemory::Allocated( kMemPatterns, mNumPatterns * sizeof(int) );
 	}
 	if ( mWinners != NULL )
 	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mWinners[i];
-		delete[] mWinners;
+		net->mWinners = new int*[mNumModules];
+		net->mConvTimes = new int*[mNumModules];
+		for ( i = 0; i < mNumModules; i++ )
+		{
+			net->mWinners[i] = new int[mNumPatterns];
+			net->mConvTimes[i] = new int[mNumPatterns];
+			for ( j = 0; j < mNumPatterns; j++ )
+			{
+				net->mWinners[i][j] = mWinners[i][j];
+				net->mConvTimes[i][j] = mConvTimes[i][j];
+			}
+		}
+		CALMMemory::Allocated( kMemWinners, net->WinnerMemory() );
 	}
-	if ( mConvTimes != NULL )
+	return net;
+}
+
+
+// Copies the complete state of the network into a snapshot: weights, node 
+// activations, time delays, potentials, winners and the random number generator.
+// The snapshot starts with the size of every module, so that it can also be 
+// restored after modules have grown or shrunk.
+void CALMNetwork::Snapshot( CALMSnapshot* snap )
+{
+	int		numModules = mNumModules + mNumInputModules;
+	int		state[kRandomStateSize];
+	int		i;
+
+	snap->Clear();
+	snap->PutInt( numModules );
+	snap->PutInt( mNumPatterns );
+	snap->PutInt( mPermutations != NULL );
+	snap->PutInt( mWinners != NULL );
+	for ( i = 0; i < numModules; i++ ) snap->PutInt( mModules[i]->GetModuleSize() );
+
+	GetRandomState( state );
+	snap->Put( state, kRandomStateSize * sizeof(int) );
+	snap->PutInt( mPatternOrder );
+	snap->Put( &mWtChangeSum, sizeof(data_type) );
+	snap->Put( mParameters, gNumPars * sizeof(data_type) );
+	if ( mPermutations != NULL ) snap->Put( mPermutations, mNumPatterns * sizeof(int) );
+	if ( mWinners != NULL )
 	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mConvTimes[i];
-		delete[] mConvTimes;
+		for ( i = 0; i < mNumModules; i++ )
+		{
+			snap->Put( mWinners[i], mNumPatterns * sizeof(int) );
+			snap->Put( mConvTimes[i], mNumPatterns * sizeof(int) );
+		}
 	}
+	for ( i = 0; i < numModules; i++ ) mModules[i]->Snapshot( snap );
+}
 
-	delete[] mPatternList;
-	delete[] mPermutations;
 
-	delete mFeedbackList;
+// bytes that Snapshot writes if the modules have the given sizes
+size_t CALMNetwork::SnapshotSize( const int* sizes )
+{
+	int		numModules = mNumModules + mNumInputModules;
+	size_t	bytes;
 	
-	if ( mGnuPlot != NULL ) delete mGnuPlot;
+	bytes = ( 5 + numModules + kRandomStateSize ) * sizeof(int) + ( 1 + gNumPars ) * sizeof(data_type);
+	if ( mPermutations != NULL ) bytes += mNumPatterns * sizeof(int);
+	if ( mWinners != NULL ) bytes += 2 * (size_t)mNumModules * mNumPatterns * sizeof(int);
+	for ( int i = 0; i < numModules; i++ ) bytes += mModules[i]->SnapshotSize( sizes );
+	return bytes;
+}
 
-	if ( mWeightChangeFile.is_open() ) mWeightChangeFile.close();
-	if ( mActChangeFile.is_open() ) mActChangeFile.close();
-	if ( mMuChangeFile.is_open() ) mMuChangeFile.close();
+
+// Sets the network back to the state held by a snapshot. Modules that changed 
+// size since the snapshot was taken are reshaped first. The snapshot must come 
+// from this network or a clone of it, otherwise nothing is changed: the module
+// sizes it holds have to be valid and account for its exact number of bytes.
+bool CALMNetwork::Restore( CALMSnapshot* snap )
+{
+	int		numModules = mNumModules + mNumInputModules;
+	int		state[kRandomStateSize];
+	int*	sizes;
+	int*	oldSizes;
+	bool	valid, reshape = false;
+	int		i;
+
+	snap->Rewind();
+	if ( snap->GetSize() < 4 * sizeof(int) || snap->GetInt() != numModules || 
+		 snap->GetInt() != mNumPatterns || snap->GetInt() != ( mPermutations != NULL ) || 
+		 snap->GetInt() != ( mWinners != NULL ) )
+	{
+		cerr << "snapshot does not match the network" << endl;
+		return false;
+	}
+
+	// every node takes some bytes, which bounds the sizes before they are used.
+	// Resizing stops at 2 nodes, but a network may be set up with modules,
+	// input modules in particular, of a single node.
+	sizes = new int[numModules];
+	valid = true;
+	for ( i = 0; i < numModules; i++ )
+	{
+		sizes[i] = snap->GetInt();
+		if ( sizes[i] < 1 || (size_t)sizes[i] > snap->GetSize() / ( RUnit::SnapshotSize() + VUnit::SnapshotSize() ) )
+			valid = false;
+	}
+	if ( ! valid || SnapshotSize( sizes ) != snap->GetSize() )
+	{
+		cerr << "snapshot does not match the network" << endl;
+		delete[] sizes;
+		return false;
+	}
+
+	// adjust module sizes if necessary
+	oldSizes = new int[numModules];
+	for ( i = 0; i < numModules; i++ )
+	{
+		oldSizes[i] = mModules[i]->GetModuleSize();
+		mModules[i]->Reshape( sizes[i] );
+		if ( mModules[i]->GetModuleSize() != oldSizes[i] ) reshape = true;
+	}
+	if ( reshape )
+		for ( i = 0; i < numModules; i++ ) mModules[i]->ReshapeConnections( oldSizes );
+	delete[] oldSizes;
+	delete[] sizes;
+
+	snap->Get( state, kRandomStateSize * sizeof(int) );
+	SetRandomState( state );
+	mPatternOrder = snap->GetInt();
+	snap->Get( &mWtChangeSum, sizeof(data_type) );
+	snap->Get( mParameters, gNumPars * sizeof(data_type) );
+	if ( mPermutations != NULL ) snap->Get( mPermutations, mNumPatterns * sizeof(int) );
+	if ( mWinners != NULL )
+	{
+		for ( i = 0; i < mNumModules; i++ )
+		{
+			snap->Get( mWinners[i], mNumPatterns * sizeof(int) );
+			snap->Get( mConvTimes[i], mNumPatterns * sizeof(int) );
+		}
+	}
+	for ( i = 0; i < numModules; i++ ) mModules[i]->Restore( snap );
+	return true;
 }
 
 
-// set up array for modules
-void CALMNetwork::SetNumModules( int numModules, int numInputs )
+// Saves the complete training state to a checkpoint file, from which training
+// can continue exactly as if it had not been interrupted. The snapshot buffer
+// is kept, so checkpoints can be written often without allocating memory.
+bool CALMNetwork::SaveCheckpoint( const char* filename )
 {
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	TRACE_SCOPE( "checkpoint", kUndefined );
+	Snapshot( &mCheckpoint );
+	return mCheckpoint.Save( filename );
+}
+
+
+// Continues from a checkpoint file. The network has to be set up as it was at 
+// the start of the run, with the same patterns and feedback loaded. The file is
+// read into a separate snapshot, so a checkpoint that does not match the network
+// is rejected without changing it or the checkpoint buffer.
+bool CALMNetwork::LoadCheckpoint( const char* filename )
+{
+	CALMSnapshot	snap;
+	
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	if ( ! snap.Load( filename ) || ! Restore( &snap ) ) return false;
+	// keep the buffer for the checkpoints that follow
+	mCheckpoint.Swap( &snap );
+	return true;
+}
+
+
+// set up array for modules. All memory of the network is allocated from an arena,
+// with blocks of the given size (which is best set to the total estimated with
+// ModuleMemory and ConnectionMemory). Any previous modules are released.
+void CALMNetwork::SetNumModules( int numModules, int numInputs, size_t memory )
+{
+	if ( mArena != NULL ) delete mArena;
+	mArena = new CALMArena( memory );
+	
 	// define number of modules
 	mNumModules	= numModules;
 	// define number of input modules
 	mNumInputModules = numInputs;
 	// create array of CALM(Map) modules, but we still need to initialize each one!
-	mModules = new Module*[ mNumModules+mNumInputModules ];
+	mModules = mArena->New<Module*>( mNumModules+mNumInputModules, kMemModules );
+	if ( mProfiler != NULL ) mProfiler->SetNumModules( mNumModules+mNumInputModules );
+}
+
+
+// Adds the memory that module "idx" takes now, with its incoming connections, to
+// "bytes" by category, or with kUndefined, that of the network itself: the
+// array of modules, the patterns and the winners
+void CALMNetwork::CountMemory( int idx, size_t* bytes )
+{
+	if ( idx != kUndefined )
+	{
+		mModules[idx]->CountMemory( bytes );
+		return;
+	}
+	bytes[kMemModules] += CALMArena::Aligned( ( mNumModules + mNumInputModules ) * sizeof(Module*) );
+	if ( mPatternList != NULL )
+		for ( int i = 0; i < mNumInputModules; i++ ) bytes[kMemPatterns] += mPatternList[i].GetMemory();
+	if ( mPatternStream != NULL ) bytes[kMemPatterns] += mPatternStream->GetMemory();
+	if ( mPermutations != NULL ) bytes[kMemPatterns] += mNumPatterns * sizeof(int);
+	bytes[kMemPatterns] += mFeedbackMemory;
+	if ( mWinners != NULL ) bytes[kMemWinners] += WinnerMemory();
+}
+
+
+// memory taken by a module of given type and size, including its nodes
+// add ConnectionMemory for each of its incoming connections
+size_t CALMNetwork::ModuleMemory( int calmType, int moduleSize, int numConn )
+{
+	size_t bytes;
+	
+	switch ( calmType )
+	{
+		case O_MAP:
+			bytes = CALMArena::Aligned( sizeof(ModuleMap) ) + 
+					CALMArena::Aligned( moduleSize * sizeof(data_type*) ) +
+					CALMArena::Aligned( moduleSize * moduleSize * sizeof(data_type) );
+			break;
+		case O_FB:
+			bytes = CALMArena::Aligned( sizeof(Feedback) );
+			break;
+		default:
+			bytes = CALMArena::Aligned( sizeof(Module) );
+	}
+	return bytes + CALMArena::Aligned( sizeof(Module*) ) + 
+			CALMArena::Aligned( moduleSize * sizeof(RUnit) ) +
+			CALMArena::Aligned( moduleSize * sizeof(VUnit) ) +
+			CALMArena::Aligned( numConn * sizeof(Connection) );
+}
+
+
+// memory taken by the weights of a connection between two modules
+size_t CALMNetwork::ConnectionMemory( int toSize, int fromSize )
+{
+	return CALMArena::Aligned( toSize * sizeof(data_type) ) + 
+			CALMArena::Aligned( toSize * sizeof(CALMWeight*) ) +
+			CALMArena::Aligned( toSize * Connection::Stride( fromSize ) * sizeof(CALMWeight) );
 }
 
 
@@ -87,17 +343,17 @@ void CALMNetwork::InitializeModule( int idx, int calmType, int moduleSize, char*
 	{
 		case O_CALM:
 		case O_INP:
-			mModules[idx] = new Module;
+			mModules[idx] = mArena->New<Module>( 1, kMemModules );
 			break;
 		case O_MAP:
-			mModules[idx] = new ModuleMap;
+			mModules[idx] = mArena->New<ModuleMap>( 1, kMemModules );
 			break;
 		case O_FB:
-			mModules[idx] = new Feedback;
+			mModules[idx] = mArena->New<Feedback>( 1, kMemModules );
 			mFeedback = idx;
 			break;
 	}
-	mModules[idx]->Initialize( moduleSize, moduleName, mParameters, calmType, idx );
+	mModules[idx]->Initialize( moduleSize, moduleName, mParameters, calmType, idx, mArena );
 }
 
 
@@ -159,6 +415,8 @@ bool CALMNetwork::ResizeModule( void )
 			// minimum module size should be 2
 			if ( newsize != 1 )
 			{
+				PROFILE_SCOPE( mProfiler, kProfResize, i );
+				TRACE_SCOPE( "resize", i );
 				// first resize weight matrices on connections from resized module
 				for ( int j = mNumInputModules; j < mNumInputModules+mNumModules; j++ )
 					mModules[j]->ResizeConnection( newsize, node, i );
@@ -190,6 +448,8 @@ void CALMNetwork::ResizeModule( int idx )
 		// minimum module size should be 2
 		if ( newsize != 1 )
 		{
+			PROFILE_SCOPE( mProfiler, kProfResize, idx );
+			TRACE_SCOPE( "resize", idx );
 			// first resize weight matrices on connections from resized module
 			for ( int j = mNumInputModules; j < mNumInputModules+mNumModules; j++ )
 				mModules[j]->ResizeConnection( newsize, node, idx );
@@ -200,15 +460,21 @@ void CALMNetwork::ResizeModule( int idx )
 	}
 }
 
-// grows a module to "newsize"
-void CALMNetwork::ResizeModule( int idx, int newsize )
+// grows a module to "newsize", or shrinks it by pruning "node" (or the last
+// node, if not given)
+void CALMNetwork::ResizeModule( int idx, int newsize, int node )
 {
+	PROFILE_SCOPE( mProfiler, kProfResize, idx );
+	TRACE_SCOPE( "resize", idx );
+
+	if ( newsize >= mModules[idx]->GetModuleSize() ) node = kUndefined;
+
 	// first resize weight matrices on connections from resized module
 	for ( int i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
-		mModules[i]->ResizeConnection( newsize, kUndefined, idx );
+		mModules[i]->ResizeConnection( newsize, node, idx );
 	
 	// resize the specified module
-	mModules[idx]->ResizeModule( newsize, kUndefined );
+	mModules[idx]->ResizeModule( newsize, node );
 }
 
 
@@ -219,19 +485,8 @@ void CALMNetwork::OnlinePatterns( void )
 	int i;
 	
 	// delete the old list
-	if ( mFeedbackList != NULL ) delete mFeedbackList;
-	if ( mPatternList  != NULL ) delete[] mPatternList;
-	if ( mPermutations != NULL ) delete[] mPermutations;
-	if ( mWinners != NULL )
-	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mWinners[i];
-		delete[] mWinners;
-	}
-	if ( mConvTimes != NULL )
-	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mConvTimes[i];
-		delete[] mConvTimes;
-	}
+	DeleteFeedback();
+	DeletePatterns();
 
 	mNumPatterns = 1;
 	// create winners data storage for just one single pattern
@@ -242,28 +497,19 @@ void CALMNetwork::OnlinePatterns( void )
 	mConvTimes = new int*[mNumModules];
 	for ( i = 0; i < mNumModules; i++ )
 		mConvTimes[i] = new int[mNumPatterns];
+	CALMMemory::Allocated( kMemWinners, WinnerMemory() );
 }
 
 
 // Loads patterns from specified file
 bool CALMNetwork::LoadPatterns( const char* filename )
 {
-	ifstream	infile;
-	int			i;
+	CALMTokenizer	infile;
+	int				i;
 
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
 	// delete the old list
-	if ( mPatternList  != NULL ) delete[] mPatternList;
-	if ( mPermutations != NULL ) delete[] mPermutations;
-	if ( mWinners != NULL )
-	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mWinners[i];
-		delete[] mWinners;
-	}
-	if ( mConvTimes != NULL )
-	{
-		for ( i = 0; i < mNumModules; i++ ) delete[] mConvTimes[i];
-		delete[] mConvTimes;
-	}
+	DeletePatterns();
 			
 	// store filename for later reference
 	strcpy( mPatternFileName, filename );
@@ -272,27 +518,198 @@ bool CALMNetwork::LoadPatterns( const char* filename )
 	mPatternList = new CALMPatterns[mNumInputModules];
 	
 	// open the file
-	infile.open( mPatternFileName );
-	if ( infile.fail() )
+	if ( ! infile.Open( mPatternFileName ) )
 	{
 		FileOpenError( mPatternFileName );
 		return false;
 	}
 
 	// read the number of patterns: should be the same for all input modules
-	SkipComments( &infile );
-	infile >> mNumPatterns;
+	infile.Read( mNumPatterns );
 
 	// read pattern set for each input module
 	for ( i = 0; i < mNumInputModules; i++ )
 		mPatternList[i].LoadPatterns( &infile, mNumPatterns, GetModuleSize(i) );
 	
 	// close file
-	infile.close();
+	infile.Close();
+	
+	AllocateWinners();
+	return true;
+}
+
+
+// Loads patterns from a binary pattern file (see CALMPatternFile.h), which is
+// mapped into memory. The patterns are used directly from the mapping. 
+// If the file holds a feedback list, it replaces the current one.
+bool CALMNetwork::LoadBinaryPatterns( const char* filename )
+{
+	CALMPatternFile*	file = new CALMPatternFile;
+	int					i;
+
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	if ( ! file->Open( filename ) )
+	{
+		delete file;
+		return false;
+	}
+	// the pattern sets have to match the input modules
+	for ( i = 0; i < mNumInputModules; i++ )
+	{
+		if ( file->GetNumModules() != mNumInputModules || file->GetModuleSize( i ) != GetModuleSize( i ) )
+		{
+			cerr << "\tError: Patterns in " << filename << " do not match the input modules!\n";
+			delete file;
+			return false;
+		}
+	}
+	
+	// delete the old list
+	DeletePatterns();
+	if ( file->HasFeedback() ) DeleteFeedback();
+	
+	// store filename for later reference
+	strcpy( mPatternFileName, filename );
+	mPatternFile = file;
+	mNumPatterns = file->GetNumPatterns();
+	mPatternList = new CALMPatterns[mNumInputModules];
+	for ( i = 0; i < mNumInputModules; i++ )
+		mPatternList[i].MapPatterns( file->GetPatterns( i ), mNumPatterns, GetModuleSize( i ) );
+	if ( file->HasFeedback() ) mFeedbackList = file->GetFeedback();
+
+	AllocateWinners();
+	return true;
+}
+
+
+// Streams patterns from a binary pattern file that may not fit in memory. At 
+// most "window" patterns are held in memory at a time, while the next ones are 
+// read in the background. In permuted order, blocks of window/2 patterns are 
+// shuffled, as well as the patterns within each block.
+bool CALMNetwork::StreamPatterns( const char* filename, int window )
+{
+	CALMPatternStream*	stream = new CALMPatternStream;
+	int					i;
+
+	if ( ! stream->Open( filename, window ) )
+	{
+		delete stream;
+		return false;
+	}
+	// the pattern sets have to match the input modules
+	for ( i = 0; i < mNumInputModules; i++ )
+	{
+		if ( stream->GetNumModules() != mNumInputModules || stream->GetModuleSize( i ) != GetModuleSize( i ) )
+		{
+			cerr << "\tError: Patterns in " << filename << " do not match the input modules!\n";
+			delete stream;
+			return false;
+		}
+	}
+
+	DeletePatterns();
+	strcpy( mPatternFileName, filename );
+	mPatternStream = stream;
+	mNumPatterns = stream->GetNumPatterns();
+	
+	AllocateWinners();
+	// the stream keeps its own order
+	CALMMemory::Freed( kMemPatterns, mNumPatterns * sizeof(int) );
+	delete[] mPermutations;
+	mPermutations = NULL;
+	return true;
+}
+
+
+// Saves the loaded patterns and feedback list, if any, to a binary pattern file
+bool CALMNetwork::SaveBinaryPatterns( const char* filename )
+{
+	int*		sizes;
+	data_type**	patterns;
+	bool		ok;
+	
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	if ( mPatternList == NULL || mPatternStream != NULL )
+	{
+		cerr << "\tError: There are no patterns to save!\n";
+		return false;
+	}
+	sizes = new int[mNumInputModules+1];
+	patterns = new data_type*[mNumInputModules+1];
+	for ( int i = 0; i < mNumInputModules; i++ )
+	{
+		sizes[i] = GetModuleSize( i );
+		patterns[i] = mPatternList[i].GetPatterns();
+	}
+	ok = CALMPatternFile::Save( filename, mNumInputModules, mNumPatterns, sizes, patterns, mFeedbackList );
+	delete[] sizes;
+	delete[] patterns;
+	return ok;
+}
+
+
+// Free the patterns with the winners and permutations that belong to them. 
+// A feedback list that is part of a mapped pattern file is dropped as well.
+void CALMNetwork::DeletePatterns( void )
+{
+	int i;
+	
+	if ( mPatternList  != NULL ) delete[] mPatternList;
+	if ( mPermutations != NULL )
+	{
+		CALMMemory::Freed( kMemPatterns, mNumPatterns * sizeof(int) );
+		delete[] mPermutations;
+	}
+	mPatternList = NULL;
+	mPermutations = NULL;
+	if ( mWinners != NULL )
+	{
+		CALMMemory::Freed( kMemWinners, WinnerMemory() );
+		for ( i = 0; i < mNumModules; i++ ) delete[] mWinners[i];
+		delete[] mWinners;
+	}
+	if ( mConvTimes != NULL )
+	{
+		for ( i = 0; i < mNumModules; i++ ) delete[] mConvTimes[i];
+		delete[] mConvTimes;
+	}
+	mWinners = NULL;
+	mConvTimes = NULL;
+	if ( mPatternStream != NULL ) delete mPatternStream;
+	mPatternStream = NULL;
+	if ( mPatternFile != NULL )
+	{
+		if ( mPatternFile->HasFeedback() && mFeedbackList == mPatternFile->GetFeedback() ) 
+			mFeedbackList = NULL;
+		delete mPatternFile;
+		mPatternFile = NULL;
+	}
+}
+
+
+// Free the feedback list, unless it is part of a mapped pattern file
+void CALMNetwork::DeleteFeedback( void )
+{
+	if ( mFeedbackList != NULL && 
+		 ( mPatternFile == NULL || ! mPatternFile->HasFeedback() || mFeedbackList != mPatternFile->GetFeedback() ) )
+	{
+		CALMMemory::Freed( kMemPatterns, mFeedbackMemory );
+		delete[] mFeedbackList;
+	}
+	mFeedbackList = NULL;
+	mFeedbackMemory = 0;
+}
+
+
+// allocate permutations and winner storage for mNumPatterns patterns
+void CALMNetwork::AllocateWinners( void )
+{
+	int i;
 	
 	// allocate permutations array
 	mPermutations = new int[mNumPatterns];
 	for ( i = 0; i < mNumPatterns; i++ ) mPermutations[i] = i;
+	CALMMemory::Allocated( kMemPatterns, mNumPatterns * sizeof(int) );
 
 	// create winners data storage
 	mWinners = new int*[mNumModules];
@@ -302,22 +719,23 @@ bool CALMNetwork::LoadPatterns( const char* filename )
 	mConvTimes = new int*[mNumModules];
 	for ( i = 0; i < mNumModules; i++ )
 		mConvTimes[i] = new int[mNumPatterns];
+	CALMMemory::Allocated( kMemWinners, WinnerMemory() );
 	// reset winners infos
 	Reset( O_WIN );
-
-	return true;
 }
 
 
 // return pattern
 data_type* CALMNetwork::GetPattern( int mIdx, int pIdx )
 {
+	if ( mPatternStream != NULL ) return mPatternStream->GetPattern( mIdx, pIdx );
 	if ( mPermutations != NULL ) pIdx = mPermutations[pIdx];
 	return mPatternList[mIdx].GetPattern( pIdx );
 }
 
 data_type CALMNetwork::GetPattern( int mIdx, int pIdx, int idx )
 {
+	if ( mPatternStream != NULL ) return mPatternStream->GetPattern( mIdx, pIdx )[idx];
 	if ( mPermutations != NULL ) pIdx = mPermutations[pIdx];
 	return mPatternList[mIdx].GetPattern( pIdx, idx );
 }
@@ -327,7 +745,9 @@ data_type CALMNetwork::GetPattern( int mIdx, int pIdx, int idx )
 void CALMNetwork::SetPatternOrder( int order )
 { 
 	mPatternOrder = order;
-	if ( mPatternOrder == kLinear )
+	if ( mPatternStream != NULL ) 
+		mPatternStream->SetOrder( order );
+	else if ( mPatternOrder == kLinear )
 		// set to ordered indices
 		for ( int i = 0; i < mNumPatterns; i++ ) mPermutations[i] = i;
 }
@@ -336,6 +756,11 @@ void CALMNetwork::SetPatternOrder( int order )
 // Permutes the indices for the patterns so we can present patterns in shuffled order
 void CALMNetwork::PermutePatterns( void )
 {
+	if ( mPatternStream != NULL )
+	{
+		mPatternStream->Permute();
+		return;
+	}
 	// set back ordered indices
 	for ( int i = 0; i < mNumPatterns; i++ ) mPermutations[i] = i;
 	// shuffle
@@ -346,8 +771,8 @@ void CALMNetwork::PermutePatterns( void )
 // Loads patterns from specified file
 bool CALMNetwork::LoadFeedback( const char* filename )
 {
-	ifstream	infile;
-	int			numPatterns;
+	CALMTokenizer	infile;
+	int				numPatterns;
 
 	// check if some module has been designated for feedback
 	if ( mFeedback == kNoWinner )
@@ -357,11 +782,10 @@ bool CALMNetwork::LoadFeedback( const char* filename )
 	}
 
 	// delete the old list
-	if ( mFeedbackList != NULL ) delete mFeedbackList;
+	DeleteFeedback();
 
 	// open the file
-	infile.open( filename );
-	if ( infile.fail() )
+	if ( ! infile.Open( filename ) )
 	{
 		FileOpenError( (char*)filename );
 		return false;
@@ -369,27 +793,24 @@ bool CALMNetwork::LoadFeedback( const char* filename )
 
 	// read the number of patterns: should be the same for all input modules
 	// and should equal mNumPatterns
-	SkipComments( &infile );
-	infile >> numPatterns;
+	infile.Read( numPatterns );
 	if ( numPatterns != mNumPatterns )
 	{
 		cerr << "\tError: Number of feedback entries does not match number of patterns!\n";
-		infile.close();
 		return false;
 	}
 
 	// allocate memory for feedback array
 	mFeedbackList = new int[mNumPatterns];
+	mFeedbackMemory = mNumPatterns * sizeof(int);
+	CALMMemory::Allocated( kMemPatterns, mFeedbackMemory );
 
 	// read each pattern in
 	for ( int i = 0; i < mNumPatterns; i++ )
-	{
-		SkipComments( &infile );	// ignore any comments;
-		infile >> mFeedbackList[i];
-	}
+		infile.Read( mFeedbackList[i] );	// comments are skipped
 
 	// close file
-	infile.close();
+	infile.Close();
 	
 	return true;
 }
@@ -398,22 +819,47 @@ bool CALMNetwork::LoadFeedback( const char* filename )
 // return feedback
 int CALMNetwork::GetFeedback( int pIdx )
 {
-	if ( mPermutations != NULL ) pIdx = mPermutations[pIdx];
-	return mFeedbackList[pIdx];
+	if ( mPatternStream != NULL && mPatternStream->HasFeedback() ) return mPatternStream->GetFeedback( pIdx );
+	return mFeedbackList[PatternIndex( pIdx )];
+}
+
+
+// index of the pattern presented at position "pIdx" of the current order
+int CALMNetwork::PatternIndex( int pIdx )
+{
+	if ( mPatternStream != NULL ) return mPatternStream->GetIndex( pIdx );
+	// in case of online learning, there are no permutations
+	if ( mPermutations != NULL ) return mPermutations[pIdx];
+	return pIdx;
 }
 
 
 // Set the pattern from preloaded patterndata
 void CALMNetwork::SetInput( int pIdx )
 {
+	int i;
+	
+	if ( mPatternStream != NULL )
+	{
+		// includes waiting for the blocks still being read
+		PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+		for ( i = 0; i < mNumInputModules; i++ )
+			mModules[i]->SetInput( mPatternStream->GetPattern( i, pIdx ) );
+		return;
+	}
 	pIdx = mPermutations[pIdx];	// permutations array holds the correct order
-	for ( int i = 0; i < mNumInputModules; i++ )
+	for ( i = 0; i < mNumInputModules; i++ )
 		mModules[i]->SetInput( mPatternList[i].GetPattern( pIdx ) );
 }
 
 // Set the pattern from preloaded patterndata
 void CALMNetwork::SetInput( int mIdx, int pIdx )
 {
+	if ( mPatternStream != NULL )
+	{
+		mModules[mIdx]->SetInput( mPatternStream->GetPattern( mIdx, pIdx ) );
+		return;
+	}
 	pIdx = mPermutations[pIdx];
 	mModules[mIdx]->SetInput( mPatternList[mIdx].GetPattern( pIdx ) );
 }
@@ -449,8 +895,7 @@ void CALMNetwork::SetOnlineFeedback( int fb )
 // Set feedback of given feedback module to index of node
 void CALMNetwork::SetFeedback( int pIdx )
 {
-	pIdx = mPermutations[pIdx];	// permutations array holds the correct order
-	dynamic_cast<Feedback*>(mModules[mFeedback])->SetFeedback( mFeedbackList[pIdx] );
+	dynamic_cast<Feedback*>(mModules[mFeedback])->SetFeedback( GetFeedback( pIdx ) );
 }
 
 
@@ -465,14 +910,18 @@ void CALMNetwork::SetWeightChangeFile( char* filename )
 	mWeightChangeFile.open( tmpname );
 	if ( mWeightChangeFile.fail() ) FileCreateError( tmpname );
 	
-	mGnuPlot = new GnuPlot( 0, 500, -2, 2 );
+	strcpy( tmpname, filename );
+	strcat( tmpname, "-dwt" );
+	if ( mGnuPlot != NULL ) delete mGnuPlot;
+	mGnuPlot = new GnuPlot( 0, 500, -2, 2, tmpname );
 }
 
 // sums all changes in weights and saves them to file.
 // this has to be called after every weight update, if desired
+// the plot is drawn in the background and may skip values
 void CALMNetwork::SaveWeightChanges( void )
 {
-	mWeightChangeFile << mWtChangeSum << endl;
+	mWeightChangeFile << mWtChangeSum << '\n';
 	
 	mGnuPlot->plot( mWtChangeSum );
 }
@@ -495,7 +944,7 @@ void CALMNetwork::SetActChangeFile( char* filename )
 void CALMNetwork::SaveActChanges( void )
 {
 	// sum all act changes and write to file
-	mActChangeFile << SumActivation() << endl;
+	mActChangeFile << SumActivation() << '\n';
 }
 
 // sums activation
@@ -579,7 +1028,7 @@ void CALMNetwork::SaveMuChanges( void )
 		mu_sum += mModules[i]->GetLearningRate();
 	mu_sum = mu_sum / (data_type)mNumModules;
 	// write it to file
-	mMuChangeFile << mu_sum << endl;
+	mMuChangeFile << mu_sum << '\n';
 }
 
 
@@ -587,6 +1036,7 @@ void CALMNetwork::SaveWeights( char* filename )
 {
 	ofstream outfile;
 	
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
 	outfile.open( filename );
 	if ( outfile.fail() )
 	{
@@ -601,17 +1051,101 @@ void CALMNetwork::SaveWeights( char* filename )
 
 bool CALMNetwork::LoadWeights( char* filename )
 {
-	ifstream infile;
+	CALMTokenizer infile;
 	
-	infile.open( filename );
-	if ( infile.fail() )
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	if ( ! infile.Open( filename ) )
 	{
 		FileOpenError( filename );
 		return false;
 	}
 	for ( int i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
 		mModules[i]->LoadWeights( &infile );
-	infile.close();
+	infile.Close();
+	return true;
+}
+
+
+// Write all weights to a binary weight file (see CALMWeightFile.h), which
+// stores the exact values and can be loaded without parsing
+void CALMNetwork::SaveBinaryWeights( char* filename )
+{
+	CALMWeightBlock*	blocks;
+	data_type*			weights;
+	size_t				numWeights = 0;
+	int					numBlocks = 0;
+	int					i, k, b;
+
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		numBlocks += mModules[i]->GetNumInConn();
+		for ( k = 0; k < mModules[i]->GetNumInConn(); k++ )
+			numWeights += mModules[i]->GetModuleSize() * mModules[i]->GetConnModuleSize( k );
+	}
+	blocks = new CALMWeightBlock[numBlocks+1];
+	weights = new data_type[numWeights+1];
+
+	b = 0;
+	numWeights = 0;
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		for ( k = 0; k < mModules[i]->GetNumInConn(); k++ )
+		{
+			memset( blocks + b, 0, sizeof(CALMWeightBlock) );
+			strcpy( blocks[b].toModule, mModules[i]->GetModuleName() );
+			strcpy( blocks[b].fromModule, mModules[i]->GetConnModuleName( k ) );
+			blocks[b].link = k;
+			blocks[b].rows = mModules[i]->GetModuleSize();
+			blocks[b].cols = mModules[i]->GetConnModuleSize( k );
+			mModules[i]->CopyWeights( k, weights + numWeights );
+			numWeights += blocks[b].rows * blocks[b].cols;
+			b++;
+		}
+	}
+	CALMWeightFile::Save( filename, numBlocks, blocks, weights );
+
+	delete[] blocks;
+	delete[] weights;
+}
+
+
+// Read weights from a binary weight file. Each connection is looked up in the
+// index by name, so the file may hold the connections in any order. All blocks
+// are checked before any weights are set, so a file that does not match the
+// network leaves it unchanged.
+bool CALMNetwork::LoadBinaryWeights( char* filename )
+{
+	CALMWeightFile		file;
+	CALMWeightBlock*	block;
+	int					i, k;
+
+	PROFILE_SCOPE( mProfiler, kProfIO, kUndefined );
+	if ( ! file.Open( filename ) ) return false;
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		for ( k = 0; k < mModules[i]->GetNumInConn(); k++ )
+		{
+			block = file.FindBlock( mModules[i]->GetModuleName(), mModules[i]->GetConnModuleName( k ), k );
+			if ( block == NULL || block->rows != mModules[i]->GetModuleSize() || 
+				 block->cols != mModules[i]->GetConnModuleSize( k ) )
+			{
+				cerr << "Error: " << filename << " has no weights for " << mModules[i]->GetModuleName();
+				cerr << " <- " << mModules[i]->GetConnModuleName( k ) << " of size ";
+				cerr << mModules[i]->GetModuleSize() << "x" << mModules[i]->GetConnModuleSize( k ) << endl;
+				return false;
+			}
+		}
+	}
+	// the index is mapped, so looking the blocks up again costs little
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		for ( k = 0; k < mModules[i]->GetNumInConn(); k++ )
+		{
+			block = file.FindBlock( mModules[i]->GetModuleName(), mModules[i]->GetConnModuleName( k ), k );
+			mModules[i]->SetWeights( k, file.GetWeights( block ) );
+		}
+	}
 	return true;
 }
 
@@ -665,26 +1199,20 @@ void CALMNetwork::UpdateTimeDelay( void )
 
 bool CALMNetwork::LoadParameters( const char* filename )
 {
-	ifstream infile;
+	CALMTokenizer infile;
 
 	// open the file
-	infile.open( filename );
-	if ( infile.fail() )
+	if ( ! infile.Open( filename ) )
 	{
 		FileOpenError( (char*)filename );
 		return false;
 	}
-	// read in each parameter
+	// read in each parameter, skipping comments
 	for ( int i = 0; i < gNumPars; i++ )
-	{
-		// skip comments
-		SkipComments( &infile );
-		// read parameter
-		infile >> mParameters[i];
-	}
+		infile.Read( mParameters[i] );
 
 	// close the file
-	infile.close();	
+	infile.Close();	
 	return true;
 }
 
@@ -708,6 +1236,21 @@ data_type CALMNetwork::GetParameter( int parType )
 }
 
 
+// Switching profiling on starts counting from zero; switching it off discards
+// the counts. Hardware counters count the events of the calling thread, so call
+// this from the thread that trains the network. Without CALM_PROFILE there is
+// nothing to count.
+void CALMNetwork::SetProfiling( bool on, bool counters )
+{
+	if ( mProfiler != NULL ) delete mProfiler;
+	mProfiler = NULL;
+#if CALM_PROFILE
+	if ( on ) mProfiler = new CALMProfiler( mNumModules+mNumInputModules );
+	if ( on && counters ) mProfiler->OpenCounters();
+#endif
+}
+
+
 /*--------------------------------------*
  *		  TRAINING FUNCTIONS 			*
  *--------------------------------------*/
@@ -715,53 +1258,84 @@ data_type CALMNetwork::GetParameter( int parType )
 // Train single pass
 void CALMNetwork::Learn( void )
 {
-	int i;
+	CALMProfiler*	prof = mProfiler;
+	int				i;
 	
+	ALLOC_GUARD( "CALMNetwork::Learn" );
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfActivation, i );
 		mModules[i]->UpdateActivation();
+	}
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfWeights, i );
 		mModules[i]->UpdateWeights( mWtChangeSum );
+	}
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfSwap, i );
 		mModules[i]->SwapActs();
+	}
 }
 
 
 // Test single pass
 void CALMNetwork::Test( void )
 {
-	int i;
+	CALMProfiler*	prof = mProfiler;
+	int				i;
 	
+	ALLOC_GUARD( "CALMNetwork::Test" );
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfActivation, i );
 		mModules[i]->UpdateActivationTest();
+	}
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfSwap, i );
 		mModules[i]->SwapActs();
+	}
 }
 
 
 // Test single pass for clamp routine; indicate whether to use noise
 void CALMNetwork::Test( bool useNoise )
 {
-	int i;
+	CALMProfiler*	prof = mProfiler;
+	int				i;
 	
+	ALLOC_GUARD( "CALMNetwork::Test" );
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfActivation, i );
 		mModules[i]->UpdateActivationTest( useNoise );
+	}
 	for ( i = mNumInputModules; i < mNumModules+mNumInputModules; i++ )
+	{
+		PROFILE_SCOPE( prof, kProfSwap, i );
 		mModules[i]->SwapActs();
+	}
 }
 
 
 // collect winners for each module, store them, and return convergence info
 bool CALMNetwork::CollectWinners( int pIdx, int ite )
 {
-	bool converged = true;
-	int	 i, winner, convtime;
+	CALMProfiler*	prof = mProfiler;
+	bool			converged = true;
+	int	 			i, winner, convtime;
 
-	// in case of online learning, there are no permutations
-	if ( mPermutations != NULL ) pIdx = mPermutations[pIdx];
+	ALLOC_GUARD( "CALMNetwork::CollectWinners" );
+	pIdx = PatternIndex( pIdx );
 		
 	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
 	{
-		mModules[i]->ConvCheck( ite, &winner, &convtime );
+		{
+			PROFILE_SCOPE( prof, kProfConvCheck, i );
+			mModules[i]->ConvCheck( ite, &winner, &convtime );
+		}
 		if ( winner != kNoWinner )
 		{
 			SetWinner( i-mNumInputModules, pIdx, winner );
@@ -774,12 +1348,35 @@ bool CALMNetwork::CollectWinners( int pIdx, int ite )
 }
 
 
+// Append the outcome of presenting pattern pIdx to the results: one row for
+// each CALM module. The weight changes only count when learning.
+void CALMNetwork::RecordResults( CALMResults* results, int epoch, int pIdx, bool learning )
+{
+	data_type	wtChange = learning ? mWtChangeSum : 0.0;
+	data_type	act;
+	int			i, m;
+
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
+	pIdx = PatternIndex( pIdx );
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		m = i - mNumInputModules;
+		act = 0.0;
+		mModules[i]->SumActivation( act );
+		results->Append( epoch, pIdx, m, mWinners[m][pIdx], mConvTimes[m][pIdx],
+						 wtChange, act, mModules[i]->GetLearningRate() );
+	}
+}
+
+
 /*--------------------------------------*
  *		      3D Plot FUNCTIONS 	    *
  *--------------------------------------*/
 
 void CALMNetwork::Init3DPlot( const char* fromMdl, const char* toMdl )
 {
+	char name[128];
+	
 	m3DTo = GetModuleIndex( toMdl );	
 	for ( int j = 0; j < mModules[m3DTo]->GetNumInConn(); j++ )
 	{	
@@ -789,8 +1386,9 @@ void CALMNetwork::Init3DPlot( const char* fromMdl, const char* toMdl )
 			break;
 		}
 	}			
+	snprintf( name, 128, "%s-%s", fromMdl, toMdl );
 	m3DPlot = new GnuPlot( GetModuleSize( GetModuleIndex( toMdl ) ),
-						   GetModuleSize( GetModuleIndex( fromMdl ) ) );
+						   GetModuleSize( GetModuleIndex( fromMdl ) ), name );
 }
 
 void CALMNetwork::Resize3DPlot( const char* fromMdl, const char* toMdl )
@@ -811,11 +1409,16 @@ void CALMNetwork::Resize3DPlot( const char* fromMdl, const char* toMdl )
 void CALMNetwork::End3DPlot( void )
 {
 	if ( m3DPlot != NULL ) delete m3DPlot;
+	m3DPlot = NULL;
 }
 
+// the weights are only copied if the plotting thread can take them
 void CALMNetwork::Do3DPlot( void )
 {
-	mModules[m3DTo]->CopyWeights( m3DIdx, m3DPlot->GetMatrix() );
+	data_type* frame = m3DPlot->getFrame();
+	
+	if ( frame == NULL ) return;
+	mModules[m3DTo]->CopyWeights( m3DIdx, frame );
 	m3DPlot->plot();
 }
 
@@ -838,6 +1441,17 @@ int CALMNetwork::GetMaximumSize( void )
 	return maxsize;
 }
 
+
+// checks whether any connection in the network is a time-delay connection. If not,
+// the response to an input does not depend on the history of earlier inputs
+bool CALMNetwork::HasDelayLinks( void )
+{
+	for ( int i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+		for ( int j = 0; j < mModules[i]->GetNumInConn(); j++ )
+			if ( mModules[i]->GetConnType(j) == kDelayLink ) return true;
+	return false;
+}
+
 	
 bool CALMNetwork::WriteSpecs( char* filename )
 {
@@ -962,6 +1576,7 @@ void CALMNetwork::PrintWinners( ostream* os )
 	int 	i, j, node;
 	int		spacing = GetMaximumSize() / 10 + 2;
 
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
 	AdjustStream( *os, 0, 1, kLeft, false );
 	for ( i = 0; i < mNumPatterns; i++ )
 	{
@@ -993,6 +1608,7 @@ void CALMNetwork::PrintCurrentWinners( ostream* os )
 	int 	i, node;
 	int		spacing = GetMaximumSize() / 10 + 2;
 
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
 	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
 	{
 		node = mModules[i]->GetWinner();
@@ -1018,14 +1634,69 @@ void CALMNetwork::PrintCurrentWinners( ostream* os )
 
 void CALMNetwork::PrintWeights( ostream* os, int epoch, int pIdx )
 {
-	// in case of online learning, there are no permutations
-	if ( mPermutations != NULL ) pIdx = mPermutations[pIdx];
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
+	pIdx = PatternIndex( pIdx );
 	*os << endl << "Weights for epoch " << epoch << " and pattern " << pIdx << endl;
 	for ( int i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
 		mModules[i]->PrintWeights( os );
 	*os << endl;
 }
 
+// Same as PrintWeights, but only copies the weights to the log writer. Weights
+// that do not fit in its buffer are printed directly, once the log is written.
+void CALMNetwork::RecordWeights( CALMLogWriter* log, int epoch, int pIdx )
+{
+	CALMLogRecord*	record;
+	CALMLogModule*	module;
+	CALMLogModule*	from;
+	size_t			size = sizeof(CALMLogRecord);
+	char*			pos;
+	int				i, k;
+	
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		size += sizeof(CALMLogModule);
+		for ( k = 0; k < mModules[i]->GetNumInConn(); k++ )
+			size += sizeof(CALMLogModule) + (size_t)mModules[i]->GetModuleSize() * mModules[i]->GetConnModuleSize( k ) * sizeof(data_type);
+	}
+	pos = log->Reserve( size );
+	if ( pos == NULL )
+	{
+		log->Flush();
+		PrintWeights( log->GetStream(), epoch, pIdx );
+		return;
+	}
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
+	record = (CALMLogRecord*)pos;
+	record->numModules = mNumModules;
+	record->epoch = epoch;
+	record->ite = PatternIndex( pIdx );
+	record->format = 0;
+	record->kind = kLogWeights;
+	pos += sizeof(CALMLogRecord);
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		module = (CALMLogModule*)pos;
+		strcpy( module->name, mModules[i]->GetModuleName() );
+		module->type = mModules[i]->GetModuleType();
+		module->size = mModules[i]->GetModuleSize();
+		module->numConn = mModules[i]->GetNumInConn();
+		pos += sizeof(CALMLogModule);
+		for ( k = 0; k < module->numConn; k++ )
+		{
+			from = (CALMLogModule*)pos;
+			strcpy( from->name, mModules[i]->GetConnModuleName( k ) );
+			from->type = kUndefined;
+			from->size = mModules[i]->GetConnModuleSize( k );
+			from->numConn = 0;
+			pos += sizeof(CALMLogModule);
+			mModules[i]->CopyWeights( k, (data_type*)pos );
+			pos += module->size * from->size * sizeof(data_type);
+		}
+	}
+	log->Commit();
+}
+
 void CALMNetwork::PrintWeights( ostream* os )
 {
 	*os << endl << "Weights: " << endl;
@@ -1046,6 +1717,61 @@ void CALMNetwork::PrintActs( ostream* os, int epoch, int ite, int format, bool w
 	*os << endl;
 }
 
+// Same as PrintActs, but only copies the activations to the log writer, 
+// which prints them in the background
+void CALMNetwork::RecordActs( CALMLogWriter* log, int epoch, int ite, int format, bool withInp )
+{
+	char* pos = log->Reserve( ActsRecordSize( withInp ) );
+	
+	if ( pos == NULL )
+	{
+		log->Flush();
+		PrintActs( log->GetStream(), epoch, ite, format, withInp );
+		return;
+	}
+	FillActsRecord( pos, epoch, ite, format, withInp );
+	log->Commit();
+}
+
+// number of bytes needed by FillActsRecord
+size_t CALMNetwork::ActsRecordSize( bool withInp )
+{
+	size_t	size = sizeof(CALMLogRecord);
+	
+	for ( int i = withInp ? 0 : mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+		size += sizeof(CALMLogModule) + ( 2 * mModules[i]->GetModuleSize() + 2 ) * sizeof(data_type);
+	return size;
+}
+
+// copy the activations of all modules into a record (see CALMLogWriter.h)
+void CALMNetwork::FillActsRecord( char* pos, int epoch, int ite, int format, bool withInp )
+{
+	int				first = withInp ? 0 : mNumInputModules;
+	int				last = mNumInputModules + mNumModules;
+	CALMLogRecord*	record;
+	CALMLogModule*	module;
+	int				i;
+	
+	record = (CALMLogRecord*)pos;
+	record->numModules = last - first;
+	record->epoch = epoch;
+	record->ite = ite;
+	record->format = format;
+	record->kind = kLogActs;
+	pos += sizeof(CALMLogRecord);
+	for ( i = first; i < last; i++ )
+	{
+		module = (CALMLogModule*)pos;
+		strcpy( module->name, mModules[i]->GetModuleName() );
+		module->type = mModules[i]->GetModuleType();
+		module->size = mModules[i]->GetModuleSize();
+		module->numConn = 0;
+		pos += sizeof(CALMLogModule);
+		mModules[i]->CopyActs( (data_type*)pos );
+		pos += ( 2 * module->size + 2 ) * sizeof(data_type);
+	}
+}
+
 void CALMNetwork::PrintActs( ostream* os, int pat, int format, bool withInp )
 {
 	*os << endl << "epoch " << pat << endl;
@@ -1059,11 +1785,52 @@ void CALMNetwork::PrintActs( ostream* os, int pat, int format, bool withInp )
 
 void CALMNetwork::PrintPotentials( ostream* os )
 {
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
 	for ( int i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
 		mModules[i]->PrintPotentials( os );
 	*os << endl;
 }
 
+// Same as PrintPotentials, but only copies the potentials to the log writer
+void CALMNetwork::RecordPotentials( CALMLogWriter* log )
+{
+	CALMLogRecord*	record;
+	CALMLogModule*	module;
+	size_t			size = sizeof(CALMLogRecord);
+	char*			pos;
+	int				i;
+	
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+		size += sizeof(CALMLogModule) + mModules[i]->GetModuleSize() * sizeof(data_type);
+	pos = log->Reserve( size );
+	if ( pos == NULL )
+	{
+		log->Flush();
+		PrintPotentials( log->GetStream() );
+		return;
+	}
+	PROFILE_SCOPE( mProfiler, kProfOutput, kUndefined );
+	record = (CALMLogRecord*)pos;
+	record->numModules = mNumModules;
+	record->epoch = 0;
+	record->ite = 0;
+	record->format = 0;
+	record->kind = kLogPotentials;
+	pos += sizeof(CALMLogRecord);
+	for ( i = mNumInputModules; i < mNumInputModules+mNumModules; i++ )
+	{
+		module = (CALMLogModule*)pos;
+		strcpy( module->name, mModules[i]->GetModuleName() );
+		module->type = mModules[i]->GetModuleType();
+		module->size = mModules[i]->GetModuleSize();
+		module->numConn = 0;
+		pos += sizeof(CALMLogModule);
+		mModules[i]->CopyPotentials( (data_type*)pos );
+		pos += module->size * sizeof(data_type);
+	}
+	log->Commit();
+}
+
 // prints out the sizes of the modules in the network (useful after pruning/growing)
 void CALMNetwork::PrintSizes( ostream* os )
 {
@@ -1073,7 +1840,8 @@ void CALMNetwork::PrintSizes( ostream* os )
 
 void CALMNetwork::PrintPatterns( ostream* os )
 {
-	// read pattern set for each input module
+	// streamed patterns are not held in memory
+	if ( mPatternList == NULL ) return;
 	for ( int i = 0; i < mNumInputModules; i++ )
 		*os << mPatternList[i];
 }
@@ -0,0 +1,181 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMPatternFile class
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMArena.h"
+#include "CALMPatternFile.h"
+
+
+CALMPatternFile::CALMPatternFile()
+{
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mBlocks = NULL;
+}
+
+
+CALMPatternFile::~CALMPatternFile()
+{
+	Close();
+}
+
+
+// map a binary pattern file into memory and check its header and index
+bool CALMPatternFile::Open( const char* filename )
+{
+	struct stat	st;
+	int			fd;
+	size_t		bytes;
+
+	Close();
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
+	{
+		FileOpenError( (char*)filename );
+		return false;
+	}
+	if ( fstat( fd, &st ) != 0 || st.st_size < (off_t)sizeof(CALMPatternHeader) )
+	{
+		cerr << "Error: " << filename << " is not a binary pattern file" << endl;
+		close( fd );
+		return false;
+	}
+	mSize = st.st_size;
+	mData = (char*)mmap( NULL, mSize, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( mData == MAP_FAILED )
+	{
+		mData = NULL;
+		FileOpenError( (char*)filename );
+		return false;
+	}
+
+	mHeader = (CALMPatternHeader*)mData;
+	mBlocks = (CALMPatternBlock*)( mData + sizeof(CALMPatternHeader) );
+	if ( strncmp( mHeader->magic, kPatternFileMagic, 8 ) != 0 )
+	{
+		cerr << "Error: " << filename << " is not a binary pattern file" << endl;
+		Close();
+		return false;
+	}
+	if ( mHeader->version != kPatternFileVersion || mHeader->valueSize != sizeof(data_type) )
+	{
+		cerr << "Error: " << filename << " has version " << mHeader->version << " with ";
+		cerr << mHeader->valueSize << " byte values, expected version " << kPatternFileVersion;
+		cerr << " with " << sizeof(data_type) << " byte values" << endl;
+		Close();
+		return false;
+	}
+	// all patterns and the feedback list have to lie within the file
+	if ( sizeof(CALMPatternHeader) + (size_t)mHeader->numModules * sizeof(CALMPatternBlock) > mSize )
+	{
+		cerr << "Error: " << filename << " is truncated" << endl;
+		Close();
+		return false;
+	}
+	for ( int i = 0; i < (int)mHeader->numModules; i++ )
+	{
+		bytes = (size_t)mHeader->numPatterns * mBlocks[i].moduleSize * sizeof(data_type);
+		if ( mBlocks[i].moduleSize < 0 || mBlocks[i].offset > mSize || bytes > mSize - mBlocks[i].offset )
+		{
+			cerr << "Error: " << filename << " is truncated" << endl;
+			Close();
+			return false;
+		}
+	}
+	bytes = (size_t)mHeader->numPatterns * sizeof(int32_t);
+	if ( mHeader->hasFeedback && ( mHeader->feedbackOffset > mSize || bytes > mSize - mHeader->feedbackOffset ) )
+	{
+		cerr << "Error: " << filename << " is truncated" << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+
+void CALMPatternFile::Close( void )
+{
+	if ( mData != NULL ) munmap( mData, mSize );
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mBlocks = NULL;
+}
+
+
+// Write a binary pattern file. "patterns" holds the pattern set of each input
+// module, with the patterns stored one after the other. "feedback" may be NULL.
+bool CALMPatternFile::Save( const char* filename, int numModules, int numPatterns,
+							int* moduleSizes, data_type** patterns, int* feedback )
+{
+	CALMPatternHeader	header;
+	CALMPatternBlock*	blocks;
+	ofstream			outfile;
+	char				padding[kCacheLine];
+	size_t				offset, bytes;
+	int					i;
+
+	outfile.open( filename, ios::binary );
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+
+	memset( &header, 0, sizeof(CALMPatternHeader) );
+	memset( padding, 0, kCacheLine );
+	strncpy( header.magic, kPatternFileMagic, 8 );
+	header.version = kPatternFileVersion;
+	header.valueSize = sizeof(data_type);
+	header.numModules = numModules;
+	header.numPatterns = numPatterns;
+	header.hasFeedback = ( feedback != NULL );
+
+	// each pattern set starts at a cache line
+	blocks = new CALMPatternBlock[numModules+1];
+	offset = CALMArena::Aligned( sizeof(CALMPatternHeader) + numModules * sizeof(CALMPatternBlock) );
+	for ( i = 0; i < numModules; i++ )
+	{
+		memset( blocks + i, 0, sizeof(CALMPatternBlock) );
+		blocks[i].moduleSize = moduleSizes[i];
+		blocks[i].offset = offset;
+		offset += CALMArena::Aligned( (size_t)numPatterns * moduleSizes[i] * sizeof(data_type) );
+	}
+	header.feedbackOffset = offset;
+
+	outfile.write( (char*)&header, sizeof(CALMPatternHeader) );
+	outfile.write( (char*)blocks, numModules * sizeof(CALMPatternBlock) );
+	offset = sizeof(CALMPatternHeader) + numModules * sizeof(CALMPatternBlock);
+	for ( i = 0; i < numModules; i++ )
+	{
+		outfile.write( padding, blocks[i].offset - offset );
+		bytes = (size_t)numPatterns * moduleSizes[i] * sizeof(data_type);
+		outfile.write( (char*)patterns[i], bytes );
+		offset = blocks[i].offset + bytes;
+	}
+	if ( feedback != NULL )
+	{
+		outfile.write( padding, header.feedbackOffset - offset );
+		outfile.write( (char*)feedback, numPatterns * sizeof(int) );
+	}
+	outfile.close();
+	delete[] blocks;
+
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,345 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMPatternStream class
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "Rnd.h"
+#include "CALMTrace.h"
+#include "CALMMemory.h"
+#include "CALMPatternStream.h"
+
+
+CALMPatternStream::CALMPatternStream()
+{
+	mFile = kUndefined;
+	mNumModules = 0;
+	mNumPatterns = 0;
+	mModuleSizes = NULL;
+	mOffsets = NULL;
+	mBlockOrder = NULL;
+	mInBlock = NULL;
+	mPatterns[0] = mPatterns[1] = NULL;
+	mFeedback[0] = mFeedback[1] = NULL;
+}
+
+
+CALMPatternStream::~CALMPatternStream()
+{
+	Close();
+}
+
+
+// Open a binary pattern file for streaming. "window" is the maximum number of
+// patterns held in memory, divided over the two block buffers.
+bool CALMPatternStream::Open( const char* filename, int window )
+{
+	CALMPatternHeader	header;
+	CALMPatternBlock	block;
+	struct stat			st;
+	size_t				bytes;
+	int					i, s;
+
+	Close();
+	mFile = open( filename, O_RDONLY );
+	if ( mFile < 0 )
+	{
+		FileOpenError( (char*)filename );
+		return false;
+	}
+	if ( fstat( mFile, &st ) != 0 ||
+		 pread( mFile, &header, sizeof(CALMPatternHeader), 0 ) != sizeof(CALMPatternHeader) ||
+		 strncmp( header.magic, kPatternFileMagic, 8 ) != 0 )
+	{
+		cerr << "Error: " << filename << " is not a binary pattern file" << endl;
+		Close();
+		return false;
+	}
+	if ( header.version != kPatternFileVersion || header.valueSize != sizeof(data_type) )
+	{
+		cerr << "Error: " << filename << " has version " << header.version << " with ";
+		cerr << header.valueSize << " byte values, expected version " << kPatternFileVersion;
+		cerr << " with " << sizeof(data_type) << " byte values" << endl;
+		Close();
+		return false;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise( mFile, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+	mNumModules = header.numModules;
+	mNumPatterns = header.numPatterns;
+	mHasFeedback = ( header.hasFeedback != 0 );
+	mFeedbackOffset = header.feedbackOffset;
+	mModuleSizes = new int[mNumModules+1];
+	mOffsets = new size_t[mNumModules+1];
+	for ( i = 0; i < mNumModules; i++ )
+	{
+		if ( pread( mFile, &block, sizeof(CALMPatternBlock),
+					sizeof(CALMPatternHeader) + i * sizeof(CALMPatternBlock) ) != sizeof(CALMPatternBlock) )
+			block.moduleSize = kUndefined;
+		mModuleSizes[i] = block.moduleSize;
+		mOffsets[i] = block.offset;
+		bytes = (size_t)mNumPatterns * block.moduleSize * sizeof(data_type);
+		if ( block.moduleSize < 0 || block.offset > (size_t)st.st_size || bytes > st.st_size - block.offset )
+		{
+			cerr << "Error: " << filename << " is truncated" << endl;
+			Close();
+			return false;
+		}
+	}
+	bytes = (size_t)mNumPatterns * sizeof(int);
+	if ( mHasFeedback && ( mFeedbackOffset > (size_t)st.st_size || bytes > st.st_size - mFeedbackOffset ) )
+	{
+		cerr << "Error: " << filename << " is truncated" << endl;
+		Close();
+		return false;
+	}
+
+	// set up the blocks and their buffers
+	mBlockSize = ( window > 1 ) ? window / 2 : 1;
+	if ( mBlockSize > mNumPatterns && mNumPatterns > 0 ) mBlockSize = mNumPatterns;
+	mNumBlocks = ( mNumPatterns + mBlockSize - 1 ) / mBlockSize;
+	mBlockOrder = new int[mNumBlocks+1];
+	mInBlock = new int[mBlockSize];
+	for ( s = 0; s < 2; s++ )
+	{
+		mPatterns[s] = new data_type*[mNumModules+1];
+		for ( i = 0; i < mNumModules; i++ )
+			mPatterns[s][i] = new data_type[(size_t)mBlockSize * mModuleSizes[i]];
+		mFeedback[s] = new int[mBlockSize];
+		mBlock[s] = kUndefined;
+	}
+	CALMMemory::Allocated( kMemPatterns, GetMemory() );
+	mCurrent = 0;
+	mRequest = kUndefined;
+	mBusy = false;
+	mQuit = false;
+	mReader = std::thread( &CALMPatternStream::ReadAhead, this );
+
+	SetOrder( kLinear );
+	return true;
+}
+
+
+size_t CALMPatternStream::GetMemory( void )
+{
+	size_t bytes = mBlockSize * sizeof(int);
+	
+	for ( int i = 0; i < mNumModules; i++ ) bytes += (size_t)mBlockSize * mModuleSizes[i] * sizeof(data_type);
+	return 2 * bytes;
+}
+
+
+// stop reading ahead and free the buffers
+void CALMPatternStream::Close( void )
+{
+	if ( mReader.joinable() )
+	{
+		{
+			std::lock_guard<std::mutex> lock( mLock );
+			mQuit = true;
+		}
+		mSignal.notify_all();
+		mReader.join();
+	}
+	if ( mPatterns[0] != NULL ) CALMMemory::Freed( kMemPatterns, GetMemory() );
+	for ( int s = 0; s < 2; s++ )
+	{
+		if ( mPatterns[s] != NULL )
+		{
+			for ( int i = 0; i < mNumModules; i++ ) delete[] mPatterns[s][i];
+			delete[] mPatterns[s];
+		}
+		if ( mFeedback[s] != NULL ) delete[] mFeedback[s];
+		mPatterns[s] = NULL;
+		mFeedback[s] = NULL;
+	}
+	if ( mModuleSizes != NULL ) delete[] mModuleSizes;
+	if ( mOffsets != NULL ) delete[] mOffsets;
+	if ( mBlockOrder != NULL ) delete[] mBlockOrder;
+	if ( mInBlock != NULL ) delete[] mInBlock;
+	mModuleSizes = NULL;
+	mOffsets = NULL;
+	mBlockOrder = NULL;
+	mInBlock = NULL;
+	if ( mFile >= 0 ) close( mFile );
+	mFile = kUndefined;
+	mNumModules = 0;
+	mNumPatterns = 0;
+}
+
+
+// present blocks and patterns in file order again
+void CALMPatternStream::SetOrder( int order )
+{
+	if ( order != kLinear ) return;
+	for ( int b = 0; b < mNumBlocks; b++ ) mBlockOrder[b] = b;
+	mShuffled = false;
+	mPosition = kUndefined;
+	if ( mNumBlocks > 0 ) Prefetch( mBlockOrder[0] );
+}
+
+
+// Shuffle the order of the blocks. The patterns within a block are shuffled
+// when the block comes up, with a seed fixed for the whole pass, so that
+// a block gets the same order if it is visited twice. A short last block
+// stays last, so that every position but the last holds a full block and
+// Seek can find a presentation index by dividing by the block size.
+void CALMPatternStream::Permute( void )
+{
+	int full = ( mNumPatterns % mBlockSize == 0 ) ? mNumBlocks : mNumBlocks - 1;
+
+	for ( int b = 0; b < mNumBlocks; b++ ) mBlockOrder[b] = b;
+	::Permute( mBlockOrder, full );
+	mSeed = IntegerRNG();
+	mShuffled = true;
+	mPosition = kUndefined;
+	if ( mNumBlocks > 0 ) Prefetch( mBlockOrder[0] );
+}
+
+
+// make the block holding presentation "pIdx" current and return
+// the position of the pattern within that block
+int CALMPatternStream::Seek( int pIdx )
+{
+	if ( pIdx / mBlockSize != mPosition ) SwitchBlock( pIdx / mBlockSize );
+	return mInBlock[pIdx % mBlockSize];
+}
+
+
+void CALMPatternStream::SwitchBlock( int position )
+{
+	int				block = mBlockOrder[position];
+	int				count = Min( mBlockSize, mNumPatterns - block * mBlockSize );
+	int				i, j, k;
+	unsigned int	seed;
+
+	if ( mBlock[mCurrent] != block )
+	{
+		// the other buffer is either being filled with this block or
+		// with some block we do not need now
+		WaitIdle();
+		mCurrent = 1 - mCurrent;
+		if ( mBlock[mCurrent] != block ) ReadBlock( mCurrent, block );
+	}
+	mPosition = position;
+
+	// order of the patterns within the block
+	for ( i = 0; i < count; i++ ) mInBlock[i] = i;
+	if ( mShuffled )
+	{
+		seed = mSeed ^ ( block * 2654435761u );
+		for ( i = count - 1; i > 0; i-- )
+		{
+			seed = seed * 1103515245 + 12345;
+			j = ( seed >> 8 ) % ( i + 1 );
+			k = mInBlock[i];
+			mInBlock[i] = mInBlock[j];
+			mInBlock[j] = k;
+		}
+	}
+
+	// start reading the next block
+	Prefetch( mBlockOrder[( position + 1 ) % mNumBlocks] );
+}
+
+
+// read a block of patterns from the file into one of the buffers
+void CALMPatternStream::ReadBlock( int slot, int block )
+{
+	size_t	start = (size_t)block * mBlockSize;
+	size_t	count = Min( (size_t)mBlockSize, mNumPatterns - start );
+	size_t	bytes, done;
+	ssize_t	n;
+	char*	data;
+
+	TRACE_SCOPE( "read block", block );
+	for ( int i = 0; i <= mNumModules; i++ )
+	{
+		if ( i < mNumModules )
+		{
+			data = (char*)mPatterns[slot][i];
+			bytes = count * mModuleSizes[i] * sizeof(data_type);
+			start = (size_t)block * mBlockSize * mModuleSizes[i] * sizeof(data_type) + mOffsets[i];
+		}
+		else if ( mHasFeedback )
+		{
+			data = (char*)mFeedback[slot];
+			bytes = count * sizeof(int);
+			start = (size_t)block * mBlockSize * sizeof(int) + mFeedbackOffset;
+		}
+		else
+			break;
+		// large reads may return in parts
+		for ( done = 0; done < bytes; done += n )
+		{
+			n = pread( mFile, data + done, bytes - done, start + done );
+			if ( n <= 0 )
+			{
+				cerr << "Error: Could not read patterns from file" << endl;
+				memset( data + done, 0, bytes - done );
+				break;
+			}
+		}
+	}
+	mBlock[slot] = block;
+}
+
+
+// let the reader thread fill the other buffer with the given block
+void CALMPatternStream::Prefetch( int block )
+{
+	WaitIdle();
+	if ( mBlock[1-mCurrent] == block ) return;
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		mRequest = block;
+		mRequestSlot = 1 - mCurrent;
+		mBlock[mRequestSlot] = kUndefined;
+		mBusy = true;
+	}
+	mSignal.notify_all();
+}
+
+
+// wait for the reader thread to finish the current read
+void CALMPatternStream::WaitIdle( void )
+{
+	TRACE_SCOPE( "read wait", kUndefined );
+	std::unique_lock<std::mutex> lock( mLock );
+	mSignal.wait( lock, [this]{ return ! mBusy; } );
+}
+
+
+// body of the reader thread
+void CALMPatternStream::ReadAhead( void )
+{
+	int block, slot;
+
+	TRACE_THREAD( "pattern reader" );
+	for ( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> lock( mLock );
+			mSignal.wait( lock, [this]{ return mQuit || mRequest != kUndefined; } );
+			if ( mQuit ) return;
+			block = mRequest;
+			slot = mRequestSlot;
+			mRequest = kUndefined;
+		}
+		ReadBlock( slot, block );
+		{
+			std::lock_guard<std::mutex> lock( mLock );
+			mBusy = false;
+		}
+		mSignal.notify_all();
+	}
+}
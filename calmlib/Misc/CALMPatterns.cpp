@@ -7,40 +7,60 @@
 #include "CALMGlobal.h"
 #include "Utilities.h"
 #include "CALMPatterns.h"
+#include "CALMMemory.h"
 
 
 // free up memory
 void CALMPatterns::DeletePatterns( void )
 {
-	// clean up the patterns storage matrix
-	if ( mNumPatterns != 0 )
-		DisposeMatrix( mPatterns, mNumPatterns );
+	// clean up the patterns storage, unless it belongs to a pattern file
+	if ( mPatterns != NULL && ! mMapped )
+	{
+		CALMMemory::Freed( kMemPatterns, GetMemory() );
+		delete[] mPatterns;
+	}
+	mPatterns = NULL;
+	mMapped = false;
 	mNumPatterns = 0;
 }
 
 
 // Load patterns from file: called within CALMNetwork::LoadPatterns
-void CALMPatterns::LoadPatterns( ifstream* infile, int numPatterns, int moduleSize ) 
+void CALMPatterns::LoadPatterns( CALMTokenizer* infile, int numPatterns, int moduleSize ) 
 {
+	data_type* pattern;
+	
+	DeletePatterns();
 	// read the number of patterns
 	mNumPatterns = numPatterns;
 	mModuleSize  = moduleSize;
 		
-	// create the storage matrix
-	mPatterns = CreateMatrix( 0.0, mNumPatterns, mModuleSize );
+	// create the storage
+	mPatterns = new data_type[(size_t)mNumPatterns * mModuleSize]();
+	CALMMemory::Allocated( kMemPatterns, GetMemory() );
 
 	// read each pattern in
 	for ( int i = 0; i < mNumPatterns; i++ )
 	{
+		pattern = GetPattern( i );
 		for ( int j = 0; j < mModuleSize; j++ )
-		{
-			SkipComments( infile );	// ignore any comments;
-			*infile >> mPatterns[i][j];
-		}
+			infile->Read( pattern[j] );	// comments are skipped
 	}
 }
 
 
+// Use patterns stored elsewhere, i.e. in a mapped CALMPatternFile, without
+// copying them. The storage has to stay valid as long as the patterns are used.
+void CALMPatterns::MapPatterns( data_type* patterns, int numPatterns, int moduleSize )
+{
+	DeletePatterns();
+	mPatterns = patterns;
+	mNumPatterns = numPatterns;
+	mModuleSize = moduleSize;
+	mMapped = true;
+}
+
+
 // useless function, but let's keep it in
 void CALMPatterns::Print( ostream *os ) 
 {
@@ -48,7 +68,7 @@ void CALMPatterns::Print( ostream *os )
 	{
 		*os << '\t';
 		for ( int j = 0; j < mModuleSize; j++ ) 
-			*os << mPatterns[i][j] << " ";
+			*os << GetPattern( i, j ) << " ";
 		*os << endl;
 	}
 }
@@ -0,0 +1,338 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMProfiler class
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMNetwork.h"
+#include "CALMProfiler.h"
+#include "CALMMemory.h"
+
+static const char* sPhaseNames[kNumProfPhases] =
+{
+	"activation", "weights", "swap", "convcheck", "resize", "output", "io", "trainfile", "testfile"
+};
+
+static const char* sCounterNames[kNumHWCounters] =
+{
+	"hw_cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+
+CALMProfiler::CALMProfiler( int numModules )
+{
+	mCycles = NULL;
+	mCalls = NULL;
+	mHW = NULL;
+	mNumSlots = 0;
+	mGroup = kUndefined;
+	mNumOpen = 0;
+	for ( int i = 0; i < kNumHWCounters; i++ )
+	{
+		mFds[i] = kUndefined;
+		mPosition[i] = kUndefined;
+	}
+	SetNumModules( numModules );
+}
+
+
+CALMProfiler::~CALMProfiler()
+{
+	CloseCounters();
+	if ( mCycles != NULL ) delete[] mCycles;
+	if ( mCalls != NULL ) delete[] mCalls;
+	if ( mHW != NULL ) delete[] mHW;
+}
+
+
+void CALMProfiler::SetNumModules( int numModules )
+{
+	if ( numModules + 1 != mNumSlots )
+	{
+		if ( mCycles != NULL ) delete[] mCycles;
+		if ( mCalls != NULL ) delete[] mCalls;
+		if ( mHW != NULL ) delete[] mHW;
+		mNumSlots = numModules + 1;
+		mCycles = new CALMCycles[kNumProfPhases * mNumSlots];
+		mCalls = new CALMCycles[kNumProfPhases * mNumSlots];
+		mHW = new CALMCycles[kNumProfPhases * mNumSlots * kNumHWCounters];
+	}
+	Clear();
+}
+
+
+void CALMProfiler::Clear( void )
+{
+	for ( int i = 0; i < kNumProfPhases * mNumSlots; i++ )
+	{
+		mCycles[i] = 0;
+		mCalls[i] = 0;
+	}
+	for ( int i = 0; i < kNumProfPhases * mNumSlots * kNumHWCounters; i++ ) mHW[i] = 0;
+	clock_gettime( CLOCK_MONOTONIC, &mStartTime );
+	mStartCycles = Cycles();
+}
+
+
+// total of a phase over the network and all modules
+CALMCycles CALMProfiler::GetCycles( int phase )
+{
+	CALMCycles total = 0;
+
+	for ( int i = 0; i < mNumSlots; i++ ) total += mCycles[phase * mNumSlots + i];
+	return total;
+}
+
+
+CALMCycles CALMProfiler::GetCalls( int phase )
+{
+	CALMCycles total = 0;
+
+	for ( int i = 0; i < mNumSlots; i++ ) total += mCalls[phase * mNumSlots + i];
+	return total;
+}
+
+
+CALMCycles CALMProfiler::GetCounter( int phase, int counter )
+{
+	CALMCycles total = 0;
+
+	for ( int i = kUndefined; i < mNumSlots - 1; i++ ) total += GetCounter( phase, i, counter );
+	return total;
+}
+
+
+// Opens the hardware counters of the calling thread, the one that trains the
+// network, as a group that is read at once. Counters the processor does not
+// have are left out; without the cycle counter, which leads the group, there
+// are none.
+bool CALMProfiler::OpenCounters( void )
+{
+#ifdef __linux__
+	static const unsigned long long configs[kNumHWCounters] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+	struct perf_event_attr	attr;
+	int						fd;
+
+	CloseCounters();
+	for ( int i = 0; i < kNumHWCounters; i++ )
+	{
+		memset( &attr, 0, sizeof(attr) );
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall( SYS_perf_event_open, &attr, 0, -1, ( i == 0 ) ? -1 : mGroup, 0 );
+		if ( fd < 0 )
+		{
+			if ( i == 0 )
+			{
+				cerr << "hardware counters are not available (perf_event_open: " << strerror( errno );
+				cerr << "), so only cycles are counted" << endl;
+				return false;
+			}
+			continue;
+		}
+		if ( i == 0 ) mGroup = fd;
+		mFds[i] = fd;
+		mPosition[i] = mNumOpen++;
+	}
+	return true;
+#else
+	cerr << "hardware counters are only available on Linux, so only cycles are counted" << endl;
+	return false;
+#endif
+}
+
+
+void CALMProfiler::CloseCounters( void )
+{
+	for ( int i = 0; i < kNumHWCounters; i++ )
+	{
+		if ( mFds[i] != kUndefined ) close( mFds[i] );
+		mFds[i] = kUndefined;
+		mPosition[i] = kUndefined;
+	}
+	mGroup = kUndefined;
+	mNumOpen = 0;
+}
+
+
+// current values of the counters; those not counted are zero
+void CALMProfiler::ReadCounters( CALMCycles* values )
+{
+	CALMCycles group[kNumHWCounters+1];
+
+	if ( read( mGroup, group, sizeof(CALMCycles) * ( mNumOpen + 1 ) ) <= 0 ) group[0] = 0;
+	for ( int i = 0; i < kNumHWCounters; i++ )
+		values[i] = ( mPosition[i] != kUndefined && mPosition[i] < (int)group[0] ) ? group[mPosition[i]+1] : 0;
+}
+
+
+void CALMProfiler::AddCounters( int phase, int idx, CALMCycles* start )
+{
+	CALMCycles	values[kNumHWCounters];
+	CALMCycles*	hw = mHW + ( phase * mNumSlots + idx + 1 ) * kNumHWCounters;
+
+	ReadCounters( values );
+	for ( int i = 0; i < kNumHWCounters; i++ ) hw[i] += values[i] - start[i];
+}
+
+
+// the rate of the counter since the last Clear
+double CALMProfiler::CyclesPerSecond( void )
+{
+	struct timespec	now;
+	CALMCycles		cycles = Cycles();
+	double			seconds;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	seconds = ( now.tv_sec - mStartTime.tv_sec ) + ( now.tv_nsec - mStartTime.tv_nsec ) * 1e-9;
+	if ( seconds <= 0.0 || cycles <= mStartCycles ) return 1e9;
+	return ( cycles - mStartCycles ) / seconds;
+}
+
+
+const char* CALMProfiler::PhaseName( int phase )
+{
+	return sPhaseNames[phase];
+}
+
+
+const char* CALMProfiler::CounterName( int counter )
+{
+	return sCounterNames[counter];
+}
+
+
+const char* CALMProfiler::ModuleName( CALMNetwork* net, int idx )
+{
+	if ( idx == kUndefined || net == NULL || idx >= net->GetNumInputs() + net->GetNumModules() )
+		return "network";
+	return net->GetModule( idx )->GetModuleName();
+}
+
+
+// append the instructions per cycle and the cache and branch misses per
+// thousand instructions to "line"
+void CALMProfiler::PrintCounters( char* line, CALMCycles* values )
+{
+	size_t	len = strlen( line );
+	double	kilo = values[kHWInstructions] * 1e-3;
+
+	if ( HasCounter( kHWInstructions ) && values[kHWCycles] > 0 )
+		len += snprintf( line + len, 256 - len, " %6.2f", (double)values[kHWInstructions] / values[kHWCycles] );
+	else
+		len += snprintf( line + len, 256 - len, " %6s", "-" );
+	for ( int c = kHWCacheMisses; c <= kHWBranchMisses; c++ )
+	{
+		if ( HasCounter( c ) && HasCounter( kHWInstructions ) && kilo > 0.0 )
+			len += snprintf( line + len, 256 - len, " %10.3f", values[c] / kilo );
+		else
+			len += snprintf( line + len, 256 - len, " %10s", "-" );
+	}
+}
+
+
+// Prints the totals of each phase, then the phases of the network and of each
+// module that ran. The share of each phase is that of the time spent in
+// CALMTrainFile and CALMTestFile, if they ran. With hardware counters, the
+// instructions per cycle and the misses per thousand instructions follow, and
+// then the memory in use.
+void CALMProfiler::Print( ostream* os, CALMNetwork* net )
+{
+	char		line[256];
+	double		rate = CyclesPerSecond();
+	double		total = GetCycles( kProfTrainFile ) + GetCycles( kProfTestFile );
+	CALMCycles	cycles, calls;
+	CALMCycles	values[kNumHWCounters];
+	int			p, i, c;
+
+	if ( total == 0.0 )
+		for ( p = 0; p < kProfTrainFile; p++ ) total += GetCycles( p );
+	if ( total == 0.0 ) total = 1.0;
+
+	snprintf( line, 256, "%-12s %-12s %12s %16s %12s %12s %7s", "phase", "module", "calls",
+			  "cycles", "seconds", "cycles/call", "%" );
+	if ( HasCounters() )
+		snprintf( line + strlen( line ), 256 - strlen( line ), " %6s %10s %10s", "ipc", "cache/ki", "branch/ki" );
+	*os << line << endl;
+	for ( i = kUndefined - 1; i < mNumSlots - 1; i++ )
+	{
+		for ( p = 0; p < kNumProfPhases; p++ )
+		{
+			// first the totals, then each slot
+			cycles = ( i < kUndefined ) ? GetCycles( p ) : GetCycles( p, i );
+			calls = ( i < kUndefined ) ? GetCalls( p ) : GetCalls( p, i );
+			if ( calls == 0 ) continue;
+			snprintf( line, 256, "%-12s %-12s %12llu %16llu %12.6f %12.1f %7.2f", PhaseName( p ),
+					  ( i < kUndefined ) ? "all" : ModuleName( net, i ), calls, cycles, cycles / rate,
+					  (double)cycles / calls, 100.0 * cycles / total );
+			if ( HasCounters() )
+			{
+				for ( c = 0; c < kNumHWCounters; c++ )
+					values[c] = ( i < kUndefined ) ? GetCounter( p, c ) : GetCounter( p, i, c );
+				PrintCounters( line, values );
+			}
+			*os << line << endl;
+		}
+	}
+	*os << "(" << rate * 1e-6 << " million cycles per second)" << endl << endl;
+	CALMMemory::Print( os, net );
+}
+
+
+// Writes all counters to "filename" as JSON: one entry per phase of the network
+// and of each module that ran, and the memory counters
+bool CALMProfiler::Save( const char* filename, CALMNetwork* net )
+{
+	ofstream	outfile( filename );
+	bool		first = true;
+
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+	outfile.precision( 12 );
+	outfile << "{\n\t\"cycles_per_second\": " << CyclesPerSecond() << ",\n\t\"counters\": [";
+	for ( int i = kUndefined; i < mNumSlots - 1; i++ )
+	{
+		for ( int p = 0; p < kNumProfPhases; p++ )
+		{
+			if ( GetCalls( p, i ) == 0 ) continue;
+			outfile << ( first ? "\n" : ",\n" );
+			outfile << "\t\t{ \"phase\": \"" << PhaseName( p ) << "\", \"module\": \"" << ModuleName( net, i );
+			outfile << "\", \"calls\": " << GetCalls( p, i ) << ", \"cycles\": " << GetCycles( p, i );
+			for ( int c = 0; c < kNumHWCounters; c++ )
+				if ( HasCounter( c ) ) outfile << ", \"" << CounterName( c ) << "\": " << GetCounter( p, i, c );
+			outfile << " }";
+			first = false;
+		}
+	}
+	outfile << "\n\t],\n\t\"memory\": ";
+	CALMMemory::Save( &outfile );
+	outfile << "\n}" << endl;
+	outfile.close();
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,165 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMResults class
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMResults.h"
+
+#define kNPYHeaderSize	128		// room for the NPY header, so it can be rewritten at the end
+
+static const char* sColumnNames[kNumResColumns] =
+{
+	"epoch", "pattern", "module", "winner", "convtime", "dwsum", "act", "mu"
+};
+
+
+CALMResults::CALMResults()
+{
+	int i;
+
+	for ( i = 0; i < kNumResIntColumns; i++ ) mInts[i] = new int32_t[kResultsChunk];
+	for ( i = 0; i < kNumResColumns-kNumResIntColumns; i++ ) mValues[i] = new data_type[kResultsChunk];
+	for ( i = 0; i < kNumResColumns; i++ ) mFiles[i] = NULL;
+	mNumRows = 0;
+	mTotalRows = 0;
+	mNPY = false;
+}
+
+
+CALMResults::~CALMResults()
+{
+	int i;
+
+	Close();
+	for ( i = 0; i < kNumResIntColumns; i++ ) delete[] mInts[i];
+	for ( i = 0; i < kNumResColumns-kNumResIntColumns; i++ ) delete[] mValues[i];
+}
+
+
+const char* CALMResults::GetColumnName( int col )
+{
+	return sColumnNames[col];
+}
+
+
+// Create "filename.res", or with npy set, "filename.<column>.npy" for each column
+bool CALMResults::Open( const char* filename, bool npy )
+{
+	CALMResultsHeader	header;
+	char				tmpname[FILENAME_MAX];
+	int					numFiles = npy ? kNumResColumns : 1;
+
+	Close();
+	mNPY = npy;
+	mNumRows = 0;
+	mTotalRows = 0;
+	for ( int i = 0; i < numFiles; i++ )
+	{
+		if ( npy )
+			snprintf( tmpname, FILENAME_MAX, "%s.%s.npy", filename, sColumnNames[i] );
+		else
+			snprintf( tmpname, FILENAME_MAX, "%s.res", filename );
+		mFiles[i] = new ofstream( tmpname, ios::binary );
+		if ( mFiles[i]->fail() )
+		{
+			FileCreateError( tmpname );
+			for ( int j = 0; j <= i; j++ )
+			{
+				delete mFiles[j];
+				mFiles[j] = NULL;
+			}
+			return false;
+		}
+		if ( npy ) WriteNPYHeader( mFiles[i], i );
+	}
+	if ( ! npy )
+	{
+		memset( &header, 0, sizeof(CALMResultsHeader) );
+		strncpy( header.magic, kResultsMagic, 8 );
+		header.version = kResultsVersion;
+		header.valueSize = sizeof(data_type);
+		header.numColumns = kNumResColumns;
+		mFiles[0]->write( (char*)&header, sizeof(CALMResultsHeader) );
+	}
+	strcpy( mFilename, filename );
+	return true;
+}
+
+
+// write the remaining rows and complete the headers
+bool CALMResults::Close( void )
+{
+	bool ok = true;
+
+	if ( ! IsOpen() ) return true;
+	WriteChunk();
+	for ( int i = 0; i < kNumResColumns; i++ )
+	{
+		if ( mFiles[i] == NULL ) continue;
+		if ( mNPY )
+		{
+			mFiles[i]->seekp( 0 );
+			WriteNPYHeader( mFiles[i], i );
+		}
+		mFiles[i]->close();
+		if ( mFiles[i]->fail() ) ok = false;
+		delete mFiles[i];
+		mFiles[i] = NULL;
+	}
+	if ( ! ok ) FileCreateError( mFilename );
+	return ok;
+}
+
+
+// append the collected rows to the file(s)
+void CALMResults::WriteChunk( void )
+{
+	CALMResultsChunk	chunk;
+	int					i;
+
+	if ( mNumRows == 0 ) return;
+	if ( ! mNPY )
+	{
+		chunk.numRows = mNumRows;
+		chunk.reserved = 0;
+		mFiles[0]->write( (char*)&chunk, sizeof(CALMResultsChunk) );
+	}
+	for ( i = 0; i < kNumResColumns; i++ )
+	{
+		ofstream* file = mNPY ? mFiles[i] : mFiles[0];
+		if ( i < kNumResIntColumns )
+			file->write( (char*)mInts[i], mNumRows * sizeof(int32_t) );
+		else
+			file->write( (char*)mValues[i-kNumResIntColumns], mNumRows * sizeof(data_type) );
+	}
+	mTotalRows += mNumRows;
+	mNumRows = 0;
+}
+
+
+// NPY format version 1.0: magic string, version, header length and a
+// dictionary describing the array, padded to kNPYHeaderSize bytes
+void CALMResults::WriteNPYHeader( ofstream* file, int col )
+{
+	char		header[kNPYHeaderSize+1];
+	uint16_t	one = 1;
+	char		order = ( *(char*)&one == 1 ) ? '<' : '>';
+	char		type = ( col < kNumResIntColumns ) ? 'i' : 'f';
+	int			size = ( col < kNumResIntColumns ) ? sizeof(int32_t) : sizeof(data_type);
+	int			len;
+
+	memset( header, ' ', kNPYHeaderSize );
+	memcpy( header, "\x93NUMPY\x01\x00", 8 );
+	header[8] = ( kNPYHeaderSize - 10 ) & 0xff;
+	header[9] = ( kNPYHeaderSize - 10 ) >> 8;
+	len = snprintf( header + 10, kNPYHeaderSize - 10, "{'descr': '%c%c%d', 'fortran_order': False, 'shape': (%llu,), }",
+					order, type, size, (unsigned long long)mTotalRows );
+	header[10+len] = ' ';
+	header[kNPYHeaderSize-1] = '\n';
+	file->write( header, kNPYHeaderSize );
+}
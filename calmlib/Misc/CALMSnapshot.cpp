@@ -0,0 +1,200 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMSnapshot class
+*/
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMSnapshot.h"
+
+
+CALMSnapshot::CALMSnapshot()
+{
+	mData = NULL;
+	mSize = 0;
+	mCapacity = 0;
+	mPos = 0;
+}
+
+
+CALMSnapshot::~CALMSnapshot()
+{
+	if ( mData != NULL ) delete[] mData;
+}
+
+
+// make sure the buffer can hold at least the given number of bytes
+// grows by doubling, so that filling a snapshot takes few allocations
+void CALMSnapshot::Reserve( size_t capacity )
+{
+	char*	data;
+	
+	if ( capacity <= mCapacity ) return;
+	if ( capacity < 2 * mCapacity ) capacity = 2 * mCapacity;
+	
+	data = new char[capacity];
+	if ( mData != NULL )
+	{
+		memcpy( data, mData, mSize );
+		delete[] mData;
+	}
+	mData = data;
+	mCapacity = capacity;
+}
+
+
+void CALMSnapshot::Swap( CALMSnapshot* other )
+{
+	char*	data = mData;
+	size_t	size = mSize;
+	size_t	capacity = mCapacity;
+	size_t	pos = mPos;
+	
+	mData = other->mData;
+	mSize = other->mSize;
+	mCapacity = other->mCapacity;
+	mPos = other->mPos;
+	other->mData = data;
+	other->mSize = size;
+	other->mCapacity = capacity;
+	other->mPos = pos;
+}
+
+
+// Write the snapshot to a checkpoint file. The file is written under a 
+// temporary name first and then renamed, so that a crash while writing 
+// leaves the previous checkpoint intact. With "sync", the data is on disk
+// when this returns, including the new name.
+bool CALMSnapshot::Save( const char* filename, bool sync )
+{
+	CALMCheckpointHeader	header;
+	char					tmpname[FILENAME_MAX];
+	char					dirname[FILENAME_MAX];
+	char*					slash;
+	bool					ok;
+	int						fd;
+
+	snprintf( tmpname, FILENAME_MAX, "%s.tmp", filename );
+	fd = open( tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if ( fd < 0 )
+	{
+		FileCreateError( tmpname );
+		return false;
+	}
+	memset( &header, 0, sizeof(CALMCheckpointHeader) );
+	strncpy( header.magic, kCheckpointMagic, 8 );
+	header.version = kCheckpointVersion;
+	header.valueSize = sizeof(data_type);
+	header.size = mSize;
+	ok = WriteAll( fd, (char*)&header, sizeof(CALMCheckpointHeader) ) && WriteAll( fd, mData, mSize );
+	if ( ok && sync ) ok = ( fsync( fd ) == 0 );
+	if ( close( fd ) != 0 ) ok = false;
+	if ( ! ok || rename( tmpname, filename ) != 0 )
+	{
+		FileCreateError( (char*)filename );
+		remove( tmpname );
+		return false;
+	}
+	
+	// make the rename itself durable
+	if ( sync )
+	{
+		strcpy( dirname, filename );
+		slash = strrchr( dirname, '/' );
+		if ( slash == NULL ) strcpy( dirname, "." );
+		else if ( slash == dirname ) dirname[1] = '\0';
+		else *slash = '\0';
+		fd = open( dirname, O_RDONLY );
+		if ( fd >= 0 )
+		{
+			fsync( fd );
+			close( fd );
+		}
+	}
+	return true;
+}
+
+
+// write a block of data, which may take several calls
+bool CALMSnapshot::WriteAll( int fd, const char* data, size_t len )
+{
+	ssize_t	n;
+	
+	for ( size_t done = 0; done < len; done += n )
+	{
+		n = write( fd, data + done, len - done );
+		if ( n <= 0 ) return false;
+	}
+	return true;
+}
+
+
+// read a block of data, which may take several calls
+bool CALMSnapshot::ReadAll( int fd, char* data, size_t len )
+{
+	ssize_t	n;
+	
+	for ( size_t done = 0; done < len; done += n )
+	{
+		n = read( fd, data + done, len - done );
+		if ( n <= 0 ) return false;
+	}
+	return true;
+}
+
+
+// Read a checkpoint file into the snapshot. The size in the header is checked
+// against the length of the file before any memory is reserved for it.
+bool CALMSnapshot::Load( const char* filename )
+{
+	CALMCheckpointHeader	header;
+	struct stat				st;
+	bool					ok;
+	int						fd;
+
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
+	{
+		FileOpenError( (char*)filename );
+		return false;
+	}
+	if ( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(CALMCheckpointHeader) ||
+		 ! ReadAll( fd, (char*)&header, sizeof(CALMCheckpointHeader) ) || 
+		 strncmp( header.magic, kCheckpointMagic, 8 ) != 0 )
+	{
+		cerr << "Error: " << filename << " is not a checkpoint file" << endl;
+		close( fd );
+		return false;
+	}
+	if ( header.version != kCheckpointVersion || header.valueSize != sizeof(data_type) )
+	{
+		cerr << "Error: " << filename << " has version " << header.version << " with ";
+		cerr << header.valueSize << " byte values, expected version " << kCheckpointVersion;
+		cerr << " with " << sizeof(data_type) << " byte values" << endl;
+		close( fd );
+		return false;
+	}
+	if ( header.size != (uint64_t)st.st_size - sizeof(CALMCheckpointHeader) )
+	{
+		cerr << "Error: " << filename << " holds " << (uint64_t)st.st_size - sizeof(CALMCheckpointHeader);
+		cerr << " bytes of state, expected " << header.size << endl;
+		close( fd );
+		return false;
+	}
+	Clear();
+	Reserve( header.size );
+	ok = ReadAll( fd, mData, header.size );
+	close( fd );
+	if ( ! ok )
+	{
+		cerr << "Error: " << filename << " could not be read" << endl;
+		return false;
+	}
+	mSize = header.size;
+	return true;
+}
@@ -0,0 +1,168 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMTokenizer class
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <charconv>
+#include <limits>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMTokenizer.h"
+
+#define kFastDigits		18		// most digits accumulated on the fast path
+#define kFastPower		10		// largest power of 10 that is exact in a float
+
+static const data_type kPow10[kFastPower+1] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+
+
+CALMTokenizer::CALMTokenizer()
+{
+	mBuffer = NULL;
+	mPos = NULL;
+	mEnd = NULL;
+}
+
+
+CALMTokenizer::~CALMTokenizer()
+{
+	Close();
+}
+
+
+// read the whole file into memory
+bool CALMTokenizer::Open( const char* filename )
+{
+	struct stat	st;
+	size_t		done;
+	ssize_t		n;
+	int			fd;
+
+	Close();
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 ) return false;
+	if ( fstat( fd, &st ) != 0 )
+	{
+		close( fd );
+		return false;
+	}
+	mBuffer = new char[st.st_size+1];
+	for ( done = 0; done < (size_t)st.st_size; done += n )
+	{
+		n = read( fd, mBuffer + done, st.st_size - done );
+		if ( n <= 0 ) break;
+	}
+	close( fd );
+	mBuffer[done] = '\0';
+	mPos = mBuffer;
+	mEnd = mBuffer + done;
+	return true;
+}
+
+
+void CALMTokenizer::Close( void )
+{
+	if ( mBuffer != NULL ) delete[] mBuffer;
+	mBuffer = NULL;
+	mPos = NULL;
+	mEnd = NULL;
+}
+
+
+// skip white space and comments up to the next token
+void CALMTokenizer::SkipComments( void )
+{
+	for ( ;; )
+	{
+		while ( mPos < mEnd && ( *mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r' ) ) mPos++;
+		if ( mPos >= mEnd || *mPos != '#' ) return;
+		while ( mPos < mEnd && *mPos != '\n' ) mPos++;
+	}
+}
+
+
+// skip white space and any lines of which the first token starts
+// with one of the characters in "starts"
+void CALMTokenizer::SkipLines( const char* starts )
+{
+	for ( ;; )
+	{
+		while ( mPos < mEnd && ( *mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r' ) ) mPos++;
+		if ( mPos >= mEnd || strchr( starts, *mPos ) == NULL ) return;
+		while ( mPos < mEnd && *mPos != '\n' ) mPos++;
+	}
+}
+
+
+bool CALMTokenizer::Read( int& value )
+{
+	const char* pos;
+
+	SkipComments();
+	// from_chars does not take a leading '+'
+	pos = mPos;
+	if ( pos < mEnd && *pos == '+' && pos + 1 < mEnd && *(pos+1) != '-' ) pos++;
+	std::from_chars_result r = std::from_chars( pos, mEnd, value );
+	if ( r.ec != std::errc() )
+	{
+		value = 0;
+		return false;
+	}
+	mPos = r.ptr;
+	return true;
+}
+
+
+bool CALMTokenizer::Read( data_type& value )
+{
+	const char*			pos;
+	char*				end;
+	unsigned long long	mantissa = 0;
+	int					digits = 0, decimals = 0;
+	bool				negative = false;
+
+	SkipComments();
+	pos = mPos;
+	if ( pos < mEnd && *pos == '+' && pos + 1 < mEnd && *(pos+1) != '-' ) pos++;
+
+	// Plain decimals with a short mantissa, like most patterns and weights, are 
+	// computed directly: a mantissa and power of 10 that are both exact in 
+	// data_type give a correctly rounded quotient, as from_chars would.
+	end = (char*)pos;
+	if ( *end == '-' ) { negative = true; end++; }
+	while ( *end >= '0' && *end <= '9' && digits < kFastDigits ) { mantissa = mantissa * 10 + ( *end++ - '0' ); digits++; }
+	if ( *end == '.' )
+	{
+		end++;
+		while ( *end >= '0' && *end <= '9' && digits < kFastDigits ) { mantissa = mantissa * 10 + ( *end++ - '0' ); digits++; decimals++; }
+	}
+	if ( digits > 0 && decimals <= kFastPower && mantissa <= ( 1ULL << numeric_limits<data_type>::digits ) &&
+		 ! ( ( *end >= '0' && *end <= '9' ) || *end == 'e' || *end == 'E' || *end == '.' ) )
+	{
+		value = (data_type)mantissa / kPow10[decimals];
+		if ( negative ) value = -value;
+		mPos = end;
+		return true;
+	}
+
+	std::from_chars_result r = std::from_chars( pos, mEnd, value );
+	if ( r.ec == std::errc::result_out_of_range )
+	{
+		// let strtod decide on values beyond the range of data_type
+		value = (data_type)strtod( pos, &end );
+		mPos = end;
+		return true;
+	}
+	if ( r.ec != std::errc() )
+	{
+		value = 0;
+		return false;
+	}
+	mPos = r.ptr;
+	return true;
+}
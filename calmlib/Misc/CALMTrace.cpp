@@ -0,0 +1,180 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMTrace class
+*/
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMTrace.h"
+#include "CALMAllocGuard.h"
+
+atomic<bool>		CALMTrace::sOn( false );
+int					CALMTrace::sSampling = 1;
+int64_t				CALMTrace::sStart = 0;
+char				CALMTrace::sFileName[FILENAME_MAX];
+CALMTraceBuffer*	CALMTrace::sBuffers = NULL;
+int					CALMTrace::sNumThreads = 0;
+mutex				CALMTrace::sLock;
+
+// the buffer of the current thread, which is retired when the thread finishes
+// and can then be taken over by a new thread once it has been written out
+struct CALMTraceThread
+{
+	CALMTraceBuffer*	buffer;
+
+	~CALMTraceThread()
+	{
+		if ( buffer == NULL ) return;
+		lock_guard<mutex> lock( CALMTrace::sLock );
+		buffer->retired = true;
+	}
+};
+
+static thread_local CALMTraceThread sThread = { NULL };
+
+
+// Starts recording into "filename", which is written by Stop
+bool CALMTrace::Start( const char* filename, int sampling )
+{
+	if ( IsOn() ) Stop();
+	if ( strlen( filename ) >= FILENAME_MAX ) return false;
+	strcpy( sFileName, filename );
+	sSampling = Max( sampling, 0 );
+	SetThreadName( "main" );
+	sStart = Now();
+	sOn = true;
+	return true;
+}
+
+
+// Stops recording and writes all events, one thread after the other, which
+// the viewers sort by time
+bool CALMTrace::Stop( void )
+{
+	CALMTraceBuffer*	buf;
+	CALMTraceEvent*		event;
+	ofstream			outfile;
+	char				line[256];
+	size_t				i, count, dropped = 0;
+	int					pid = (int)getpid();
+	bool				first = true;
+
+	if ( ! IsOn() ) return true;
+	sOn = false;
+
+	lock_guard<mutex> lock( sLock );
+	outfile.open( sFileName );
+	if ( outfile.fail() ) FileCreateError( sFileName );
+	outfile << "{\"traceEvents\":[";
+	for ( buf = sBuffers; buf != NULL; buf = buf->next )
+	{
+		count = buf->count.load( memory_order_acquire );
+		dropped += buf->dropped;
+		if ( count > 0 )
+		{
+			snprintf( line, 256, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+					  first ? "" : ",", pid, buf->tid, buf->name );
+			outfile << line;
+			first = false;
+		}
+		for ( i = 0; i < count; i++ )
+		{
+			event = buf->chunks[i / kTraceChunk] + i % kTraceChunk;
+			snprintf( line, 256, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d", event->name,
+					  event->phase, event->time * 1e-3, pid, buf->tid );
+			outfile << line;
+			if ( event->arg != kUndefined ) outfile << ",\"args\":{\"n\":" << event->arg << "}";
+			outfile << "}";
+		}
+		buf->count.store( 0, memory_order_relaxed );
+		buf->dropped = 0;
+	}
+	outfile << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":" << dropped << "}}" << endl;
+	outfile.close();
+	if ( outfile.fail() )
+	{
+		FileCreateError( sFileName );
+		return false;
+	}
+	return true;
+}
+
+
+// name shown for the current thread
+void CALMTrace::SetThreadName( const char* name )
+{
+	CALMTraceBuffer* buf = ThisThread();
+
+	strncpy( buf->name, name, 31 );
+	buf->name[31] = '\0';
+}
+
+
+void CALMTrace::Record( char phase, const char* name, int arg )
+{
+	CALMTraceBuffer*	buf = ThisThread();
+	size_t				n = buf->count.load( memory_order_relaxed );
+	CALMTraceEvent*		event;
+
+	// spans that end after the trace stopped are left open
+	if ( phase == 'E' && ! IsOn() ) return;
+	if ( n >= (size_t)kTraceChunk * kTraceChunks )
+	{
+		buf->dropped++;
+		return;
+	}
+	if ( buf->chunks[n / kTraceChunk] == NULL )
+	{
+		// the buffer grows a chunk at a time, also inside the training loops
+		ALLOC_ALLOW();
+		buf->chunks[n / kTraceChunk] = new CALMTraceEvent[kTraceChunk];
+	}
+	event = buf->chunks[n / kTraceChunk] + n % kTraceChunk;
+	event->name = name;
+	event->time = Now() - sStart;
+	event->arg = arg;
+	event->phase = phase;
+	buf->count.store( n + 1, memory_order_release );
+}
+
+
+// the buffer of the current thread, set up at its first event
+CALMTraceBuffer* CALMTrace::ThisThread( void )
+{
+	CALMTraceBuffer* buf;
+
+	if ( sThread.buffer != NULL ) return sThread.buffer;
+
+	ALLOC_ALLOW();
+	lock_guard<mutex> lock( sLock );
+	for ( buf = sBuffers; buf != NULL; buf = buf->next )
+		if ( buf->retired && buf->count.load() == 0 ) break;
+	if ( buf == NULL )
+	{
+		buf = new CALMTraceBuffer;
+		memset( buf->chunks, 0, sizeof(buf->chunks) );
+		buf->tid = ++sNumThreads;
+		buf->next = sBuffers;
+		sBuffers = buf;
+	}
+	buf->count = 0;
+	buf->dropped = 0;
+	buf->retired = false;
+	snprintf( buf->name, 32, "thread %d", buf->tid );
+	sThread.buffer = buf;
+	return buf;
+}
+
+
+int64_t CALMTrace::Now( void )
+{
+	struct timespec t;
+
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
@@ -17,12 +17,3 @@ void CALMWeight::SetWeight( data_type newWeight, data_type maxval, data_type min
 }
 
 
-void CALMWeight::operator=( CALMWeight &source )
-{
-	if ( this == &source ) return;
-	
-	mWeightValue = source.mWeightValue;
-	mWeightChange = source.mWeightChange;
-	mClamped = source.mClamped;
-}
-
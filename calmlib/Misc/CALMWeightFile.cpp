@@ -0,0 +1,314 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Implementation of CALMWeightFile class
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits>
+#include <string>
+#include "CALMGlobal.h"
+#include "Utilities.h"
+#include "CALMArena.h"
+#include "CALMWeightFile.h"
+
+
+CALMWeightFile::CALMWeightFile()
+{
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mBlocks = NULL;
+}
+
+
+CALMWeightFile::~CALMWeightFile()
+{
+	Close();
+}
+
+
+// map a binary weight file into memory and check its header and index
+bool CALMWeightFile::Open( const char* filename )
+{
+	struct stat	st;
+	int			fd;
+
+	Close();
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
+	{
+		FileOpenError( (char*)filename );
+		return false;
+	}
+	if ( fstat( fd, &st ) != 0 || st.st_size < (off_t)sizeof(CALMWeightHeader) )
+	{
+		cerr << "Error: " << filename << " is not a binary weight file" << endl;
+		close( fd );
+		return false;
+	}
+	mSize = st.st_size;
+	mData = (char*)mmap( NULL, mSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( mData == MAP_FAILED )
+	{
+		mData = NULL;
+		FileOpenError( (char*)filename );
+		return false;
+	}
+
+	mHeader = (CALMWeightHeader*)mData;
+	mBlocks = (CALMWeightBlock*)( mData + sizeof(CALMWeightHeader) );
+	if ( strncmp( mHeader->magic, kWeightFileMagic, 8 ) != 0 )
+	{
+		cerr << "Error: " << filename << " is not a binary weight file" << endl;
+		Close();
+		return false;
+	}
+	if ( mHeader->version != kWeightFileVersion || mHeader->valueSize != sizeof(data_type) )
+	{
+		cerr << "Error: " << filename << " has version " << mHeader->version << " with ";
+		cerr << mHeader->valueSize << " byte weights, expected version " << kWeightFileVersion;
+		cerr << " with " << sizeof(data_type) << " byte weights" << endl;
+		Close();
+		return false;
+	}
+	// every block has to lie within the file
+	if ( sizeof(CALMWeightHeader) + (size_t)mHeader->numBlocks * sizeof(CALMWeightBlock) > mSize )
+	{
+		cerr << "Error: " << filename << " is truncated" << endl;
+		Close();
+		return false;
+	}
+	for ( int i = 0; i < (int)mHeader->numBlocks; i++ )
+	{
+		if ( mBlocks[i].rows < 0 || mBlocks[i].cols < 0 || mBlocks[i].offset > mSize ||
+			 (size_t)mBlocks[i].rows * mBlocks[i].cols * sizeof(data_type) > mSize - mBlocks[i].offset )
+		{
+			cerr << "Error: " << filename << " is truncated" << endl;
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void CALMWeightFile::Close( void )
+{
+	if ( mData != NULL ) munmap( mData, mSize );
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mBlocks = NULL;
+}
+
+
+// find the weights of a given connection. Returns NULL if there are none.
+CALMWeightBlock* CALMWeightFile::FindBlock( const char* toModule, const char* fromModule, int link )
+{
+	for ( int i = 0; i < (int)mHeader->numBlocks; i++ )
+	{
+		if ( mBlocks[i].link == link &&
+			 strncmp( mBlocks[i].toModule, toModule, 32 ) == 0 &&
+			 strncmp( mBlocks[i].fromModule, fromModule, 32 ) == 0 )
+			return mBlocks + i;
+	}
+	return NULL;
+}
+
+
+// Write a binary weight file. "weights" holds the weights of all blocks, one
+// after the other. The offsets in the blocks are filled in here.
+bool CALMWeightFile::Save( const char* filename, int numBlocks, CALMWeightBlock* blocks, data_type* weights )
+{
+	CALMWeightHeader	header;
+	ofstream			outfile;
+	char				padding[kCacheLine];
+	size_t				offset, bytes;
+	int					i;
+
+	outfile.open( filename, ios::binary );
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+
+	memset( &header, 0, sizeof(CALMWeightHeader) );
+	memset( padding, 0, kCacheLine );
+	strncpy( header.magic, kWeightFileMagic, 8 );
+	header.version = kWeightFileVersion;
+	header.valueSize = sizeof(data_type);
+	header.numBlocks = numBlocks;
+
+	// each block of weights starts at a cache line
+	offset = CALMArena::Aligned( sizeof(CALMWeightHeader) + numBlocks * sizeof(CALMWeightBlock) );
+	for ( i = 0; i < numBlocks; i++ )
+	{
+		blocks[i].offset = offset;
+		offset += CALMArena::Aligned( blocks[i].rows * blocks[i].cols * sizeof(data_type) );
+	}
+
+	outfile.write( (char*)&header, sizeof(CALMWeightHeader) );
+	outfile.write( (char*)blocks, numBlocks * sizeof(CALMWeightBlock) );
+	offset = sizeof(CALMWeightHeader) + numBlocks * sizeof(CALMWeightBlock);
+	for ( i = 0; i < numBlocks; i++ )
+	{
+		outfile.write( padding, blocks[i].offset - offset );
+		bytes = blocks[i].rows * blocks[i].cols * sizeof(data_type);
+		outfile.write( (char*)weights, bytes );
+		weights += blocks[i].rows * blocks[i].cols;
+		offset = blocks[i].offset + bytes;
+	}
+	outfile.close();
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)filename );
+		return false;
+	}
+	return true;
+}
+
+
+// Read the connections of a text weight file, as written by CALMNetwork::SaveWeights.
+// Only counts blocks and weights if "blocks" is NULL. Returns the number of
+// blocks or kUndefined if the file is not a proper weight file.
+static int ReadTextWeights( ifstream* infile, CALMWeightBlock* blocks, data_type* weights, size_t* numWeights )
+{
+	string		line;
+	char		toModule[32], fromModule[32];
+	char*		pos;
+	char*		end;
+	data_type	wt;
+	int			numBlocks = 0;
+	int			cols, i;
+
+	*numWeights = 0;
+	while ( getline( *infile, line ) )
+	{
+		pos = (char*)line.c_str();
+		while ( *pos == ' ' || *pos == '\t' || *pos == '\r' ) pos++;
+		// skip empty lines and DYNAGRAPH titles
+		if ( *pos == '\0' || *pos == 'S' || *pos == 'T' ) continue;
+
+		// a new connection starts with "# to <- from"
+		if ( *pos == '#' )
+		{
+			if ( sscanf( pos, "# %31s <- %31s", toModule, fromModule ) != 2 ) continue;
+			if ( blocks != NULL )
+			{
+				memset( blocks + numBlocks, 0, sizeof(CALMWeightBlock) );
+				strcpy( blocks[numBlocks].toModule, toModule );
+				strcpy( blocks[numBlocks].fromModule, fromModule );
+				// count previous connections to the same module
+				for ( i = 0; i < numBlocks; i++ )
+					if ( strcmp( blocks[i].toModule, toModule ) == 0 ) blocks[numBlocks].link++;
+			}
+			numBlocks++;
+			continue;
+		}
+		if ( numBlocks == 0 ) return kUndefined;
+
+		// a row of weights
+		cols = 0;
+		for ( ;; )
+		{
+			wt = strtof( pos, &end );
+			if ( end == pos ) break;
+			if ( weights != NULL ) weights[*numWeights+cols] = wt;
+			cols++;
+			pos = end;
+		}
+		if ( blocks != NULL )
+		{
+			if ( blocks[numBlocks-1].rows == 0 ) blocks[numBlocks-1].cols = cols;
+			if ( blocks[numBlocks-1].cols != cols ) return kUndefined;
+			blocks[numBlocks-1].rows++;
+		}
+		*numWeights += cols;
+	}
+	return numBlocks;
+}
+
+
+// Convert a text weight file to a binary one
+bool CALMWeightFile::TextToBinary( const char* textname, const char* binname )
+{
+	ifstream			infile;
+	CALMWeightBlock*	blocks;
+	data_type*			weights;
+	size_t				numWeights;
+	int					numBlocks;
+	bool				ok;
+
+	infile.open( textname );
+	if ( infile.fail() )
+	{
+		FileOpenError( (char*)textname );
+		return false;
+	}
+
+	// count the connections and weights first, then read them
+	numBlocks = ReadTextWeights( &infile, NULL, NULL, &numWeights );
+	if ( numBlocks < 0 )
+	{
+		cerr << "Error: " << textname << " is not a weight file" << endl;
+		return false;
+	}
+	blocks = new CALMWeightBlock[numBlocks+1];
+	weights = new data_type[numWeights+1];
+	infile.clear();
+	infile.seekg( 0 );
+	if ( ReadTextWeights( &infile, blocks, weights, &numWeights ) != numBlocks )
+	{
+		cerr << "Error: " << textname << " has rows of unequal length" << endl;
+		ok = false;
+	}
+	else
+		ok = Save( binname, numBlocks, blocks, weights );
+	infile.close();
+
+	delete[] blocks;
+	delete[] weights;
+	return ok;
+}
+
+
+// Convert a binary weight file to a text one. Weights are written with enough
+// digits to be read back exactly.
+bool CALMWeightFile::BinaryToText( const char* binname, const char* textname )
+{
+	CALMWeightFile		file;
+	CALMWeightBlock*	block;
+	const data_type*	weights;
+	ofstream			outfile;
+
+	if ( ! file.Open( binname ) ) return false;
+	outfile.open( textname );
+	if ( outfile.fail() )
+	{
+		FileCreateError( (char*)textname );
+		return false;
+	}
+	outfile.precision( numeric_limits<data_type>::max_digits10 );
+	for ( int k = 0; k < file.GetNumBlocks(); k++ )
+	{
+		block = file.GetBlock( k );
+		weights = file.GetWeights( block );
+		outfile << "# " << block->toModule << " <- " << block->fromModule << '\n';
+		for ( int i = 0; i < block->rows; i++ )
+		{
+			for ( int j = 0; j < block->cols; j++ )
+				outfile << weights[i*block->cols+j] << " ";
+			outfile << '\n';
+		}
+	}
+	outfile.close();
+	return ! outfile.fail();
+}
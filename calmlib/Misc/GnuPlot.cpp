@@ -3,111 +3,133 @@
 	Modifications by:	Adriaan Tijsseling (AGT)
 	Copyright: 			(c) Copyright 2003 MECHwA Team. All rights reserved.
 	Description:		online plotting routines using GNUPlot. Supports 3D plots.
-						NOTE: the GnuPlot program path and name must be adapted to your system!
+						gnuplot is looked up as $GNUPLOT, or else in the PATH.
 */
 
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "CALMTrace.h"
 #include "GnuPlot.h"
 #include	<iostream>
 
+#if defined(__APPLE__)
 #define USE_AQUA		1	// plot using AquaTerm if on Mac, if desired.
+#else
+#define USE_AQUA		0
+#endif
 
 using namespace std;
 
 extern double SafeAbs( double val );
 
 //  for 2d plots: displays dynamically updated graph
-GnuPlot::GnuPlot( int xr1, int xr2, int yr1, int yr2 )
+GnuPlot::GnuPlot( int xr1, int xr2, int yr1, int yr2, const char* name )
 {
 	mCounter = 0;
 	mBounds = xr2;
-	mMax = -1000000; 
+	mMax = -1000000;
 	mMin =  1000000;
-	
+	mXMin = xr1;
+	mXMax = xr2;
+	mYMin = yr1;
+	mYMax = yr2;
+
 // store a range of graph values
 	mBuffer = new double[mBounds];
-// not going to use a 3d plot
-	mMatrix = NULL;
-// open the pipe to the gnuplot program
-	mGnuPipe = popen( "/usr/local/bin/gnuplot --persist", "w" );
-#if USE_AQUA
-	fprintf(mGnuPipe, "set term aqua\n");
-#endif
-// indicate the initial range for the plot
-	fprintf( mGnuPipe, "set xrange [%d:%d]\n", xr1, xr2 ); 
-	fprintf( mGnuPipe, "set yrange [%d:%d]\n", yr1, yr2 );
+	mRows = 1;
+	mCols = 0;
+	mEvery = kPlotEvery2D;
+
+	strcpy( mName, name );
+// frames are as large as the buffer, so that plotting does not allocate
+	for ( int i = 0; i < kPlotFrames; i++ )
+	{
+		mFrames[i].data = new data_type[mBounds];
+		mFrames[i].capacity = mBounds;
+	}
+	mCalls = 0;
+	mDropped = 0;
+	mPending = NULL;
+	mFirst = 0;
+	mQueued = 0;
+	mQuit = false;
+	mPlotter = std::thread( &GnuPlot::run, this );
 }
 
 
 // for 3d matrix plots
-GnuPlot::GnuPlot( int r, int c )
+GnuPlot::GnuPlot( int r, int c, const char* name )
 {
 	mRows = r;
 	mCols = c;
 // not going to use the 2d plot
 	mBuffer = NULL;
-// allocate memory for matrix
-	mMatrix = new double*[ mRows ];
-	for ( int i = 0; i < mRows; i++ ) mMatrix[i] = new double[ mCols ];
-// open the pipe to the gnuplot program
-	mGnuPipe = popen( "/usr/local/bin/gnuplot --persist", "w" );
-#if USE_AQUA
-	fprintf(mGnuPipe, "set term aqua\n");
-#endif
-// set options for 3d plot
-	fprintf( mGnuPipe, "set hidden3d\n" );	
-	fprintf( mGnuPipe, "set zrange [0:1]\n" );
+	mEvery = 1;
+
+	strcpy( mName, name );
+	for ( int i = 0; i < kPlotFrames; i++ )
+	{
+		mFrames[i].data = new data_type[r*c];
+		mFrames[i].capacity = r*c;
+	}
+	mCalls = 0;
+	mDropped = 0;
+	mPending = NULL;
+	mFirst = 0;
+	mQueued = 0;
+	mQuit = false;
+	mPlotter = std::thread( &GnuPlot::run, this );
 }
 
 
+// frames still waiting are plotted first
 GnuPlot::~GnuPlot( )
 {
-	if ( mBuffer != NULL ) delete[] mBuffer;
-	if ( mMatrix != NULL )
 	{
-		for ( int i = 0; i < mRows; i++ ) delete[] mMatrix[i];
-		delete[] mMatrix;
+		std::lock_guard<std::mutex> lock( mLock );
+		mQuit = true;
 	}
-	pclose( mGnuPipe );
+	mSignal.notify_all();
+	mPlotter.join();
+	if ( mBuffer != NULL ) delete[] mBuffer;
+	for ( int i = 0; i < kPlotFrames; i++ )
+		if ( mFrames[i].data != NULL ) delete[] mFrames[i].data;
 }
 
 
 // only for 3d plot. Use it if the dimensions of the plot should be changed
 void GnuPlot::resizePlot( int r, int c )
 {
-	if ( mMatrix != NULL )
-	{
-		for ( int i = 0; i < mRows; i++ ) delete[] mMatrix[i];
-		delete[] mMatrix;
-	}
 	mRows = r;
 	mCols = c;
-	mMatrix = new double*[ mRows ];
-	for ( int i = 0; i < mRows; i++ ) mMatrix[i] = new double[ mCols ];
-	fprintf( mGnuPipe, "reset\n" );	
-	fprintf( mGnuPipe, "set hidden3d\n" );	
-	fprintf( mGnuPipe, "set zrange [0:1]\n" );
 }
 
 
 // plot a single value in a 2d plot
-void GnuPlot::plot( double val ) 
+void GnuPlot::plot( double val )
 {
-	int i;
-	
+	GnuPlotFrame*	frame;
+	int				i;
+
 // adjust vertical mBounds
 	if ( mMax < val ) mMax = val;
 	if ( mMin > val ) mMin = val;
 
-// pipe the new range to gnuplot, leaving space for top and bottom	
-	fprintf( mGnuPipe, "set yrange [%f:%f]\n", mMin-SafeAbs(mMin/10.0), mMax+SafeAbs(mMax/10.0) );
-
 // add the new value to the end of the buffer
 	mBuffer[mCounter] = val;
 
-	fprintf( mGnuPipe, "plot '-' with lines\n" );
-	for ( i = 0; i < mCounter+1; i++ ) fprintf( mGnuPipe, "%f\n", mBuffer[i] );
-	fprintf( mGnuPipe, "e\n" );
-	
+// plot the buffer, leaving space for top and bottom
+	frame = acquire( kPlotLines, 1, mCounter+1 );
+	if ( frame != NULL )
+	{
+		for ( i = 0; i < mCounter+1; i++ ) frame->data[i] = mBuffer[i];
+		frame->range = true;
+		frame->min = mMin-SafeAbs(mMin/10.0);
+		frame->max = mMax+SafeAbs(mMax/10.0);
+		submit();
+	}
+
 	if ( mCounter == mBounds-1 )
 	{
 	// move the array down and create space for the next plot value
@@ -127,50 +149,260 @@ void GnuPlot::plot( double val )
 	}
 	else
 		mCounter++;
-// make sure the plot is updated
-	fflush( mGnuPipe );
 }
 
 
 // plot a whole vector of values into a 2d graph
-void GnuPlot::plot( double *buf, int bufSize ) 
+void GnuPlot::plot( double *buf, int bufSize )
 {
-	fprintf( mGnuPipe, "plot '-' with lines\n" );	
-	for ( int i = 0; i < bufSize; i++ ) fprintf( mGnuPipe, "%f\n", buf[i] );
-	fprintf( mGnuPipe, "e\n" );
-	fflush( mGnuPipe );
+	GnuPlotFrame* frame = acquire( kPlotLines, 1, bufSize );
+
+	if ( frame == NULL ) return;
+	for ( int i = 0; i < bufSize; i++ ) frame->data[i] = buf[i];
+	submit();
 }
 
 
 // plot two value arrays into a 2d graph
 void GnuPlot::plot( double *buf1, double *buf2, int bufSize )
 {
-	fprintf( mGnuPipe, "plot '-' with lines, '-' with lines\n" );	
+	GnuPlotFrame* frame = acquire( kPlotLines, 2, bufSize );
 
-	for ( int i = 0; i < bufSize; i++ ) fprintf( mGnuPipe, "%f\n", buf1[i] );
-	fprintf( mGnuPipe, "e\n" );
+	if ( frame == NULL ) return;
+	for ( int i = 0; i < bufSize; i++ ) frame->data[i] = buf1[i];
+	for ( int i = 0; i < bufSize; i++ ) frame->data[bufSize+i] = buf2[i];
+	submit();
+}
 
-	for ( int i = 0; i < bufSize; i++ ) fprintf( mGnuPipe, "%f\n", buf2[i] );
-	fprintf( mGnuPipe, "e\n" );
 
-	fflush( mGnuPipe );
+// matrix to fill for the next 3D plot
+data_type* GnuPlot::getFrame( void )
+{
+	GnuPlotFrame* frame = acquire( kPlotMatrix, mRows, mCols );
+
+	return ( frame != NULL ) ? frame->data : NULL;
+}
+
+
+// plot a 3D display of the matrix filled after getFrame
+void GnuPlot::plot( void )
+{
+	submit();
 }
 
 
-// plot a 3D display of matrix values
-void GnuPlot::plot( void ) 
+// Returns a free frame for the plot, or NULL if this call is skipped
+// or all frames are still waiting for the plotting thread
+GnuPlotFrame* GnuPlot::acquire( int kind, int rows, int cols )
 {
-	fprintf( mGnuPipe, "splot '-' matrix notitle with lines\n" );
-	for ( int i = 0; i < mRows; i++ )
+	GnuPlotFrame* frame;
+
+	mPending = NULL;
+	if ( ++mCalls < mEvery ) return NULL;
+	mCalls = 0;
 	{
-		for ( int j = 0; j < mCols; j++ ) {
-			fprintf( mGnuPipe, "%f ", mMatrix[i][j] );
+		std::lock_guard<std::mutex> lock( mLock );
+		if ( mQueued == kPlotFrames )
+		{
+			mDropped++;
+			return NULL;
 		}
-		fprintf( mGnuPipe, "\n" );
+		frame = &mFrames[( mFirst + mQueued ) % kPlotFrames];
+	}
+	// the plotting thread does not use frames that are not queued
+	if ( frame->capacity < rows * cols )
+	{
+		if ( frame->data != NULL ) delete[] frame->data;
+		frame->capacity = rows * cols;
+		frame->data = new data_type[frame->capacity];
 	}
-	fprintf( mGnuPipe, "e\n" );
-	fprintf( mGnuPipe, "e\n" );
+	frame->kind = kind;
+	frame->rows = rows;
+	frame->cols = cols;
+	frame->range = false;
+	mPending = frame;
+	return frame;
+}
+
+
+// pass the acquired frame to the plotting thread
+void GnuPlot::submit( void )
+{
+	if ( mPending == NULL ) return;
+	{
+		std::lock_guard<std::mutex> lock( mLock );
+		mQueued++;
+	}
+	mPending = NULL;
+	mSignal.notify_all();
+}
+
+
+// body of the plotting thread
+void GnuPlot::run( void )
+{
+	GnuPlotFrame*	frame;
+	sigset_t		signals;
+
+// a gnuplot that quits should not end the simulation
+	sigemptyset( &signals );
+	sigaddset( &signals, SIGPIPE );
+	pthread_sigmask( SIG_BLOCK, &signals, NULL );
+	TRACE_THREAD( "gnuplot" );
+	openPipe();
+
+	for ( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> lock( mLock );
+			mSignal.wait( lock, [this]{ return mQuit || mQueued > 0; } );
+			if ( mQueued == 0 ) break;
+			frame = &mFrames[mFirst];
+		}
+		{
+			TRACE_SCOPE( "plot", kUndefined );
+			if ( mGnuPipe != NULL )
+				draw( frame );
+			else
+				save( frame );
+		}
+		{
+			std::lock_guard<std::mutex> lock( mLock );
+			mFirst = ( mFirst + 1 ) % kPlotFrames;
+			mQueued--;
+		}
+	}
+	if ( mGnuPipe != NULL ) pclose( mGnuPipe );
+}
+
+
+// open the pipe to the gnuplot program
+void GnuPlot::openPipe( void )
+{
+	char		program[FILENAME_MAX];
+	char		command[FILENAME_MAX+16];
+	const char*	path = getenv( "GNUPLOT" );
+	const char*	dir;
+	const char*	end;
+
+	mGnuPipe = NULL;
+	mDrawnRows = 0;
+	mDrawnCols = 0;
+	program[0] = '\0';
+	if ( path != NULL )
+		strcpy( program, path );
+	else if ( ( dir = getenv( "PATH" ) ) != NULL )
+	{
+		for ( ; *dir != '\0'; dir = ( *end == ':' ) ? end + 1 : end )
+		{
+			end = strchr( dir, ':' );
+			if ( end == NULL ) end = dir + strlen( dir );
+			snprintf( program, FILENAME_MAX, "%.*s/gnuplot", (int)( end - dir ), dir );
+			if ( access( program, X_OK ) == 0 ) break;
+			program[0] = '\0';
+		}
+	}
+	if ( program[0] != '\0' && access( program, X_OK ) == 0 )
+	{
+		snprintf( command, FILENAME_MAX+16, "%s --persist", program );
+		mGnuPipe = popen( command, "w" );
+	}
+	if ( mGnuPipe == NULL )
+	{
+		cerr << "gnuplot not found, plots are written to " << mName << ".dat" << endl;
+		return;
+	}
+#if USE_AQUA
+	fprintf(mGnuPipe, "set term aqua\n");
+#endif
+	if ( mBuffer != NULL )
+	{
+	// indicate the initial range for the plot
+		fprintf( mGnuPipe, "set xrange [%d:%d]\n", mXMin, mXMax );
+		fprintf( mGnuPipe, "set yrange [%d:%d]\n", mYMin, mYMax );
+	}
+	else
+	{
+	// set options for 3d plot
+		fprintf( mGnuPipe, "set hidden3d\n" );
+		fprintf( mGnuPipe, "set zrange [0:1]\n" );
+	}
+}
+
+
+void GnuPlot::draw( GnuPlotFrame* frame )
+{
+	int i, j;
+
+	if ( frame->kind == kPlotMatrix )
+	{
+		if ( mDrawnRows != 0 && ( mDrawnRows != frame->rows || mDrawnCols != frame->cols ) )
+		{
+			fprintf( mGnuPipe, "reset\n" );
+			fprintf( mGnuPipe, "set hidden3d\n" );
+			fprintf( mGnuPipe, "set zrange [0:1]\n" );
+		}
+		mDrawnRows = frame->rows;
+		mDrawnCols = frame->cols;
+		fprintf( mGnuPipe, "splot '-' matrix notitle with lines\n" );
+		for ( i = 0; i < frame->rows; i++ )
+		{
+			for ( j = 0; j < frame->cols; j++ ) {
+				fprintf( mGnuPipe, "%f ", frame->data[i*frame->cols+j] );
+			}
+			fprintf( mGnuPipe, "\n" );
+		}
+		fprintf( mGnuPipe, "e\n" );
+		fprintf( mGnuPipe, "e\n" );
+	}
+	else
+	{
+		if ( frame->range ) fprintf( mGnuPipe, "set yrange [%f:%f]\n", frame->min, frame->max );
+		fprintf( mGnuPipe, ( frame->rows == 1 ) ? "plot '-' with lines\n" : "plot '-' with lines, '-' with lines\n" );
+		for ( i = 0; i < frame->rows; i++ )
+		{
+			for ( j = 0; j < frame->cols; j++ ) fprintf( mGnuPipe, "%f\n", frame->data[i*frame->cols+j] );
+			fprintf( mGnuPipe, "e\n" );
+		}
+	}
+// make sure the plot is updated
 	fflush( mGnuPipe );
+
+	if ( ferror( mGnuPipe ) )
+	{
+		pclose( mGnuPipe );
+		mGnuPipe = NULL;
+		cerr << "gnuplot quit, plots are written to " << mName << ".dat" << endl;
+		save( frame );
+	}
 }
 
 
+// without gnuplot, the data file always holds the latest frame
+void GnuPlot::save( GnuPlotFrame* frame )
+{
+	char	filename[FILENAME_MAX];
+	FILE*	file;
+	int		i, j;
+
+	snprintf( filename, FILENAME_MAX, "%s.dat", mName );
+	file = fopen( filename, "w" );
+	if ( file == NULL ) return;
+	if ( frame->kind == kPlotMatrix )
+	{
+		for ( i = 0; i < frame->rows; i++ )
+		{
+			for ( j = 0; j < frame->cols; j++ ) fprintf( file, "%f ", frame->data[i*frame->cols+j] );
+			fprintf( file, "\n" );
+		}
+	}
+	else
+	{
+		for ( j = 0; j < frame->cols; j++ )
+		{
+			for ( i = 0; i < frame->rows; i++ ) fprintf( file, "%f ", frame->data[i*frame->cols+j] );
+			fprintf( file, "\n" );
+		}
+	}
+	fclose( file );
+}
@@ -44,17 +44,25 @@
 #include "Rnd.h"
 
 
-// drand48 and srand48 are not defined on MacOS
-#if !defined drand48
-	#define drand48()	( (float)rand() )/( (float)RAND_MAX )
-	#define srand48(x)	srand(x)
-#endif
+// SetSeed used to draw from the C library's rand(), which is now IntegerRNG
+#define drand48()	( (float)IntegerRNG() )/( (float)kIntegerRNGMax )
+#define srand48(x)	SeedIntegerRNG(x)
 
-#define Randomize()  srand((int)time(NULL))
+#define Randomize()  SeedIntegerRNG((int)time(NULL))
 
 int		s = 0;
 int		seed1 = 1, seed2 = 1, seed3 = 1;
 
+// Additive feedback generator r[i] = r[i-3] + r[i-31], the same as random() 
+// and rand() of the GNU C library, so that permutations are as before. Unlike
+// rand(), its state can be saved and restored.
+#define kIntegerRNGDegree	31
+#define kIntegerRNGSep		3
+
+int		rtable[kIntegerRNGDegree];
+int		rfront = kIntegerRNGSep, rrear = 0;
+bool	rseeded = false;
+
 void	SetSeed( int );
 
 // returns a random float in the range [-l,h].
@@ -77,6 +85,44 @@ float PseudoRNG( float low, float high )
 }
 
 
+// returns a random integer in the range [0,kIntegerRNGMax]
+int IntegerRNG( void )
+{
+	unsigned int val;
+	
+	if ( ! rseeded ) SeedIntegerRNG( 1 );
+	val = (unsigned int)rtable[rfront] + (unsigned int)rtable[rrear];
+	rtable[rfront] = (int)val;
+	if ( ++rfront >= kIntegerRNGDegree ) rfront = 0;
+	if ( ++rrear >= kIntegerRNGDegree ) rrear = 0;
+	return (int)( val >> 1 );
+}
+
+
+void SeedIntegerRNG( unsigned int seed )
+{
+	long	hi, lo;
+	int		word;
+	
+	if ( seed == 0 ) seed = 1;
+	rtable[0] = seed;
+	word = seed;
+	for ( int i = 1; i < kIntegerRNGDegree; i++ )
+	{
+		// 16807 * word % 2147483647 without overflow
+		hi = word / 127773;
+		lo = word % 127773;
+		word = 16807 * lo - 2836 * hi;
+		if ( word < 0 ) word += 2147483647;
+		rtable[i] = word;
+	}
+	rfront = kIntegerRNGSep;
+	rrear = 0;
+	rseeded = true;
+	for ( int i = 0; i < 10 * kIntegerRNGDegree; i++ ) IntegerRNG();
+}
+
+
 // returns a random double in the range [-x,x].
 float PseudoRNG( float range )
 {
@@ -136,6 +182,33 @@ long GetSeed( void )
 }
 
 
+/* The complete state of both generators: the three seeds, followed by the
+ * table and positions of the integer generator, so that a sequence of random
+ * numbers can be repeated from any point. Takes kRandomStateSize ints. */
+void GetRandomState( int* state )
+{
+	if ( ! rseeded ) SeedIntegerRNG( 1 );
+	state[0] = seed1;
+	state[1] = seed2;
+	state[2] = seed3;
+	for ( int i = 0; i < kIntegerRNGDegree; i++ ) state[3+i] = rtable[i];
+	state[3+kIntegerRNGDegree] = rfront;
+	state[4+kIntegerRNGDegree] = rrear;
+}
+
+
+void SetRandomState( int* state )
+{
+	seed1 = state[0];
+	seed2 = state[1];
+	seed3 = state[2];
+	for ( int i = 0; i < kIntegerRNGDegree; i++ ) rtable[i] = state[3+i];
+	rfront = state[3+kIntegerRNGDegree];
+	rrear = state[4+kIntegerRNGDegree];
+	rseeded = true;
+}
+
+
 /* This function allows the user to set the 32 bits of the internal seed.
  * The seed is used for the initialization of seed1, seed2, & seed3, to
  * be used by frand().  [RAND_MAX = 65536] */
@@ -8,6 +8,7 @@
 #include	<stdlib.h>
 #include	"CALMGlobal.h"
 #include	"Utilities.h"
+#include	"Rnd.h"
 
 long	gPrecision;
 long	gWidth;
@@ -29,7 +30,7 @@ void Permute( int* array, size_t size )
 	t = new tmp[size];
 	for( i = 0; i < size; i++ ) 	// load up struct with data
 	{
-		t[i].r = rand();
+		t[i].r = IntegerRNG();
 		t[i].p = array[i];
 	}	
 	qsort( t, size, sizeof(struct tmp), cmp );	// shuffle
@@ -10,18 +10,22 @@
 #include "Feedback.h"
 #include "Rnd.h"
 
-// Free the weight matrix
-Connection::~Connection()
+// Allocate a weight matrix in the arena. All rows are stored in one block,
+// so that the whole matrix can be copied at once
+CALMWeight** Connection::NewWeights( int rows, int cols )
 {
-	for ( int i = 0; i < *mToSize; i++ ) delete[] mWeights[i];
-	delete[] mWeights;
-	delete[] mWtAct;
-}
+	CALMWeight**	wts = mArena->New<CALMWeight*>( rows, kMemWeights );
+	CALMWeight*		data = mArena->New<CALMWeight>( rows * cols, kMemWeights );
 	
+	for ( int i = 0; i < rows; i++ ) wts[i] = data + i * cols;
+	return wts;
+}
+
 
 // Make pointer members point to relevant addresses and allocate weights
-void Connection::Initialize( Module* inModule, int* toSize, int linkType, int delay, data_type* pars )
+void Connection::Initialize( Module* inModule, int* toSize, int linkType, int delay, data_type* pars, CALMArena* arena )
 {
+	mArena = arena;
 	mToSize = toSize;
 	mInModule = inModule;
 	mType = linkType;
@@ -45,123 +49,170 @@ void Connection::Initialize( Module* inModule, int* toSize, int linkType, int de
 	}
 
 	mTime = 0;			// "internal clock"
+	mRows = *mToSize;
+	mStride = Stride( mInModule->GetModuleSize() );
 	// local copy of previous calculated weighted activation
-	mWtAct = new data_type[*mToSize];
+	mWtAct = mArena->New<data_type>( mRows, kMemWtAct );
 	for ( int i = 0; i < *mToSize; i++ ) mWtAct[i] = 0.0;
 	
 	// allocate memory for weights
-	mWeights = new CALMWeight*[ *mToSize ];
+	mWeights = NewWeights( mRows, mStride );
 	for ( int i = 0; i < *mToSize; i++ )
-	{
-		mWeights[i] = new CALMWeight[ mInModule->GetModuleSize() ];
 		for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
 			mWeights[i][j].Reset( mParameters[INITWT] );
-	}
 }
 
 
+// Make this connection a copy of another one, but link it to the given modules
+void Connection::Copy( Connection& source, Module* inModule, int* toSize, data_type* pars, CALMArena* arena )
+{
+	mArena = arena;
+	mToSize = toSize;
+	mInModule = inModule;
+	mParameters = pars;
+	mType = source.mType;
+	mDelay = source.mDelay;
+	mTime = source.mTime;
+	mWeightedAct = source.mWeightedAct;
+	mInAct = source.mInAct;
+	mUpdate = source.mUpdate;
+
+	mRows = source.mRows;
+	mStride = source.mStride;
+
+	mWtAct = mArena->New<data_type>( mRows, kMemWtAct );
+	memcpy( mWtAct, source.mWtAct, mRows * sizeof(data_type) );
+
+	mWeights = NewWeights( mRows, mStride );
+	if ( mRows > 0 )
+		memcpy( mWeights[0], source.mWeights[0], mRows * mStride * sizeof(CALMWeight) );
+}
+
+
+// Make room for at least "rows" by "cols" weights, keeping the current values.
+// Spare rows and columns grow geometrically, so resizing a module only 
+// reallocates now and then.
+void Connection::Reserve( int rows, int cols )
+{
+	CALMWeight**	oldWts = mWeights;
+	data_type*		oldAct = mWtAct;
+	int				oldRows = mRows;
+	int				oldStride = mStride;
+	
+	if ( rows <= mRows && cols <= mStride ) return;
+	
+	if ( rows > mRows ) mRows = ( rows > 2 * mRows ) ? rows : 2 * mRows;
+	if ( cols > mStride ) mStride = Stride( ( cols > 2 * mStride ) ? cols : 2 * mStride );
+	
+	CALMMemory::Reallocated( kMemWeights );
+	CALMMemory::Reallocated( kMemWtAct );
+	mWtAct = mArena->New<data_type>( mRows, kMemWtAct );
+	memcpy( mWtAct, oldAct, oldRows * sizeof(data_type) );
+	mWeights = NewWeights( mRows, mStride );
+	for ( int i = 0; i < oldRows; i++ )
+		memcpy( mWeights[i], oldWts[i], oldStride * sizeof(CALMWeight) );
+}
+
+
+// add the weights and stored activations to "bytes", by category of CALMMemory
+void Connection::CountMemory( size_t* bytes )
+{
+	bytes[kMemWeights] += CALMArena::Aligned( mRows * sizeof(CALMWeight*) );
+	bytes[kMemWeights] += CALMArena::Aligned( (size_t)mRows * mStride * sizeof(CALMWeight) );
+	bytes[kMemWtAct] += CALMArena::Aligned( mRows * sizeof(data_type) );
+}
+
+
+// Make room for the weights after the sending and/or receiving module changed 
+// size. Used when restoring a snapshot, which holds all weights.
+void Connection::Reshape( void )
+{
+	Reserve( *mToSize, mInModule->GetModuleSize() );
+}
+
+
+// append clock, stored activations and weights to a snapshot
+void Connection::Snapshot( CALMSnapshot* s )
+{
+	s->Put( &mTime, sizeof(int) );
+	s->Put( mWtAct, *mToSize * sizeof(data_type) );
+	for ( int i = 0; i < *mToSize; i++ )
+		s->Put( mWeights[i], mInModule->GetModuleSize() * sizeof(CALMWeight) );
+}
+
+
+// read back the state of the connection, in the same order as written
+void Connection::Restore( CALMSnapshot* s )
+{
+	s->Get( &mTime, sizeof(int) );
+	s->Get( mWtAct, *mToSize * sizeof(data_type) );
+	for ( int i = 0; i < *mToSize; i++ )
+		s->Get( mWeights[i], mInModule->GetModuleSize() * sizeof(CALMWeight) );
+}
+
+
+// bytes that Snapshot writes if the sending and receiving modules have the given sizes
+size_t Connection::SnapshotSize( int fromSize, int toSize )
+{
+	return sizeof(int) + toSize * sizeof(data_type) + (size_t)toSize * fromSize * sizeof(CALMWeight);
+}
+
+
+// Adjust the weight matrix after the sending (kFrom) or receiving (kTo) module
+// changed size. Pruning closes the gap left by the deleted node in place and 
+// growing only reallocates once the reserved rows or columns run out.
 void Connection::ResizeConnection( int fromsize, int tosize, int node, int direction )
 {
-	data_type		wtavg = 0.0;
-	CALMWeight**	newWts;
+	int		rows = *mToSize;
+	int		cols = mInModule->GetModuleSize();
+	int		i, j;
 	
-	// we need to resize the mWtAct array and the weight matrix
-	// for the mWtAct array, we just delete and new. No need to copy data.
-	delete[] mWtAct;
-	mWtAct = new data_type[tosize];
-	for ( int i = 0; i < tosize; i++ ) mWtAct[i] = 0.0;
-
-	// weights have to be copied over
-	// we are going to set the new weights to the average of the old weights
-	// get this average... 
-	// but this is unnecessary if we are downsizing:
-	if ( node == kUndefined )
+	if ( node > kUndefined ) 
+		// we're downsizing, so drop the weights from the deleted node
 	{
+		if ( direction == kTo ) // we need to know which layer the node is from
+		{
+			for ( i = node; i < rows - 1; i++ )
+				memcpy( mWeights[i], mWeights[i+1], cols * sizeof(CALMWeight) );
+		}
+		else
+		{
+			for ( i = 0; i < rows; i++ )
+				memmove( &mWeights[i][node], &mWeights[i][node+1], ( cols - node - 1 ) * sizeof(CALMWeight) );
+		}
+	}
+	else
+	{
+		// new weights are set to random values within the range of the old weights
 		data_type	curWt;
 		data_type	minWt = 1000000;
 		data_type	maxWt = -1000000;
 				
-		for ( int i = 0; i < *mToSize; i++ )
-			for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
+		for ( i = 0; i < rows; i++ )
+			for ( j = 0; j < cols; j++ )
 			{
 				curWt = mWeights[i][j].GetWeight();
-				wtavg += curWt;
 				if ( curWt < minWt ) minWt = curWt;
 				if ( curWt > maxWt ) maxWt = curWt;
 			}
-		wtavg = wtavg / ( (*mToSize) * mInModule->GetModuleSize() );
 
-		// first initialize a new matrix and reset to default
-		newWts = new CALMWeight*[ tosize ];
-		for ( int i = 0; i < tosize; i++ )
+		Reserve( tosize, fromsize );
+		
+		// a value is drawn for every weight, as if the whole matrix were new, so 
+		// the random sequence does not depend on the reserved room. Only weights
+		// outside the old matrix take the new value.
+		for ( i = 0; i < tosize; i++ )
 		{
-			newWts[i] = new CALMWeight[ fromsize ];
-			for ( int j = 0; j < fromsize; j++ )
+			for ( j = 0; j < fromsize; j++ )
 			{
 				curWt = PseudoRNG( minWt, maxWt );
-				newWts[i][j].Reset( curWt );
-			}
-		}
-	}
-	else
-	{	
-		// first initialize a new matrix and reset to default
-		newWts = new CALMWeight*[ tosize ];
-		for ( int i = 0; i < tosize; i++ )
-		{
-			newWts[i] = new CALMWeight[ fromsize ];
-			for ( int j = 0; j < fromsize; j++ )
-				newWts[i][j].Reset( 0.0 );
-		}
-	}
-	
-	// copy over the old weights
-	if ( node > kUndefined ) 
-		// we're downsizing, so don't copy the weights from the deleted node
-	{
-		int k = 0;
-		if ( direction == kTo ) // we need to know which layer the node is from
-		{
-			for ( int i = 0; i < *mToSize; i++ )
-			{
-				if ( i != node )
-				{
-					for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
-						newWts[k][j] = mWeights[i][j];
-					k++;
-				}
+				if ( i >= rows || j >= cols ) mWeights[i][j].Reset( curWt );
 			}
 		}
-		else
-		{
-			for ( int i = 0; i < *mToSize; i++ )
-			{
-				k = 0;
-				for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
-				{
-					if ( j != node )
-					{
-						newWts[i][k] = mWeights[i][j];
-						k++;
-					}
-				}
-			}
-		}		
-	}
-	else
-	{
-		int wlim = ( ( tosize > *mToSize ) ? *mToSize : tosize );
-		int hlim = ( ( fromsize > mInModule->GetModuleSize() ) ? mInModule->GetModuleSize() : fromsize );
-		
-		for ( int i = 0; i < wlim; i++ )
-			for ( int j = 0; j < hlim; j++ )
-				newWts[i][j] = mWeights[i][j];
 	}
 	
-	// make the old pointer point to the new data, after deleting old data first
-	for ( int i = 0; i < *mToSize; i++ ) delete[] mWeights[i];
-	delete[] mWeights;
-	mWeights = newWts;
+	// no need to keep the stored weighted activations
+	for ( i = 0; i < tosize; i++ ) mWtAct[i] = 0.0;
 }
 
 
@@ -275,6 +326,24 @@ void Connection::CopyWeights( double** matrix )
 }
 
 
+// copy weights to a pre-allocated array, row after row
+void Connection::CopyWeights( data_type* values )
+{
+	for ( int i = 0; i < *mToSize; i++ )
+		for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
+			*values++ = GetWeight(i,j);
+}
+
+
+// set weights from an array holding one row after the other
+void Connection::SetWeights( const data_type* values )
+{
+	for ( int i = 0; i < *mToSize; i++ )
+		for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
+			mWeights[i][j].SetWeight( *values++ );
+}
+
+
 // return sum of weight changes stored in every CALMWeight instance
 void Connection::SumWeightChanges( data_type &dw_sum )
 {
@@ -299,31 +368,18 @@ void Connection::SaveWeights( ofstream *outfile )
 
 
 // Write out weight values to an output stream
-void Connection::LoadWeights( ifstream *infile )
+void Connection::LoadWeights( CALMTokenizer *infile )
 {
 	data_type 	wt;
-	bool		garbage = true;
-	char		c;
 	
-	// we have to strip the headers first
-	while ( garbage )
-	{
-		// ignore any line feeds left in the stream
-		while ( infile->peek() == '\n' || infile->peek() == ' ' || infile->peek() == '\t' ) infile->get();	
-		while ( infile->peek() == '#' || infile->peek() == 'S' || infile->peek() == 'T' ) infile->ignore( 1000, '\n' );
-		infile->get(c);
-		if ( c == '\n' || c == '\t' || c == ' ' || c == '#' || c == 'S' || c == 'T' )
-			garbage = true;
-		else
-			garbage = false;
-		infile->putback(c);
-	}
+	// we have to strip the headers first, including DYNAGRAPH titles
+	infile->SkipLines( "#ST" );
 		
 	for ( int i = 0; i < *mToSize; i++ )
 	{
 		for ( int j = 0; j < mInModule->GetModuleSize(); j++ )
 		{
-			*infile >> wt;
+			infile->Read( wt );
 			mWeights[i][j].SetWeight( wt );
 		}
 	}
@@ -345,6 +401,21 @@ void Connection::Print( ostream *os )
 }
 
 
+// print weights copied with CopyWeights, the same way as Print
+void Connection::PrintWeights( ostream* os, const char* name, int rows, int cols, const data_type* values )
+{
+	*os << name << endl;
+	AdjustStream( *os, 3, 6, kLeft, true );
+	for ( int i = 0; i < rows; i++ )
+	{
+		for ( int j = 0; j < cols; j++ )
+			*os << *values++ << "\t";
+		*os << endl;
+	}
+	SetStreamDefaults( *os );
+}
+
+
 // overload the << operator
 ostream &operator<<( ostream &os, Connection &c )
 {
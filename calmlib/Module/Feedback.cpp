@@ -11,14 +11,38 @@
 
 // Initialize the basic members of a module
 // Derived classes need to call this function before doing own Initialization routine
-void Feedback::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx )
+void Feedback::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena )
 {
-	Module::Initialize( moduleSize, moduleName, pars, mtype, idx );
+	Module::Initialize( moduleSize, moduleName, pars, mtype, idx, arena );
 	// create the map weights matrix
 	mFeedback = 0;
 }
 
 
+// Create a copy of this module, including the current feedback signal
+Module* Feedback::Clone( data_type* pars, CALMArena* arena )
+{
+	Feedback* module = arena->New<Feedback>( 1, kMemModules );
+	module->CopyModule( this, pars, arena );
+	module->mFeedback = mFeedback;
+	return module;
+}
+
+
+// The feedback signal is part of the state of the module
+void Feedback::Snapshot( CALMSnapshot* s )
+{
+	Module::Snapshot( s );
+	s->Put( &mFeedback, sizeof(int) );
+}
+
+void Feedback::Restore( CALMSnapshot* s )
+{
+	Module::Restore( s );
+	s->Get( &mFeedback, sizeof(int) );
+}
+
+
 // Update activations in the module
 void Feedback::UpdateActivation( void )
 {
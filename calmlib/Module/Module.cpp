@@ -11,33 +11,24 @@
 #include "Connection.h"
 
 
-Module::~Module()
-{
-	// Clean up the R and V arrays
-	if ( mModuleSize != 0 )
-	{
-		delete[] mR;
-		delete[] mV;
-	}
-	if ( mNumInConn != 0 ) delete[] mInConn;
-}
-
-
 // Initialize the basic members of a module
 // Derived classes need to call this function before doing own Initialization routine
-void Module::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx )
+void Module::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena )
 {
+	mArena = arena;
 	mModuleIndex = idx;
 	mModuleSize = moduleSize;
+	mCapacity = moduleSize;
 	strcpy( mModuleName, moduleName );
 	mParameters = pars;
 	mModuleType = mtype;
 	
 	// Initialize R and V layers
-	mR = new RUnit[mModuleSize];
-	mV = new VUnit[mModuleSize];
+	mR = mArena->New<RUnit>( mCapacity, kMemNodes );
+	mV = mArena->New<VUnit>( mCapacity, kMemNodes );
+	mActs = mArena->New<data_type>( 2 * mCapacity + 2, kMemNodes );
 	
-	for ( int i = 0; i < mModuleSize; i++ )
+	for ( int i = 0; i < mCapacity; i++ )
 	{
 		mR[i].SetParameter( mParameters );
 		mV[i].SetParameter( mParameters );
@@ -52,14 +43,183 @@ void Module::SetNumConn( int numInConn )
 {
 	mNumInConn = numInConn;
 	// Initialize array of incoming connections
-	if ( mNumInConn != 0 ) mInConn = new Connection[mNumInConn];
+	if ( mNumInConn != 0 ) mInConn = mArena->New<Connection>( mNumInConn, kMemModules );
 }
 
 
 // Set one connection
 void Module::Connect( int idx, Module* fromModule, int link, int delay )
 {
-	mInConn[idx].Initialize( fromModule, &mModuleSize, link, delay, mParameters );
+	mInConn[idx].Initialize( fromModule, &mModuleSize, link, delay, mParameters, mArena );
+}
+
+
+// Create a copy of this module, including the activations of all its nodes.
+// Incoming connections are copied separately with CopyConnections, since
+// they need to refer to the copies of the sending modules
+Module* Module::Clone( data_type* pars, CALMArena* arena )
+{
+	Module* module = arena->New<Module>( 1, kMemModules );
+	module->CopyModule( this, pars, arena );
+	return module;
+}
+
+
+// Copy the basic members and node states of another module
+// Derived classes need to call this function before copying their own data
+void Module::CopyModule( Module* source, data_type* pars, CALMArena* arena )
+{
+	mArena = arena;
+	mModuleIndex = source->mModuleIndex;
+	mModuleType = source->mModuleType;
+	strcpy( mModuleName, source->mModuleName );
+	mModuleSize = source->mModuleSize;
+	mCapacity = source->mCapacity;
+	mWinner = source->mWinner;
+	mConvTime = source->mConvTime;
+	mMu = source->mMu;
+	mParameters = pars;
+
+	mR = mArena->New<RUnit>( mCapacity, kMemNodes );
+	mV = mArena->New<VUnit>( mCapacity, kMemNodes );
+	mActs = mArena->New<data_type>( 2 * mCapacity + 2, kMemNodes );
+	for ( int i = 0; i < mCapacity; i++ )
+	{
+		if ( i < mModuleSize )
+		{
+			mR[i] = source->mR[i];
+			mV[i] = source->mV[i];
+		}
+		mR[i].SetParameter( mParameters );
+		mV[i].SetParameter( mParameters );
+	}
+	mA = source->mA;
+	mE = source->mE;
+	mA.SetParameter( mParameters );
+	mE.SetParameter( mParameters );
+}
+
+
+// Copy the incoming connections of another module. "modules" holds the 
+// already copied modules of the network, so that connections are relinked
+void Module::CopyConnections( Module* source, Module** modules )
+{
+	SetNumConn( source->mNumInConn );
+	for ( int k = 0; k < mNumInConn; k++ )
+		mInConn[k].Copy( source->mInConn[k], modules[source->mInConn[k].GetModuleIndex()],
+						 &mModuleSize, mParameters, mArena );
+}
+
+
+// Append the state of the module, its nodes and incoming connections to a snapshot
+void Module::Snapshot( CALMSnapshot* s )
+{
+	int i;
+	
+	s->Put( &mWinner, sizeof(int) );
+	s->Put( &mConvTime, sizeof(int) );
+	s->Put( &mMu, sizeof(data_type) );
+	for ( i = 0; i < mModuleSize; i++ ) mR[i].Snapshot( s );
+	for ( i = 0; i < mModuleSize; i++ ) mV[i].Snapshot( s );
+	mA.Snapshot( s );
+	mE.Snapshot( s );
+	for ( i = 0; i < mNumInConn; i++ ) mInConn[i].Snapshot( s );
+}
+
+
+// Read back the state of the module, in the same order as written
+void Module::Restore( CALMSnapshot* s )
+{
+	int i;
+	
+	s->Get( &mWinner, sizeof(int) );
+	s->Get( &mConvTime, sizeof(int) );
+	s->Get( &mMu, sizeof(data_type) );
+	for ( i = 0; i < mModuleSize; i++ ) mR[i].Restore( s );
+	for ( i = 0; i < mModuleSize; i++ ) mV[i].Restore( s );
+	mA.Restore( s );
+	mE.Restore( s );
+	for ( i = 0; i < mNumInConn; i++ ) mInConn[i].Restore( s );
+}
+
+
+// "sizes" holds the size of every module of the network, by index
+size_t Module::SnapshotSize( const int* sizes )
+{
+	int		size = sizes[mModuleIndex];
+	size_t	bytes = 2 * sizeof(int) + sizeof(data_type);
+	
+	bytes += size * ( RUnit::SnapshotSize() + VUnit::SnapshotSize() ) + 2 * CALMUnit::SnapshotSize();
+	for ( int k = 0; k < mNumInConn; k++ )
+		bytes += mInConn[k].SnapshotSize( sizes[mInConn[k].GetModuleIndex()], size );
+	return bytes;
+}
+
+
+// Make room for at least "size" nodes, keeping the current node data. Spare 
+// capacity grows geometrically, so a growing module only reallocates now and then.
+void Module::Reserve( int size )
+{
+	RUnit*	oldR = mR;
+	VUnit*	oldV = mV;
+	int		i;
+	
+	if ( size <= mCapacity ) return;
+	
+	mCapacity = ( size > 2 * mCapacity ) ? size : 2 * mCapacity;
+	CALMMemory::Reallocated( kMemNodes );
+	mR = mArena->New<RUnit>( mCapacity, kMemNodes );
+	mV = mArena->New<VUnit>( mCapacity, kMemNodes );
+	mActs = mArena->New<data_type>( 2 * mCapacity + 2, kMemNodes );
+	for ( i = 0; i < mModuleSize; i++ )
+	{
+		mR[i] = oldR[i];
+		mV[i] = oldV[i];
+	}
+	for ( i = 0; i < mCapacity; i++ )
+	{
+		mR[i].SetParameter( mParameters );
+		mV[i].SetParameter( mParameters );
+	}
+}
+
+
+void Module::CountMemory( size_t* bytes )
+{
+	CountMemory( bytes, sizeof(Module) );
+}
+
+
+// "objectSize" is the size of the derived class
+void Module::CountMemory( size_t* bytes, size_t objectSize )
+{
+	bytes[kMemModules] += CALMArena::Aligned( objectSize ) + CALMArena::Aligned( mNumInConn * sizeof(Connection) );
+	bytes[kMemNodes] += CALMArena::Aligned( mCapacity * sizeof(RUnit) ) + CALMArena::Aligned( mCapacity * sizeof(VUnit) );
+	bytes[kMemNodes] += CALMArena::Aligned( ( 2 * mCapacity + 2 ) * sizeof(data_type) );
+	for ( int k = 0; k < mNumInConn; k++ ) mInConn[k].CountMemory( bytes );
+}
+
+
+// Change the number of nodes. Node data is restored from a snapshot afterwards.
+// Incoming connections still have their old size and need to be adjusted 
+// with ReshapeConnections.
+void Module::Reshape( int newsize )
+{
+	Reserve( newsize );
+	mModuleSize = newsize;
+}
+
+
+// Reallocate incoming connections after this module or any sending module was
+// reshaped. "oldSizes" holds the sizes of all modules before reshaping.
+void Module::ReshapeConnections( int* oldSizes )
+{
+	for ( int k = 0; k < mNumInConn; k++ )
+	{
+		if ( oldSizes[mModuleIndex] != mModuleSize || 
+			 oldSizes[mInConn[k].GetModuleIndex()] != mInConn[k].GetModuleSize() )
+			mInConn[k].Reshape();
+	}
 }
 
 
@@ -124,51 +284,28 @@ bail:
 // Routine to modify module sizes
 void Module::ResizeModule( int newsize, int node )
 {
-	// resize the R and V arrays
-	// we create a temporary array first to preserve data (i.e. delayed activations, potential)	
-	RUnit*	newR;
+	// the R and V arrays only need to be reallocated if the module outgrows 
+	// its capacity. R-node data (i.e. delayed activations, potential) is kept
+	RUnit	newR;
 	int		i, k;
 
-	// temporary array to hold old values
-	newR = new RUnit[mModuleSize];
-	// copy over old values
-	for ( i = 0; i < mModuleSize; i++ ) newR[i] = mR[i];
-
-	// reinitialize mR and mV arrays
-	delete[] mV;
-	delete[] mR;
-	mR = new RUnit[newsize];	
-	mV = new VUnit[newsize];
-	
-	// set parameters
-	for ( i = 0; i < newsize; i++ )
+	Reserve( newsize );
+	if ( node > kUndefined )  // close the gap left by the pruned node
 	{
-		mR[i].SetParameter( mParameters );
-		mV[i].SetParameter( mParameters );
+		for ( i = node; i < mModuleSize - 1; i++ ) mR[i] = mR[i+1];
 	}
-
-	// copy over saved data
-	if ( node > kUndefined )  // ignore data from pruned node
+	else // module is growing or no node is specified: new nodes start afresh
 	{
-		k = 0;
-		for ( i = 0; i < mModuleSize; i++ )
-		{
-			if ( i != node )
-			{
-				mR[k] = newR[i];
-				k++;
-			}
-		}
+		for ( i = mModuleSize; i < newsize; i++ ) mR[i] = newR;
 	}
-	else // module is growing or no node is specified
+	
+	// V-nodes are not kept: they are unclamped and reset in place
+	for ( i = 0; i < newsize; i++ )
 	{
-		if ( mModuleSize < newsize )
-			for ( i = 0; i < mModuleSize; i++ ) mR[i] = newR[i];
-		else
-			for ( i = 0; i < newsize; i++ ) mR[i] = newR[i];
+		mV[i].ClampUnit();
+		mV[i].Reset();
+		mV[i].SetParameter( mParameters );
 	}
-	// delete temporary array
-	delete[] newR;
 
 	// we need to adjust the weight matrices for incoming connections
 	int fromsize;
@@ -526,10 +663,14 @@ inline data_type Module::GetWeight( int inConIdx, int i, int j )
 }
 
 // next few statements won't compile if inlined in Module.h
+Connection*	Module::GetConnection( int idx ) { return &mInConn[idx]; }
 char*	Module::GetConnModuleName( int idx ) { return mInConn[idx].GetModuleName(); }
 int 	Module::GetConnType( int idx ) { return mInConn[idx].GetType(); }
 int 	Module::GetConnDelay( int idx ) { return mInConn[idx].GetDelay(); }
 void 	Module::CopyWeights( int idx, double** matrix ) { mInConn[idx].CopyWeights( matrix ); }
+int		Module::GetConnModuleSize( int idx ) { return mInConn[idx].GetModuleSize(); }
+void 	Module::CopyWeights( int idx, data_type* values ) { mInConn[idx].CopyWeights( values ); }
+void 	Module::SetWeights( int idx, const data_type* values ) { mInConn[idx].SetWeights( values ); }
 
 
 // returns sum of weight changes on all connections
@@ -553,7 +694,7 @@ void Module::SaveWeights( ofstream *outfile )
 }
 
 
-void Module::LoadWeights( ifstream *infile )
+void Module::LoadWeights( CALMTokenizer *infile )
 {
 	for ( int i = 0; i < mNumInConn; i++ )
 		mInConn[i].LoadWeights( infile );
@@ -588,27 +729,52 @@ void Module::SumActivationV( data_type &act_sum )
 }
 
 
-void Module::PrintActs( ostream* os, int format )
+// copy the activations for printing: V nodes, A node, R nodes and E node
+void Module::CopyActs( data_type* acts )
 {
 	int i;
-	int	spacing = (mModuleSize / 10) + 4;
 	
-	*os << GetModuleName() << endl;
-	if ( mModuleType == O_INP )	
+	for ( i = 0; i < mModuleSize; i++ )
+	{
+		acts[i] = mV[i].GetActivation();
+		acts[mModuleSize+1+i] = mR[i].GetActivation();
+	}
+	acts[mModuleSize] = mA.GetActivation();
+	acts[2*mModuleSize+1] = mE.GetActivation();
+}
+
+
+void Module::PrintActs( ostream* os, int format )
+{
+	CopyActs( mActs );
+	PrintActs( os, mModuleName, mModuleType, mModuleSize, mActs, format );
+}
+
+
+// print activations copied with CopyActs
+void Module::PrintActs( ostream* os, const char* name, int type, int size, const data_type* acts, int format )
+{
+	const data_type*	v = acts;
+	const data_type*	r = acts + size + 1;
+	int					i;
+	int					spacing = (size / 10) + 4;
+	
+	*os << name << endl;
+	if ( type == O_INP )	
 	{
 		if ( format & O_ACTASIS )
 		{
 			AdjustStream( *os, 3, 5, kLeft, true );
-			for ( i = 0;  i < mModuleSize; i++ )
-				*os << mR[i].GetActivation() << ' ';
+			for ( i = 0;  i < size; i++ )
+				*os << r[i] << ' ';
 			*os << endl;
 		}
 		else
 		{
-			for ( i = 0;  i < mModuleSize; i++ )
+			for ( i = 0;  i < size; i++ )
 			{
 				AdjustStream( *os, 0, 1, kLeft, false );
-				PrintRoundedValue( os, mR[i].GetActivation() );
+				PrintRoundedValue( os, r[i] );
 				*os << ' ';
 			}
 			*os << endl;
@@ -619,45 +785,60 @@ void Module::PrintActs( ostream* os, int format )
 		if ( format & O_ACTASIS )
 		{
 			AdjustStream( *os, 3, 5, kLeft, true );
-			for ( i = 0;  i < mModuleSize; i++ )
-				*os << mV[i].GetActivation() << '\t';
-			*os << mA.GetActivation() << endl;
-			for ( i = 0;  i < mModuleSize; i++ )
-				*os << mR[i].GetActivation() << '\t';
-			*os << mE.GetActivation() << endl;
+			for ( i = 0;  i < size; i++ )
+				*os << v[i] << '\t';
+			*os << v[size] << endl;
+			for ( i = 0;  i < size; i++ )
+				*os << r[i] << '\t';
+			*os << r[size] << endl;
 			*os << endl;
 		}
 		else
 		{
-			for ( i = 0;  i < mModuleSize; i++ )
+			for ( i = 0;  i < size; i++ )
 			{
 				AdjustStream( *os, 0, spacing, kLeft, false );
-				PrintRoundedValue( os, mV[i].GetActivation() );
+				PrintRoundedValue( os, v[i] );
 			}
 			AdjustStream( *os, 0, spacing, kLeft, false );
-			PrintRoundedValue( os, mA.GetActivation() );
+			PrintRoundedValue( os, v[size] );
 			*os << endl;
-			for ( i = 0;  i < mModuleSize; i++ )
+			for ( i = 0;  i < size; i++ )
 			{
 				AdjustStream( *os, 0, spacing, kLeft, false );
-				PrintRoundedValue( os, mR[i].GetActivation() );
+				PrintRoundedValue( os, r[i] );
 			}
 			AdjustStream( *os, 0, spacing, kLeft, false );
-			PrintRoundedValue( os, mE.GetActivation() );
+			PrintRoundedValue( os, r[size] );
 			*os << endl;
 		}	
 	}
 	SetStreamDefaults( *os );
 }
 
+// copy the potentials of the R-nodes for printing
+void Module::CopyPotentials( data_type* pots )
+{
+	for ( int i = 0; i < mModuleSize; i++ ) pots[i] = mR[i].GetPotential();
+}
+
+
 void Module::PrintPotentials( ostream* os )
+{
+	CopyPotentials( mActs );
+	PrintPotentials( os, mModuleName, mModuleSize, mActs );
+}
+
+
+// print potentials copied with CopyPotentials
+void Module::PrintPotentials( ostream* os, const char* name, int size, const data_type* pots )
 {
 	int i;
 
-	*os << GetModuleName() << endl;
+	*os << name << endl;
 	AdjustStream( *os, 3, 6, kLeft, true );
-	for ( i = 0;  i < mModuleSize; i++ )
-		*os <<  mR[i].GetPotential() << " ";
+	for ( i = 0;  i < size; i++ )
+		*os <<  pots[i] << " ";
 	*os << endl;
 	SetStreamDefaults( *os );
 }
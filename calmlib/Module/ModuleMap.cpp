@@ -9,26 +9,43 @@
 #include "ModuleMap.h"
 #include "Connection.h"
 
-ModuleMap::~ModuleMap()
-{
-	// delete the map weights
-	DisposeMatrix( mMapWeights, mModuleSize );
-}
-
-
 // Initialize the basic members of a module
 // Derived classes need to call this function before doing own Initialization routine
-void ModuleMap::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx )
+void ModuleMap::Initialize( int moduleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena )
 {
-	Module::Initialize( moduleSize, moduleName, pars, mtype, idx );
+	Module::Initialize( moduleSize, moduleName, pars, mtype, idx, arena );
 	// create the map weights matrix
-	mMapWeights = CreateMatrix( 0.0, moduleSize, moduleSize );
+	mMapWeights = mArena->NewMatrix( 0.0, moduleSize, moduleSize, kMemWeights );
+	mMapSize = moduleSize;
 	
 	// set the inhibition weights
 	SetInhibitionMap();
 }
 
 
+// Create a copy of this module, including the map weights
+Module* ModuleMap::Clone( data_type* pars, CALMArena* arena )
+{
+	ModuleMap* module = arena->New<ModuleMap>( 1, kMemModules );
+	module->CopyModule( this, pars, arena );
+	module->mMapWeights = arena->NewMatrix( 0.0, mModuleSize, mModuleSize, kMemWeights );
+	module->mMapSize = mModuleSize;
+	for ( int i = 0; i < mModuleSize; i++ )
+		for ( int j = 0; j < mModuleSize; j++ )
+			module->mMapWeights[i][j] = mMapWeights[i][j];
+	return module;
+}
+
+
+// the map weights count as weights
+void ModuleMap::CountMemory( size_t* bytes )
+{
+	Module::CountMemory( bytes, sizeof(ModuleMap) );
+	bytes[kMemWeights] += CALMArena::Aligned( mMapSize * sizeof(data_type*) );
+	bytes[kMemWeights] += CALMArena::Aligned( (size_t)mMapSize * mMapSize * sizeof(data_type) );
+}
+
+
 // Set the inhibition map of the V-node weights
 void ModuleMap::SetInhibitionMap( void )
 {
@@ -80,6 +80,28 @@ void RUnit::Potential( data_type act )
 }
 
 
+// append the state of the node to a snapshot
+void RUnit::Snapshot( CALMSnapshot* s )
+{
+	CALMUnit::Snapshot( s );
+	s->Put( &mActDelay, sizeof(data_type) );
+	s->Put( &mPotential, sizeof(data_type) );
+	s->Put( &mVCounter, sizeof(int) );
+	s->Put( &mClamped, sizeof(bool) );
+}
+
+
+// read back the state of the node, in the same order as written
+void RUnit::Restore( CALMSnapshot* s )
+{
+	CALMUnit::Restore( s );
+	s->Get( &mActDelay, sizeof(data_type) );
+	s->Get( &mPotential, sizeof(data_type) );
+	s->Get( &mVCounter, sizeof(int) );
+	s->Get( &mClamped, sizeof(bool) );
+}
+
+
 void RUnit::operator=( RUnit &source )
 {
 	if ( this == &source ) return;
@@ -11,6 +11,8 @@ Change History (most recent first):
 #define __ANALYSIS__
 
 #include <string.h>
+#include <atomic>
+#include <mutex>
 #include "CALM.h"		// the interface file to the CALM API Library
 #include "PGMImage.h"
 
@@ -24,12 +26,27 @@ struct rgb
 };
 
 
+// private data of a thread computing part of an image
+struct AnalysisWorker
+{
+	CALMNetwork*	network;	// copy of the trained network
+	data_type*		input;		// copy of the input pattern
+	data_type*		buffer;		// summed activations of one bifurcation column or phase plot
+	data_type***	pixels;		// RGB pixels of one phase plot
+	PGMImage*		image;		// for writing phase plots
+};
+
+
 class AnalysisTools
 {
 public:
 
 	AnalysisTools();
 	~AnalysisTools();
+
+		// number of threads used to compute images (defaults to number of cores)
+	inline void	SetNumThreads( int num ) { mNumThreads = Max( num, 1 ); }
+	inline int	GetNumThreads( void ) { return mNumThreads; }
 	
 	void	InitializeBoundaryMatrix( char const *mod, char const *inp, int xres, int yres, int iters );
 	void	MatrixBoundaryForOnline( int run, data_type* pat, char const *mod, char const *inp, int xres, int yres, int iters );
@@ -63,19 +80,29 @@ public:
 
 protected:
 
+	typedef void (AnalysisTools::*ItemFiller)( AnalysisWorker* worker, int item, int p, int q );
+
+	void	FillParallel( int numItems, ItemFiller fill, int p, int q, bool parallel );
+	void	FillItems( AnalysisWorker* worker, atomic<int>* nextItem, int numItems, ItemFiller fill, int p, int q );
 	void	FillBoundary( int p, int q );
+	void	FillBoundaryRow( AnalysisWorker* worker, int i, int p, int q );
 	void	FillBoundaryMatrix( int p, int q );
-	void	FillBifurcation( int p, data_type** maxmins );
+	void	FillBoundaryMatrixRow( AnalysisWorker* worker, int i, int p, int q );
+	void	FillBifurcation( int p );
+	void	FillBifurcationColumn( AnalysisWorker* worker, int j, int p, int q );
 	void	FillBifurcationClamp( data_type** maxmins, int outIdx, int unit );
-	bool	FillPhase( data_type x, int p, data_type rgbStep );
+	void	FillPhases( int p );
+	void	FillPhase( AnalysisWorker* worker, int x, int p, int q );
 	bool	FillPhaseClamp( data_type x, data_type rgbStep, int outIdx, int unit );
+	data_type**	NewPixels( data_type val, int rows, int cols );
+	void	DisposePixels( data_type** pixels, int rows, int cols );
 	void	ResetPixels( data_type*** pixels );
 	void	ResetPixels( data_type** pixels );
 	void	WriteMatrixToFile( data_type*** pixels );
 	void	WriteToFile( data_type*** pixels );
 	void	WriteToFile( data_type** pixels );
 	double	HuetoRGB( double m1, double m2, double h );
-	void	HSLtoRGB( int i, int j, data_type hue );
+	void	HSLtoRGB( data_type*** pixels, int i, int j, data_type hue );
 	
 	int				mPatIdx;		// index of input module to use
 	int				mModIdx;		// index of CALM module to use
@@ -85,6 +112,7 @@ protected:
 	data_type***	mRGBPixels;		// storage for RGB pixels
 	data_type**		mBifurcations;	// storage for bifurcation points
 	data_type*		mPhases;		// storage for phaseplots
+	data_type*		mPhaseValues;	// parameter values for which to make phaseplots
 	int				mXRes;			// horizontal resolution
 	int				mYRes;			// vertical resolution
 	data_type		mXStep;			// horizontal iterator
@@ -95,8 +123,10 @@ protected:
 	data_type		mPar;			// bifurcation or phase parameter: sets neighbour 
 									// input value to mPar
 	int				mTransients;	// iterations to skip for analysis
+	int				mNumThreads;	// number of threads computing an image
 	int				mIterations;	// number of iterations to use for analysis
 	PGMImage*		pgmImage;		// final image
+	mutex			mWriteLock;		// serializes writing of images from threads
 	char			mDirName[256];
 	char			mFileName[256];
 	char			mSuffix[32];
@@ -18,6 +18,12 @@ using namespace std;
 #include <stdio.h>
 
 #include "CALMNetwork.h"
+#include "CALMCheckpointWriter.h"
+#include "CALMLogWriter.h"
+#include "CALMResults.h"
+#include "CALMFlightRecorder.h"
+#include "CALMTrace.h"
+#include "CALMLatency.h"
 
 // Class definition for the CALM API. 
 class CALMAPI
@@ -29,9 +35,9 @@ public:
 
 		// create a log file
 	int 				OpenCALMLog( const char* logname );
-	inline void 		SetCALMLog( ofstream* log ) { mCALMLog = log; }
-	inline void 		SetCALMLog( ostream* log ) { mCALMLog = log; }
-	inline ostream*		GetCALMLog( void ) { return mCALMLog; }
+	inline void 		SetCALMLog( ofstream* log ) { SetCALMLog( (ostream*)log ); }
+	inline void 		SetCALMLog( ostream* log ) { if ( mLogWriter != NULL ) mLogWriter->SetStream( log ); mCALMLog = log; }
+	inline ostream*		GetCALMLog( void ) { return Log(); }
 	void				CloseCALMLog( void );	
 		// maintain different directories
 	int					CALMSetLogDirectory( char* dirname );
@@ -49,6 +55,11 @@ public:
 	int					CALMLoadPatterns( void );
 		// loads feedback patterns file
 	int 				CALMLoadFeedback( void );
+		// compiles loaded patterns and feedback to a binary file (.ptb), or maps
+		// one into memory. Mapped patterns are read-only.
+	int					CALMSaveBinaryPatterns( void );
+	int					CALMLoadBinaryPatterns( void );
+	int					CALMStreamPatterns( int window );
 		// loads parameter file
 	int					CALMLoadParameters( void );
 		// tell API that it will be used in online mode
@@ -66,9 +77,59 @@ public:
 	bool				CALMTest( int i, bool useNoise = false );
 		// for saving changes in either weights, total act, and/or learning rate
 	void				CALMSaveChanges( void );
+		// record winners, convergence times, weight changes, activation and learning rate
+		// of every module for each pattern in a binary results file (.res), or in NPY files
+	int					CALMOpenResults( char const* filename, bool npy = false );
+	int					CALMCloseResults( void );
+		// keep the activations of the last iterations of each pattern in memory and
+		// append them to "filename.fdr" when the pattern does not converge
+	int					CALMSetFlightRecorder( int numIterations, char const* filename );
+	void				CALMDumpFlightRecorder( void );
+		// count the cycles and calls of each phase of training and testing (activation,
+		// weights, swap, convergence check, resizing, output and file i/o) for each module,
+		// and if available, the instructions, cache misses and branch misses
+	void				CALMSetProfiling( bool on, bool counters = false );
+	inline void			CALMResetProfile( void ) { if ( mNetwork->GetProfiler() != NULL ) mNetwork->GetProfiler()->Clear(); }
+	inline void			CALMShowProfile( void ) { CALMShowProfile( Log() ); }
+	void				CALMShowProfile( ostream* os );
+	int					CALMSaveProfile( char const* filename );
+		// bytes in use by category (see CALMMemory.h) in the whole process, their peak,
+		// and the number of allocations and of reallocations when modules grow;
+		// CALMShowMemory adds what each module and connection takes now
+	inline size_t		CALMGetMemory( int category ) { return CALMMemory::GetBytes( category ); }
+	inline size_t		CALMGetMemory( void ) { return CALMMemory::GetBytes(); }
+	inline size_t		CALMGetPeakMemory( void ) { return CALMMemory::GetPeak(); }
+	inline void			CALMResetPeakMemory( void ) { CALMMemory::ResetPeaks(); }
+	size_t				CALMGetModuleMemory( int idx );
+	inline void			CALMShowMemory( void ) { CALMShowMemory( Log() ); }
+	inline void			CALMShowMemory( ostream* os ) { CALMMemory::Print( os, mNetwork ); }
+		// record a timeline of epochs, patterns, every "sampling" iterations, resizes,
+		// checkpoints and log output of all threads, written to "filename.trace.json"
+		// in the Chrome trace format when stopped or when the API is deleted
+	int					CALMStartTrace( char const* filename, int sampling = 1 );
+	int					CALMStopTrace( void );
+		// latency of the online calls in microseconds (see CALMLatency.h): "quantile" is 0.5
+		// for the median, 0.999 for the 99.9th percentile and 1 for the maximum
+	double				CALMGetLatency( int call, double quantile );
+	inline CALMLatency*	CALMGetLatency( int call ) { return mLatency + call; }
+	void				CALMResetLatency( void );
+	inline void			CALMShowLatency( void ) { CALMShowLatency( Log() ); }
+	inline void			CALMShowLatency( ostream* os ) { CALMLatency::Print( os, mLatency ); }
 		// saving/loading weights
 	void				CALMSaveWeights( char const* filename );
 	int					CALMLoadWeights( char const* filename );
+		// same in binary format (.wtb), which keeps exact values and loads without parsing
+	void				CALMSaveBinaryWeights( char const* filename );
+	int					CALMLoadBinaryWeights( char const* filename );
+	int					CALMSaveCheckpoint( char const* filename );
+	int					CALMLoadCheckpoint( char const* filename );
+		// write checkpoints in the background while training continues
+	void				CALMSaveCheckpointAsync( char const* filename, CALMCheckpointDone done = NULL, void* data = NULL );
+	int					CALMWaitCheckpoints( void );
+	void				CALMSetCheckpointBuffers( int numBuffers );
+		// convert between text (.wts) and binary (.wtb) weight files with the same base name
+	int					CALMWeightsToBinary( char const* filename );
+	int					CALMWeightsToText( char const* filename );
 
 //	INLINES	
 		// R-unit clamping routines, pass index "idx" of module, index "node" of R-unit, and 
@@ -82,7 +143,7 @@ public:
 	inline void			CALMResizeModule( int idx ){ mNetwork->ResizeModule( idx ); }
 	inline void			CALMResizeModule( int idx, int newsize ) { mNetwork->ResizeModule( idx, newsize ); }
 		// show module sizes
-	inline void			CALMShowSizes( void ) { mNetwork->PrintSizes( mCALMLog ); }
+	inline void			CALMShowSizes( void ) { mNetwork->PrintSizes( Log() ); }
 
 		// resets network: activations, weights, and/or winning nodes
 	inline void			CALMReset( int type ) { mNetwork->Reset( type ); }
@@ -90,28 +151,31 @@ public:
 	inline void			CALMReset( void ) { mNetwork->Reset(); }
 		// force update of time delay connections (TESTING only)
 	inline void			CALMUpdateTimeDelay( void ) { mNetwork->UpdateTimeDelay(); }
+		// store complete network state in a snapshot, or set it back
+	inline void			CALMTakeSnapshot( CALMSnapshot* snap ) { mNetwork->Snapshot( snap ); }
+	inline bool			CALMRestoreSnapshot( CALMSnapshot* snap ) { return mNetwork->Restore( snap ); }
 		// tools for recording weight changes
 	inline void			CALMResetWeightChangeSum( void ) { mNetwork->ResetWtChangeSum(); }
 	inline data_type	CALMGetWeightChangeSum( void ) { return mNetwork->GetWtChangeSum(); }
 	inline void			CALMSaveWeightChangesComment( char* text ) { if ( mVerbosity & O_SAVEDWT ) mNetwork->SaveWeightChangesComment( text ); }
 
 		// show module names
-	inline void			CALMShowModules( void ) { mNetwork->PrintModules( mCALMLog ); }
+	inline void			CALMShowModules( void ) { mNetwork->PrintModules( Log() ); }
 	inline void			CALMShowModules( ostream* os ) { mNetwork->PrintModules( os ); }
 
 		// show winning nodes at end of training, e.g, when verbosity is O_NONE
-	inline void			CALMShowWinners( void ) { mNetwork->PrintWinners( mCALMLog ); }
-	inline void			CALMShowOnlineWinners( void ) { mNetwork->PrintCurrentWinners( mCALMLog ); }
+	inline void			CALMShowWinners( void ) { mNetwork->PrintWinners( Log() ); }
+	inline void			CALMShowOnlineWinners( void ) { mNetwork->PrintCurrentWinners( Log() ); }
 	inline void			CALMShowWinners( ostream* os ) { mNetwork->PrintWinners( os ); }
 	inline void			CALMShowOnlineWinners( ostream* os ) { mNetwork->PrintCurrentWinners( os ); }
 
 		// show activations at end of training when verbosity is O_NONE
-	inline void			CALMShowActivations( int pat, int format, bool withInp ) { mNetwork->PrintActs( mCALMLog, pat, format, withInp ); }
+	inline void			CALMShowActivations( int pat, int format, bool withInp ) { mNetwork->PrintActs( Log(), pat, format, withInp ); }
 		// show weights at end of training when verbosity is O_NONE
-	inline void			CALMShowWeights( void ) { mNetwork->PrintWeights( mCALMLog ); }
+	inline void			CALMShowWeights( void ) { mNetwork->PrintWeights( Log() ); }
 		// show number of committed nodes and in case of maps
 		// whether the map is ordered
-	inline void			CALMShowCommitted( void ) { mNetwork->PrintCommitted( mCALMLog ); }
+	inline void			CALMShowCommitted( void ) { mNetwork->PrintCommitted( Log() ); }
 
 		// Get number of patterns
 	inline int			CALMNumPatterns( void ) { return mNetwork->GetNumPatterns(); }
@@ -149,6 +213,8 @@ public:
 	inline data_type	CALMGetPattern( int patIdx, int pIdx, int idx ){ return mNetwork->GetPattern( patIdx, pIdx, idx ); }
 		// retrieve feedback signal for selected pattern
 	inline int			CALMGetFeedback( int pIdx ){ return mNetwork->GetFeedback( pIdx ); }
+		// direct access to the network, e.g. to make private copies with Clone()
+	inline CALMNetwork*	CALMGetNetwork( void ) { return mNetwork; }
 		// Retrieve module index from module name
 	inline int			CALMGetModuleIndex( char const *mdlname ){ return mNetwork->GetModuleIndex( mdlname ); }
 		// Retrieve module size
@@ -173,17 +239,19 @@ public:
 	
 //	SETTERS
 		// Set the online input manually
-	inline void	CALMSetInput( void ){ mNetwork->SetInput( mInput ); }		
+	inline void	CALMSetInput( void ){ LATENCY_SCOPE( mLatency + kLatSetInput ); mNetwork->SetInput( mInput ); }		
 		// Set the online input manually
-	inline void	CALMSetInput( data_type* inp ){ mNetwork->SetInput( inp ); }		
+	inline void	CALMSetInput( data_type* inp ){ LATENCY_SCOPE( mLatency + kLatSetInput ); mNetwork->SetInput( inp ); }		
 		// To manually set a custom input pattern for given module
-	inline void	CALMSetInput( int mIdx, data_type* inp ){ mNetwork->SetInput( mIdx, inp ); }
+	inline void	CALMSetInput( int mIdx, data_type* inp ){ LATENCY_SCOPE( mLatency + kLatSetInput ); mNetwork->SetInput( mIdx, inp ); }
 		// To manually set a custom feedback message
 	inline void	CALMSetFeedback( int fb ){ mNetwork->SetOnlineFeedback( fb ); }
 		// set value of parameter
 	inline void CALMSetParameter( int identifier, data_type val ){ mNetwork->SetParameter( identifier, val ); }
 		// set verbosity
 	void		CALMSetVerbosity( int level );
+		// format activation output in the background
+	void		CALMSetAsyncLog( bool async );
 	inline void	CALMSetNumRuns( int runs ) { mNumRuns = runs; }
 	inline void	CALMSetNumEpochs( int epochs ) { mNumEpochs = epochs; }
 	inline void	CALMSetNumIterations( int iters ) { mNumIterations = iters; }
@@ -196,9 +264,17 @@ public:
 private:
 
 	int		CALMReadSpecs( char* newfilename );
+	size_t	SpecsMemory( ifstream* infile );
 	void	CALMSpeedTest( bool start );
 	int		ModuleType( char* typeStr );
 	int		ConnectionType( char* typeStr );
+	void	ShowActs( int epoch, int ite );
+	void	ShowPotentials( void );
+	void	ShowWeights( int epoch, int pIdx );
+	void	FlightRecord( int epoch, int ite );
+	void	FlightDump( int epoch, int pIdx );
+		// the log, once all background output is written
+	inline ostream*	Log( void ) { if ( mLogWriter != NULL ) mLogWriter->Flush(); return mCALMLog; }
 
 	ostream*  		mCALMLog;					// redirected cout
 	ofstream*		mLogFile;					// file buffer
@@ -222,6 +298,13 @@ private:
 	bool			mFBOn;			// whether supervised learning is being used (set internally)
 	
 	CALMNetwork*	mNetwork;	// pointer to associated network 
+	CALMCheckpointWriter* mCheckpointWriter;	// background checkpoint writer, once used
+	int				mCheckpointBuffers;	// number of checkpoints it holds in memory
+	CALMLogWriter*	mLogWriter;		// background activation output, if switched on
+	CALMResults*	mResults;		// results of each pattern, if recorded
+	CALMFlightRecorder*	mRecorder;	// activations of the last iterations, if kept
+	bool			mTracing;		// whether this API started the trace
+	CALMLatency*	mLatency;		// latency of each online call
 };
 
 #endif
@@ -0,0 +1,73 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	A debug check that training and testing do not allocate memory once
+					the network and patterns are set up. The loops declare an
+					ALLOC_GUARD; if CALM_ALLOC_CHECK is 1 (see CALMGlobal.h), the
+					library replaces operator new, and every allocation made on a
+					thread while it is inside a guard is reported on cerr with the
+					name of the guard, after which the program is aborted, unless
+					SetFatal( false ) was called. Code inside a guard that may allocate
+					on purpose, such as a trace buffer that fills up, declares an
+					ALLOC_ALLOW. The operator new of the library is weak, so a program
+					that replaces operator new itself keeps its own; it can pass every
+					allocation to Check to keep the check. Without CALM_ALLOC_CHECK,
+					the guards compile to nothing.
+*/
+
+
+#ifndef __CALMALLOCGUARD__
+#define __CALMALLOCGUARD__
+
+#include <stddef.h>
+#include <atomic>
+using namespace std;
+#include "CALMGlobal.h"
+
+
+class CALMAllocGuard
+{
+public:
+
+	inline CALMAllocGuard( const char* name ) { mOuter = sScope; sScope = name; }
+	inline ~CALMAllocGuard() { sScope = mOuter; }
+
+						// reports an allocation of "bytes" made inside a guard
+	static inline void	Check( size_t bytes ) { if ( sScope != NULL && sAllowed == 0 ) Violation( bytes ); }
+	static inline void	SetFatal( bool fatal ) { sFatal = fatal; }
+						// allocations made inside guards so far
+	static inline long	GetViolations( void ) { return sViolations.load( memory_order_relaxed ); }
+
+private:
+
+	friend class CALMAllocAllow;
+
+	static void			Violation( size_t bytes );
+
+	const char*			mOuter;		// the enclosing guard, if any
+
+	static thread_local const char*	sScope;		// innermost guard of this thread
+	static thread_local int			sAllowed;	// allowances within it
+	static atomic<long>				sViolations;
+	static bool						sFatal;
+};
+
+
+// lifts the guard, if any, until the end of the enclosing block
+class CALMAllocAllow
+{
+public:
+
+	inline CALMAllocAllow() { CALMAllocGuard::sAllowed++; }
+	inline ~CALMAllocAllow() { CALMAllocGuard::sAllowed--; }
+};
+
+#if CALM_ALLOC_CHECK
+	#define ALLOC_GUARD( name )		CALMAllocGuard allocGuard( name )
+	#define ALLOC_ALLOW()			CALMAllocAllow allocAllow
+#else
+	#define ALLOC_GUARD( name )
+	#define ALLOC_ALLOW()
+#endif
+
+#endif
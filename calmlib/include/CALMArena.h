@@ -0,0 +1,63 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Arena allocator for the memory of a network. Modules, nodes, connections 
+					and weights are placed one after the other in a few large blocks of 
+					memory, aligned to cache lines. Memory is never freed piecemeal: all 
+					blocks are released at once when the arena is deleted. Every
+					allocation is accounted for in a category of CALMMemory.
+*/
+
+
+#ifndef __CALMARENA__
+#define __CALMARENA__
+
+#include <new>
+#include <stddef.h>
+#include "CALMGlobal.h"
+#include "CALMMemory.h"
+
+#define kCacheLine		64			// alignment of every allocation
+#define kArenaChunk		65536		// default size of a block of memory
+
+
+class CALMArena
+{
+public:
+
+	CALMArena( size_t chunkSize );
+	~CALMArena();
+	
+		// bytes taken by an allocation, including alignment
+	static inline size_t Aligned( size_t bytes ) { return ( bytes + kCacheLine - 1 ) & ~(size_t)( kCacheLine - 1 ); }
+	
+	void*				Allocate( size_t bytes, int category );
+	
+		// allocate and construct an array of objects
+	template <class T>
+	T*					New( int num, int category )
+						{
+							T* obj = (T*)Allocate( num * sizeof(T), category );
+							for ( int i = 0; i < num; i++ ) new( obj + i ) T;
+							return obj;
+						}
+		// same as CreateMatrix, but with all rows in one block
+	data_type**			NewMatrix( data_type val, int row, int col, int category );
+	
+	inline size_t		GetUsed( void ) { return mUsed; }
+	inline size_t		GetReserved( void ) { return mReserved; }
+
+private:
+
+	void				NewChunk( size_t bytes );
+
+	size_t		mChunkSize;		// size of a new block of memory
+	char*		mChunks;		// linked list of blocks, most recent first
+	char*		mPos;			// next free byte in current block
+	char*		mEnd;			// end of current block
+	size_t		mUsed;			// bytes handed out
+	size_t		mReserved;		// bytes allocated from the system
+	size_t		mBytes[kNumMemCategories];	// bytes handed out in each category
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Writes checkpoints in the background. The training thread takes a
+					snapshot into one of a fixed number of buffers and continues, while
+					a writer thread saves the buffers to disk in order. If all buffers 
+					are still waiting to be written, taking the next snapshot waits for 
+					the oldest one, so memory use stays bounded.
+*/
+
+
+#ifndef __CALMCHECKPOINTWRITER__
+#define __CALMCHECKPOINTWRITER__
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CALMGlobal.h"
+#include "CALMSnapshot.h"
+
+#define kCheckpointBuffers	2	// default number of snapshots in flight
+
+class CALMNetwork;
+
+// called on the writer thread when a checkpoint has been written, or failed
+typedef void (*CALMCheckpointDone)( const char* filename, bool ok, void* data );
+
+// a checkpoint waiting to be written
+struct CALMCheckpointJob
+{
+	CALMSnapshot		snap;
+	char				filename[FILENAME_MAX];
+	CALMCheckpointDone	done;
+	void*				data;
+	bool				queued;		// taken, but not yet written
+};
+
+
+class CALMCheckpointWriter
+{
+public:
+
+	CALMCheckpointWriter( int numBuffers = kCheckpointBuffers );
+	~CALMCheckpointWriter();
+
+	void				Submit( CALMNetwork* network, const char* filename, CALMCheckpointDone done, void* data );
+	bool				Wait( void );
+
+private:
+
+	void				WriteBehind( void );
+
+	CALMCheckpointJob*	mJobs;			// ring of snapshot buffers
+	int					mNumJobs;
+	int					mNext;			// buffer for the next snapshot
+	int					mPending;		// number of checkpoints not yet written
+	bool				mFailed;		// a write failed since the last Wait
+
+	std::thread			mWriter;		// background thread writing checkpoints
+	std::mutex			mLock;
+	std::condition_variable	mSignal;
+	bool				mQuit;			// tells the writer thread to stop
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Keeps the activations of the last iterations in memory, as records
+					in the format of CALMLogWriter, in a fixed number of slots that are
+					reused in turn. Nothing is printed until the records are dumped, for
+					example when a pattern did not converge. A dump is appended to the
+					recorder's file, oldest iteration first, in the same text as
+					PrintActs with O_ACTASIS.
+*/
+
+
+#ifndef __CALMFLIGHTRECORDER__
+#define __CALMFLIGHTRECORDER__
+
+#include <fstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+
+class CALMFlightRecorder
+{
+public:
+
+	CALMFlightRecorder( int numSlots );
+	~CALMFlightRecorder();
+
+	bool				Open( const char* filename );
+	void				Reserve( size_t size );
+	char*				Next( size_t size );
+	inline void			Clear( void ) { mCount = 0; }
+	void				Dump( const char* reason );
+
+private:
+
+	char*				mSlots;			// the records
+	size_t				mSlotSize;		// bytes per record
+	int					mNumSlots;
+	int					mNext;			// slot for the next record
+	int					mCount;			// number of records held
+	ofstream			mFile;			// dumps are appended to this file
+};
+
+#endif
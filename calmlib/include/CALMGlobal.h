@@ -37,6 +37,29 @@
 // when printing out the winners. Set it to 1 if you want to know the convergence times
 #define PRINT_TIME 0
 
+// an identifier to compile in the counters of CALMProfiler, which count the cycles spent
+// in each phase of training and testing once switched on with CALMSetProfiling. Set it
+// to 0 (or pass -DCALM_PROFILE=0) to leave them out altogether
+#ifndef CALM_PROFILE
+	#define CALM_PROFILE 1
+#endif
+
+// the same for the timeline recorded by CALMTrace once started with CALMStartTrace
+#ifndef CALM_TRACE
+	#define CALM_TRACE 1
+#endif
+
+// and for the latency histograms of the online calls, kept by CALMLatency
+#ifndef CALM_LATENCY
+	#define CALM_LATENCY 1
+#endif
+
+// a debug identifier: set it to 1 when building the library to abort on any heap
+// allocation made while training or testing after setup (see CALMAllocGuard.h)
+#ifndef CALM_ALLOC_CHECK
+	#define CALM_ALLOC_CHECK 0
+#endif
+
 // Error codes for file loading: internal use only
 enum
 {
@@ -0,0 +1,111 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Histograms of the latency of the calls of the online API, in
+					nanoseconds, to find the percentiles and the maximum. As in HDR
+					histograms, every power of two is divided into kLatencySubBuckets
+					buckets of equal width, so a value is known to within 1/64 of
+					itself from 128 ns up to about 18 minutes, and exactly below. A
+					histogram is a fixed array, so recording never allocates. It is
+					filled by the thread that calls the API and may be read by any
+					other; Reset only raises a flag, and the buckets used are cleared
+					at the next call. Latencies are left out altogether if CALM_LATENCY
+					is 0 (see CALMGlobal.h).
+*/
+
+
+#ifndef __CALMLATENCY__
+#define __CALMLATENCY__
+
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+#define kLatencySubBits		6			// buckets per power of two: 2^kLatencySubBits
+#define kLatencySubBuckets	64
+#define kLatencyMaxBits		40			// longer latencies go in the last bucket
+#define kLatencyBuckets		( ( kLatencyMaxBits - kLatencySubBits + 2 ) * kLatencySubBuckets )
+
+// timed calls
+enum
+{
+	kLatTrainSingle = 0,	// CALMTrainSingle
+	kLatTestSingle,			// both CALMTestSingle
+	kLatTest,				// CALMTest, a single iteration
+	kLatSetInput,			// CALMSetInput
+	kLatLoadWeights,		// CALMLoadWeights and CALMLoadBinaryWeights
+	kLatSaveWeights,		// CALMSaveWeights and CALMSaveBinaryWeights
+	kNumLatencies
+};
+
+
+class CALMLatency
+{
+public:
+
+	CALMLatency();
+
+	void				Record( uint64_t ns );
+	inline void			Reset( void ) { mResetPending.store( true, memory_order_release ); }
+
+						// in nanoseconds; 0 if nothing was recorded since the last reset
+	uint64_t			GetCount( void );
+	uint64_t			GetMax( void );
+	uint64_t			GetMin( void );
+	double				GetMean( void );
+						// the smallest latency that "quantile" of the calls did not exceed,
+						// rounded up to the end of its bucket
+	uint64_t			GetPercentile( double quantile );
+
+	static const char*	CallName( int call );
+	static void			Print( ostream* os, CALMLatency* latency );
+
+	static inline uint64_t Now( void )
+	{
+		struct timespec t;
+
+		clock_gettime( CLOCK_MONOTONIC, &t );
+		return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+	}
+
+private:
+
+	static int			Bucket( uint64_t ns );
+	static uint64_t		BucketEnd( int bucket );
+	void				Clear( void );
+
+	atomic<uint64_t>	mCounts[kLatencyBuckets];
+	atomic<uint64_t>	mCount;			// calls recorded
+	atomic<uint64_t>	mSum;			// their total latency
+	atomic<uint64_t>	mMin;
+	atomic<uint64_t>	mMax;
+	atomic<bool>		mResetPending;	// cleared by the recording thread
+	int					mLow;			// range of the buckets used since the
+	int					mHigh;			// last clear, so only these are cleared
+};
+
+
+// Records the time until the end of the enclosing block in "latency"
+class CALMLatencyScope
+{
+public:
+
+	inline CALMLatencyScope( CALMLatency* latency ) { mLatency = latency; mStart = CALMLatency::Now(); }
+	inline ~CALMLatencyScope() { mLatency->Record( CALMLatency::Now() - mStart ); }
+
+private:
+
+	CALMLatency*		mLatency;
+	uint64_t			mStart;
+};
+
+#if CALM_LATENCY
+	#define LATENCY_SCOPE( latency )	CALMLatencyScope latencyScope( latency )
+#else
+	#define LATENCY_SCOPE( latency )
+#endif
+
+#endif
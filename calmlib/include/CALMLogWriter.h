@@ -0,0 +1,104 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Writes activation output in the background. The training thread
+					copies the activations of all modules as a compact binary record into
+					a ring buffer and continues, while a writer thread formats the records
+					into the log in order. The text is the same as that of PrintActs.
+					Potentials and weights, which are printed after every pattern, are
+					passed on the same way.
+					There is one producer, the thread running the network, and one
+					consumer. Records never wrap around the end of the buffer; the space
+					left at the end is skipped with a padding record instead.
+*/
+
+
+#ifndef __CALMLOGWRITER__
+#define __CALMLOGWRITER__
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <sstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+#define kLogBufferSize	(4<<20)		// default size of the ring buffer, a power of two
+#define kLogBatchSize	(64<<10)	// formatted text is written to the log in batches of this size
+
+// kinds of records
+enum
+{
+	kLogActs = 0,		// activations, as CALMNetwork::PrintActs
+	kLogPotentials,		// potentials of the R-nodes, as CALMNetwork::PrintPotentials
+	kLogWeights			// weights after a pattern, as CALMNetwork::PrintWeights
+};
+
+// header of each record in the ring buffer
+struct CALMLogRecord
+{
+	uint32_t	size;			// bytes up to the next record, a multiple of kCacheLine
+	int32_t		numModules;		// kUndefined for padding at the end of the buffer
+	int32_t		epoch;
+	int32_t		ite;			// iteration, or pattern index for weights
+	int32_t		format;			// verbosity flags used for printing
+	int32_t		kind;			// kLogActs, kLogPotentials or kLogWeights
+};
+
+// Follows the record header for each module, and is followed by the
+// module's activations: V nodes, A node, R nodes and E node, or by the
+// potentials of its R nodes. In weight records, it is followed by one
+// more for each incoming connection, with the name and size of the
+// sending module, and each of those by the weights, row after row.
+struct CALMLogModule
+{
+	char		name[32];
+	int32_t		type;
+	int32_t		size;
+	int32_t		numConn;		// connections that follow, in weight records
+	int32_t		padding;
+};
+
+
+class CALMLogWriter
+{
+public:
+
+	CALMLogWriter( ostream* os, size_t bufferSize = kLogBufferSize );
+	~CALMLogWriter();
+
+	char*				Reserve( size_t size );
+	void				Commit( void );
+	void				Flush( void );
+	void				SetStream( ostream* os );
+		// only use the stream directly after a Flush
+	inline ostream*		GetStream( void ) { return mStream; }
+
+	static void			PrintRecord( ostream* os, CALMLogRecord* record );
+
+private:
+
+	void				WriteBehind( void );
+	void				Format( CALMLogRecord* record );
+	void				WriteText( size_t end );
+
+	char*				mBuffer;		// the ring buffer
+	size_t				mSize;			// its size, a power of two
+	std::atomic<size_t>	mHead;			// end of the committed records
+	std::atomic<size_t>	mTail;			// end of the formatted records
+	std::atomic<size_t>	mWritten;		// end of the records written to the log
+	size_t				mReserved;		// end of the reserved record, not yet committed
+	ostream*			mStream;		// the log
+	ostringstream		mText;			// formatted records not yet written to the log
+
+	std::thread			mWriter;		// background thread formatting records
+	std::mutex			mLock;
+	std::condition_variable	mSignal;
+	std::atomic<bool>	mSleeping;		// the writer thread waits for records
+	bool				mQuit;			// tells the writer thread to stop
+};
+
+#endif
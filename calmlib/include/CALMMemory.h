@@ -0,0 +1,74 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Accounts for the memory taken by networks, patterns and images. The
+					counters are kept for the whole process, by category: the bytes in
+					use, their peak, and the number of allocations and of reallocations,
+					the moves to a larger block when a module or connection outgrows
+					its spare capacity. Memory in an arena counts as used until the
+					arena is deleted, including blocks left behind by reallocations.
+					Print adds, for a network, what each module and connection takes
+					now; the difference with the arena is the memory left behind.
+*/
+
+
+#ifndef __CALMMEMORY__
+#define __CALMMEMORY__
+
+#include <stddef.h>
+#include <atomic>
+#include <fstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+class CALMNetwork;
+
+// categories of memory
+enum
+{
+	kMemModules = 0,	// modules, the array of modules and the arrays of connections
+	kMemNodes,			// R- and V-nodes
+	kMemWeights,		// weight matrices of connections and maps
+	kMemWtAct,			// weighted activations kept by connections
+	kMemPatterns,		// patterns, pattern order and feedback lists
+	kMemWinners,		// winners and convergence times of each pattern
+	kMemImages,			// pixels of the images of AnalysisTools
+	kNumMemCategories
+};
+
+
+class CALMMemory
+{
+public:
+
+	static void				Allocated( int category, size_t bytes );
+	static void				Freed( int category, size_t bytes );
+	static inline void		Reallocated( int category ) { sReallocations[category].fetch_add( 1, memory_order_relaxed ); }
+							// the peaks start again from the current use
+	static void				ResetPeaks( void );
+
+	static inline size_t	GetBytes( int category ) { return sBytes[category].load( memory_order_relaxed ); }
+	static inline size_t	GetPeak( int category ) { return sPeak[category].load( memory_order_relaxed ); }
+	static inline size_t	GetAllocations( int category ) { return sAllocations[category].load( memory_order_relaxed ); }
+	static inline size_t	GetReallocations( int category ) { return sReallocations[category].load( memory_order_relaxed ); }
+	static inline size_t	GetBytes( void ) { return sTotal.load( memory_order_relaxed ); }
+	static inline size_t	GetPeak( void ) { return sTotalPeak.load( memory_order_relaxed ); }
+	static const char*		CategoryName( int category );
+
+							// the process, then "net", if not NULL, module by module
+	static void				Print( ostream* os, CALMNetwork* net );
+	static void				Save( ostream* os );
+
+private:
+
+	static void				Raise( atomic<size_t>* peak, size_t bytes );
+
+	static atomic<size_t>	sBytes[kNumMemCategories];
+	static atomic<size_t>	sPeak[kNumMemCategories];
+	static atomic<size_t>	sAllocations[kNumMemCategories];
+	static atomic<size_t>	sReallocations[kNumMemCategories];
+	static atomic<size_t>	sTotal;
+	static atomic<size_t>	sTotalPeak;
+};
+
+#endif
@@ -12,7 +12,15 @@ using namespace std;
 #include <string.h>
 #include "CALMPatterns.h"
 #include "Module.h"
+#include "CALMSnapshot.h"
 #include "GnuPlot.h"
+#include "CALMProfiler.h"
+#include "CALMAllocGuard.h"
+
+class CALMPatternFile;
+class CALMPatternStream;
+class CALMLogWriter;
+class CALMResults;
 
 class CALMNetwork 
 {   
@@ -21,16 +29,29 @@ public:
 	CALMNetwork();
 	~CALMNetwork();
 
+						// deep copy of modules, connections, weights and activations
+	CALMNetwork*		Clone( void );
+						// copy complete state to a flat buffer or set it back from one
+	void				Snapshot( CALMSnapshot* snap );
+	bool				Restore( CALMSnapshot* snap );
+						// bytes of a snapshot of this network with modules of the given sizes
+	size_t				SnapshotSize( const int* sizes );
+						// snapshot written to or read from a checkpoint file
+	bool				SaveCheckpoint( const char* filename );
+	bool				LoadCheckpoint( const char* filename );
+
 // CREATERS
 						// set number of modules and create array
-	void				SetNumModules( int numModules, int numInputs );
+	void				SetNumModules( int numModules, int numInputs, size_t memory = kArenaChunk );
+	static size_t		ModuleMemory( int calmType, int moduleSize, int numConn );
+	static size_t		ConnectionMemory( int toSize, int fromSize );
 	void 				SetNumConnections( int idx, int numConn );
 	void				ConnectModules( int idx, int toIdx, int fromIdx, int link, int delay );
 						// initializes each module
 	void				InitializeModule( int idx, int calmType, int moduleSize, char* moduleName );
 	
 // MODULE RESIZERS
-	void				ResizeModule( int idx, int newsize );
+	void				ResizeModule( int idx, int newsize, int node = kUndefined );
 	void				ResizeModule( int idx );
 	bool				ResizeModule( void );
 	
@@ -47,10 +68,14 @@ public:
 // PATTERNS
 	bool				LoadFeedback( const char* filename );
 	bool				LoadPatterns( const char* filename );
+	bool				LoadBinaryPatterns( const char* filename );
+	bool				SaveBinaryPatterns( const char* filename );
+	bool				StreamPatterns( const char* filename, int window );
 	void				OnlinePatterns( void );
 	void				PermutePatterns( void );
 	void				SetPatternOrder( int order );
 	inline int			GetPatternOrder( void ){ return mPatternOrder; }
+	int					PatternIndex( int pIdx );
 	
 // TRAINERS
 	void 				Learn( void );
@@ -63,6 +88,7 @@ public:
 	void				SetOnlineFeedback( int fb );
 	void				SetFeedback( int pIdx );
 	bool				CollectWinners( int patIdx, int ite );
+	void				RecordResults( CALMResults* results, int epoch, int pIdx, bool learning );
 	bool				CollectWinnersOnTheFly( int ite, int mIdx, int* convInfo );
 	inline void			SetWinner( int i, int j, int idx ) { mWinners[i][j] = idx; };
 	inline int			GetWinner( int i, int j ) { return mWinners[i][j]; };
@@ -88,6 +114,13 @@ public:
 	void				SaveMuChanges( void );
 	void				SaveWeights( char* filename );
 	bool				LoadWeights( char* filename );
+	void				SaveBinaryWeights( char* filename );
+	bool				LoadBinaryWeights( char* filename );
+
+// PROFILING
+						// counts cycles, and optionally hardware events, per phase and module
+	void				SetProfiling( bool on, bool counters = false );
+	inline CALMProfiler* GetProfiler( void ) { return mProfiler; }
 
 // MISC			
 	inline void			ClampUnit( int idx, int node, data_type val ) { mModules[idx]->ClampUnit( node, val ); }
@@ -104,15 +137,21 @@ public:
 	bool				WriteSpecs( char* filename );
 	const char*			GetTypeString( int modtype );
 	int					GetMaximumSize( void );
+	bool				HasDelayLinks( void );
 	void				PrintCommitted( ostream* os );
 	void				PrintModules( ostream* os );
 	void				PrintWinners( ostream* os );
 	void				PrintCurrentWinners( ostream* os );
 	void				PrintWeights( ostream* os, int epoch, int pIdx );
+	void				RecordWeights( CALMLogWriter* log, int epoch, int pIdx );
 	void				PrintWeights( ostream* os );
 	void				PrintActs( ostream* os, int epoch, int ite, int format, bool withInp );
 	void				PrintActs( ostream* os, int pat, int format, bool withInp );
+	void				RecordActs( CALMLogWriter* log, int epoch, int ite, int format, bool withInp );
+	size_t				ActsRecordSize( bool withInp );
+	void				FillActsRecord( char* pos, int epoch, int ite, int format, bool withInp );
 	void				PrintPotentials( ostream* os );
+	void				RecordPotentials( CALMLogWriter* log );
 	void				PrintSizes( ostream* os );
 	void				PrintPatterns( ostream* os );
 	void				PrintFeedback( ostream* os );
@@ -123,6 +162,8 @@ public:
 	inline int			GetNumInputs( void ) { return mNumInputModules; }
 	inline int			GetModuleSize( int idx ) { return mModules[idx]->GetModuleSize(); }
 	inline Module*		GetModule( int idx ) { return mModules[idx]; }
+	inline CALMArena*	GetArena( void ) { return mArena; }
+	void				CountMemory( int idx, size_t* bytes );
 	int 				GetModuleIndex( char const *mdlname );
 	inline data_type	GetModuleActivation( int idx, int i ) { return mModules[idx]->GetActivationR(i); }
 	inline int			GetNumPatterns( void ){ return mNumPatterns; }
@@ -136,20 +177,31 @@ public:
 	
 private:
 
+	void			DeletePatterns( void );
+	void			DeleteFeedback( void );
+	void			AllocateWinners( void );
+	inline size_t	WinnerMemory( void ) { return 2 * mNumModules * ( sizeof(int*) + mNumPatterns * sizeof(int) ); }
+
 	data_type		mWtChangeSum;			// sum of weight changes
 	data_type 		mParameters[gNumPars];	// array to hold the values
 	int   			mNumModules;			// number of modules
 	int				mNumInputModules;		// number of input modules
 	Module**		mModules;				// array of modules
+	CALMArena*		mArena;					// memory for modules, nodes and weights
+	CALMProfiler*	mProfiler;				// cycle counters, if profiling
 	char			mPatternFileName[256];	// name of loaded pattern file
 	CALMPatterns*	mPatternList;			// array of Patterns for each input module
+	CALMPatternFile* mPatternFile;			// mapped binary pattern file, if loaded
+	CALMPatternStream* mPatternStream;		// streamed binary pattern file, if loaded
 	int*			mFeedbackList;			// list of feedback data
+	size_t			mFeedbackMemory;		// its bytes, unless it is part of a mapped file
 	int				mFeedback;				// index of module designated to receive feedback
 	int				mNumPatterns;			// number of patterns
 	int				mPatternOrder;			// present patterns permuted or ordered
 	int*			mPermutations;			// permuted array of pattern indexes
 	int**			mWinners;				// store winners for each pattern and module
 	int**			mConvTimes;				// store time of convergence
+	CALMSnapshot	mCheckpoint;			// buffer for checkpoint files
 	ofstream		mWeightChangeFile;		// file to store changes in weights
 	ofstream		mActChangeFile;			// file to store changes in activation
 	ofstream		mMuChangeFile;			// file to store changes in learning rate
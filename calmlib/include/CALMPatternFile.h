@@ -0,0 +1,71 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Compiled binary pattern file. Holds the patterns of all input
+					modules and optionally the feedback list. The file is mapped into
+					memory when opened, and CALMPatterns serve the patterns straight from
+					the mapping. Processes using the same file share the same pages.
+*/
+
+
+#ifndef __CALMPATTERNFILE__
+#define __CALMPATTERNFILE__
+
+#include <stdint.h>
+#include "CALMGlobal.h"
+
+#define kPatternFileMagic	"CALMPTB"	// first bytes of every binary pattern file
+#define kPatternFileVersion	1			// increase when the layout changes
+
+// header at the start of the file
+struct CALMPatternHeader
+{
+	char		magic[8];			// kPatternFileMagic
+	uint32_t	version;			// kPatternFileVersion
+	uint32_t	valueSize;			// sizeof(data_type) of the patterns
+	uint32_t	numModules;			// number of input modules
+	uint32_t	numPatterns;		// number of patterns for each input module
+	uint32_t	hasFeedback;		// 1 if the file holds a feedback list
+	uint32_t	reserved;
+	uint64_t	feedbackOffset;		// position of the feedback list in the file
+};
+
+// index entry for the patterns of one input module
+struct CALMPatternBlock
+{
+	int32_t		moduleSize;			// number of values per pattern
+	int32_t		reserved;
+	uint64_t	offset;				// position of the patterns in the file
+};
+
+
+class CALMPatternFile
+{
+public:
+
+	CALMPatternFile();
+	~CALMPatternFile();
+
+	bool					Open( const char* filename );
+	void					Close( void );
+
+	inline int				GetNumModules( void ) { return mHeader->numModules; }
+	inline int				GetNumPatterns( void ) { return mHeader->numPatterns; }
+	inline int				GetModuleSize( int idx ) { return mBlocks[idx].moduleSize; }
+	inline bool				HasFeedback( void ) { return mHeader->hasFeedback != 0; }
+		// the mapping is read-only
+	inline data_type*		GetPatterns( int idx ) { return (data_type*)( mData + mBlocks[idx].offset ); }
+	inline int*				GetFeedback( void ) { return (int*)( mData + mHeader->feedbackOffset ); }
+
+	static bool				Save( const char* filename, int numModules, int numPatterns,
+								  int* moduleSizes, data_type** patterns, int* feedback );
+
+private:
+
+	char*					mData;		// the mapped file
+	size_t					mSize;		// size of the file
+	CALMPatternHeader*		mHeader;	// header at the start of the file
+	CALMPatternBlock*		mBlocks;	// index following the header
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Streams patterns from a binary pattern file (see CALMPatternFile.h)
+					that may be larger than memory. Patterns are read in blocks, with
+					two block buffers: while the network works on one block, a background
+					thread reads the next one. In permuted order, the order of the blocks
+					is shuffled and so are the patterns within each block; a last block
+					that is not full stays last.
+*/
+
+
+#ifndef __CALMPATTERNSTREAM__
+#define __CALMPATTERNSTREAM__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CALMGlobal.h"
+#include "CALMPatternFile.h"
+
+
+class CALMPatternStream
+{
+public:
+
+	CALMPatternStream();
+	~CALMPatternStream();
+
+	bool				Open( const char* filename, int window );
+	void				Close( void );
+	void				SetOrder( int order );
+	void				Permute( void );
+
+		// access by presentation index, i.e. the position in the current order
+	inline data_type*	GetPattern( int mIdx, int pIdx ) { int k = Seek( pIdx ); return mPatterns[mCurrent][mIdx] + (size_t)k * mModuleSizes[mIdx]; }
+	inline int			GetFeedback( int pIdx ) { int k = Seek( pIdx ); return mFeedback[mCurrent][k]; }
+	inline int			GetIndex( int pIdx ) { int k = Seek( pIdx ); return mBlockOrder[pIdx/mBlockSize] * mBlockSize + k; }
+
+	inline int			GetNumModules( void ) { return mNumModules; }
+	inline int			GetModuleSize( int idx ) { return mModuleSizes[idx]; }
+	inline int			GetNumPatterns( void ) { return mNumPatterns; }
+	inline bool			HasFeedback( void ) { return mHasFeedback; }
+		// bytes taken by the two block buffers
+	size_t				GetMemory( void );
+
+private:
+
+	int					Seek( int pIdx );
+	void				SwitchBlock( int block );
+	void				ReadBlock( int slot, int block );
+	void				Prefetch( int block );
+	void				WaitIdle( void );
+	void				ReadAhead( void );
+
+	int					mFile;				// file descriptor of the pattern file
+	int					mNumModules;		// number of input modules
+	int					mNumPatterns;		// number of patterns in the file
+	int*				mModuleSizes;		// size of each input module
+	size_t*				mOffsets;			// position of each module's patterns in the file
+	bool				mHasFeedback;		// the file holds a feedback list
+	size_t				mFeedbackOffset;	// position of the feedback list in the file
+
+	bool				mShuffled;			// present in permuted order
+	int					mBlockSize;			// number of patterns in a block
+	int					mNumBlocks;			// number of blocks in the file
+	int*				mBlockOrder;		// file block presented at each position
+	int*				mInBlock;			// order of patterns within the current block
+	unsigned int		mSeed;				// seed for shuffling within blocks
+	int					mPosition;			// position of the current block in the order
+
+	data_type**			mPatterns[2];		// two block buffers for each input module
+	int*				mFeedback[2];		// feedback list for each block buffer
+	int					mBlock[2];			// file block held in each buffer
+	int					mCurrent;			// buffer the network works on
+
+	std::thread			mReader;			// background thread reading ahead
+	std::mutex			mLock;
+	std::condition_variable	mSignal;
+	int					mRequest;			// file block to read ahead, or kUndefined
+	int					mRequestSlot;		// buffer to read it into
+	bool				mBusy;				// a read ahead is in progress
+	bool				mQuit;				// tells the reader thread to stop
+};
+
+#endif
@@ -12,35 +12,41 @@
 
 #include	<fstream>
 using namespace std;
+#include	"CALMTokenizer.h"
 
 class CALMPatterns
 {
 
 public:
 
-	CALMPatterns(){ mModuleSize = 0; mNumPatterns = 0; }
+	CALMPatterns(){ mPatterns = NULL; mModuleSize = 0; mNumPatterns = 0; mMapped = false; }
 
 	~CALMPatterns(){ DeletePatterns(); }
 	
 	// Loading/Deleting/Resetting
-	void	LoadPatterns( ifstream* infile, int numPatterns, int moduleSize );
+	void	LoadPatterns( CALMTokenizer* infile, int numPatterns, int moduleSize );
+	void	MapPatterns( data_type* patterns, int numPatterns, int moduleSize );
 	void	DeletePatterns( void );
 	
 	// Display function
 	void	Print( ostream *os );
 	
 	// Accessor functions
-	inline data_type*	GetPattern( int i ) { return (data_type*)mPatterns[i]; }
-	inline data_type	GetPattern( int i, int j ) { return mPatterns[i][j]; }	
+	inline data_type*	GetPattern( int i ) { return mPatterns + (size_t)i * mModuleSize; }
+	inline data_type	GetPattern( int i, int j ) { return mPatterns[(size_t)i * mModuleSize + j]; }	
+	inline data_type*	GetPatterns( void ) { return mPatterns; }
 	inline int			GetNumPatterns( void ) { return mNumPatterns; }
+		// bytes allocated for the patterns; a mapped file is not counted
+	inline size_t		GetMemory( void ) { return mMapped ? 0 : (size_t)mNumPatterns * mModuleSize * sizeof(data_type); }
 
 	friend ostream &operator<<( ostream &os, CALMPatterns &m );
 	
 protected:
 
-	data_type**		mPatterns;
+	data_type*		mPatterns;		// all patterns, one after the other
 	int				mNumPatterns;
 	int				mModuleSize;
+	bool			mMapped;		// patterns are served from a mapped file
 };
 
 #endif
@@ -0,0 +1,168 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Counts the cycles spent in each phase of training and testing, and
+					the number of times each phase ran, for every module and for the
+					network as a whole. The counters are read from the time stamp
+					counter of the processor where there is one, and from the monotonic
+					clock in nanoseconds elsewhere. On Linux, a group of hardware
+					counters (cycles, instructions, cache misses and branch misses of
+					this thread) can be read around each phase as well, if the kernel
+					allows it; inside containers and virtual machines it often does
+					not, in which case only the cycles are counted. The activation
+					phase consists mostly of Connection::WeightedActivation and
+					CALMUnit::Update, the weight phase of Connection::UpdateNormal.
+					A profiler is only created once profiling is switched on; code
+					that is profiled declares a PROFILE_SCOPE, which does nothing
+					while the profiler is NULL and is left out altogether if
+					CALM_PROFILE is 0 (see CALMGlobal.h).
+*/
+
+
+#ifndef __CALMPROFILER__
+#define __CALMPROFILER__
+
+#include <time.h>
+#include <fstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+class CALMNetwork;
+
+// profiled phases
+enum
+{
+	kProfActivation = 0,	// Module::UpdateActivation and UpdateActivationTest
+	kProfWeights,			// Module::UpdateWeights
+	kProfSwap,				// Module::SwapActs
+	kProfConvCheck,			// Module::ConvCheck
+	kProfResize,			// growing and pruning modules
+	kProfOutput,			// printing and recording while training and testing
+	kProfIO,				// loading and saving patterns, weights and checkpoints
+	kProfTrainFile,			// CALMTrainFile, including the phases above
+	kProfTestFile,			// CALMTestFile, including the phases above
+	kNumProfPhases
+};
+
+// hardware counters, read as a group with perf_event_open
+enum
+{
+	kHWCycles = 0,
+	kHWInstructions,
+	kHWCacheMisses,
+	kHWBranchMisses,
+	kNumHWCounters
+};
+
+typedef unsigned long long	CALMCycles;
+
+
+class CALMProfiler
+{
+public:
+
+	CALMProfiler( int numModules );
+	~CALMProfiler();
+
+						// the counters are cleared when the number of modules changes
+	void				SetNumModules( int numModules );
+	void				Clear( void );
+
+						// module "idx", or kUndefined for the network as a whole
+	inline void			Add( int phase, int idx, CALMCycles start )
+						{
+							int c = phase * mNumSlots + idx + 1;
+							mCycles[c] += Cycles() - start;
+							mCalls[c]++;
+						}
+	inline CALMCycles	GetCycles( int phase, int idx ) { return mCycles[phase * mNumSlots + idx + 1]; }
+	inline CALMCycles	GetCalls( int phase, int idx ) { return mCalls[phase * mNumSlots + idx + 1]; }
+	CALMCycles			GetCycles( int phase );
+	CALMCycles			GetCalls( int phase );
+
+						// hardware counters: false, with the reason printed, if unavailable
+	bool				OpenCounters( void );
+	void				CloseCounters( void );
+	inline bool			HasCounters( void ) { return mGroup != kUndefined; }
+	inline bool			HasCounter( int counter ) { return mPosition[counter] != kUndefined; }
+	void				ReadCounters( CALMCycles* values );
+	void				AddCounters( int phase, int idx, CALMCycles* start );
+	inline CALMCycles	GetCounter( int phase, int idx, int counter ) { return mHW[( phase * mNumSlots + idx + 1 ) * kNumHWCounters + counter]; }
+	CALMCycles			GetCounter( int phase, int counter );
+	static const char*	CounterName( int counter );
+	double				CyclesPerSecond( void );
+	static const char*	PhaseName( int phase );
+
+	void				Print( ostream* os, CALMNetwork* net );
+	bool				Save( const char* filename, CALMNetwork* net );
+
+	static inline CALMCycles Cycles( void )
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		struct timespec t;
+
+		clock_gettime( CLOCK_MONOTONIC, &t );
+		return (CALMCycles)t.tv_sec * 1000000000ull + t.tv_nsec;
+#endif
+	}
+
+private:
+
+	const char*			ModuleName( CALMNetwork* net, int idx );
+	void				PrintCounters( char* line, CALMCycles* values );
+
+	CALMCycles*			mCycles;		// cycles of each phase and slot
+	CALMCycles*			mCalls;			// calls of each phase and slot
+	int					mNumSlots;		// the network, then each module
+	CALMCycles			mStartCycles;	// counter and clock at the last Clear,
+	struct timespec		mStartTime;		// to convert cycles to seconds
+	CALMCycles*			mHW;			// hardware counters of each phase and slot
+	int					mGroup;			// the group leader, or kUndefined without counters
+	int					mFds[kNumHWCounters];		// each counter, or kUndefined
+	int					mPosition[kNumHWCounters];	// its value in a group read, or kUndefined
+	int					mNumOpen;		// counters in the group
+};
+
+
+// Adds the cycles until the end of the enclosing block to "phase" of module "idx"
+class CALMProfileScope
+{
+public:
+
+	inline CALMProfileScope( CALMProfiler* prof, int phase, int idx )
+	{
+		mProfiler = prof;
+		mPhase = phase;
+		mIdx = idx;
+		if ( prof != NULL && prof->HasCounters() ) prof->ReadCounters( mCounters );
+		mStart = ( prof != NULL ) ? CALMProfiler::Cycles() : 0;
+	}
+	inline ~CALMProfileScope()
+	{
+		if ( mProfiler == NULL ) return;
+		mProfiler->Add( mPhase, mIdx, mStart );
+		if ( mProfiler->HasCounters() ) mProfiler->AddCounters( mPhase, mIdx, mCounters );
+	}
+
+private:
+
+	CALMProfiler*		mProfiler;
+	int					mPhase;
+	int					mIdx;
+	CALMCycles			mStart;
+	CALMCycles			mCounters[kNumHWCounters];	// hardware counters at the start
+};
+
+#if CALM_PROFILE
+	#define PROFILE_SCOPE( prof, phase, idx )	CALMProfileScope profScope( prof, phase, idx )
+#else
+	#define PROFILE_SCOPE( prof, phase, idx )
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Binary store for the results of a run. For every pattern presented,
+					one row per CALM module holds the epoch, pattern, module, winning node,
+					convergence time, sum of weight changes, total activation and learning
+					rate. Rows are collected in memory column by column and appended to
+					the file in chunks. A results file (.res) holds a header followed by
+					the chunks, each with the number of rows and then every column in turn.
+					Alternatively, each column goes to its own NPY file, which numpy can
+					load or map directly.
+*/
+
+
+#ifndef __CALMRESULTS__
+#define __CALMRESULTS__
+
+#include <stdint.h>
+#include <fstream>
+using namespace std;
+#include "CALMGlobal.h"
+
+#define kResultsMagic		"CALMRES"	// first bytes of every results file
+#define kResultsVersion		1			// increase when the layout changes
+#define kResultsChunk		65536		// number of rows collected before writing
+
+// columns of the results, integer columns first
+enum
+{
+	kResEpoch = 0,
+	kResPattern,
+	kResModule,
+	kResWinner,			// kNoWinner if the module did not converge
+	kResConvTime,
+	kResWtChange,		// sum of weight changes in the whole network for this pattern
+	kResActivation,		// total activation of the module
+	kResLearningRate,	// learning rate of the module
+	kNumResColumns
+};
+
+#define kNumResIntColumns	kResWtChange
+
+// header at the start of a results file
+struct CALMResultsHeader
+{
+	char		magic[8];			// kResultsMagic
+	uint32_t	version;			// kResultsVersion
+	uint32_t	valueSize;			// sizeof(data_type) of the value columns
+	uint32_t	numColumns;			// kNumResColumns
+	uint32_t	reserved;
+};
+
+// start of each chunk in a results file
+struct CALMResultsChunk
+{
+	uint32_t	numRows;
+	uint32_t	reserved;
+};
+
+
+class CALMResults
+{
+public:
+
+	CALMResults();
+	~CALMResults();
+
+	bool				Open( const char* filename, bool npy );
+	bool				Close( void );
+	inline bool			IsOpen( void ) { return mFiles[0] != NULL; }
+
+	inline void			Append( int epoch, int pattern, int module, int winner, int convTime,
+								data_type wtChange, data_type act, data_type mu )
+						{
+							mInts[kResEpoch][mNumRows] = epoch;
+							mInts[kResPattern][mNumRows] = pattern;
+							mInts[kResModule][mNumRows] = module;
+							mInts[kResWinner][mNumRows] = winner;
+							mInts[kResConvTime][mNumRows] = convTime;
+							mValues[kResWtChange-kNumResIntColumns][mNumRows] = wtChange;
+							mValues[kResActivation-kNumResIntColumns][mNumRows] = act;
+							mValues[kResLearningRate-kNumResIntColumns][mNumRows] = mu;
+							if ( ++mNumRows == kResultsChunk ) WriteChunk();
+						}
+
+	static const char*	GetColumnName( int col );
+
+private:
+
+	void				WriteChunk( void );
+	void				WriteNPYHeader( ofstream* file, int col );
+
+	int32_t*			mInts[kNumResIntColumns];					// rows not yet written
+	data_type*			mValues[kNumResColumns-kNumResIntColumns];
+	int					mNumRows;		// number of rows not yet written
+	uint64_t			mTotalRows;		// number of rows in the file(s)
+	bool				mNPY;			// one NPY file per column
+	ofstream*			mFiles[kNumResColumns];		// only the first one without NPY
+	char				mFilename[FILENAME_MAX];
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Flat buffer holding the complete state of a network at one moment:
+					weights, node activations, time delays, potentials, winners and 
+					random number generator. Filled by CALMNetwork::Snapshot and read 
+					back by CALMNetwork::Restore. The buffer is kept between snapshots,
+					so taking snapshots repeatedly does not allocate memory. Written to
+					a file, a snapshot serves as a checkpoint to resume training from.
+*/
+
+
+#ifndef __CALMSNAPSHOT__
+#define __CALMSNAPSHOT__
+
+#include <stdint.h>
+#include <string.h>
+#include "CALMGlobal.h"
+
+#define kCheckpointMagic	"CALMCKP"	// first bytes of every checkpoint file
+#define kCheckpointVersion	1			// increase when the snapshot layout changes
+
+// header at the start of a checkpoint file, followed by the snapshot
+struct CALMCheckpointHeader
+{
+	char		magic[8];			// kCheckpointMagic
+	uint32_t	version;			// kCheckpointVersion
+	uint32_t	valueSize;			// sizeof(data_type) of the snapshot
+	uint64_t	size;				// number of bytes in the snapshot
+};
+
+
+class CALMSnapshot
+{
+public:
+
+	CALMSnapshot();
+	~CALMSnapshot();
+
+		// start writing a new snapshot, or reading the current one
+	inline void		Clear( void ) { mSize = 0; mPos = 0; }
+	inline void		Rewind( void ) { mPos = 0; }
+
+		// append data to the buffer or read it back in the same order
+	inline void		Put( const void* data, size_t len )
+					{
+						if ( mSize + len > mCapacity ) Reserve( mSize + len );
+						memcpy( mData + mSize, data, len );
+						mSize += len;
+					}
+	inline void		Get( void* data, size_t len )
+					{
+						// a snapshot read from file may be shorter than expected
+						if ( mPos + len > mSize ) { memset( data, 0, len ); mPos = mSize + 1; return; }
+						memcpy( data, mData + mPos, len );
+						mPos += len;
+					}
+	inline void		PutInt( int val ) { Put( &val, sizeof(int) ); }
+	inline int		GetInt( void ) { int val; Get( &val, sizeof(int) ); return val; }
+
+	void			Reserve( size_t capacity );
+		// exchange the buffers of two snapshots
+	void			Swap( CALMSnapshot* other );
+	inline char*	GetData( void ) { return mData; }
+	inline size_t	GetSize( void ) { return mSize; }
+		// true if everything was read back, and no more
+	inline bool		AtEnd( void ) { return mPos == mSize; }
+
+		// write the snapshot to a checkpoint file, or read one
+	bool			Save( const char* filename, bool sync = false );
+	bool			Load( const char* filename );
+	
+private:
+
+	bool			WriteAll( int fd, const char* data, size_t len );
+	bool			ReadAll( int fd, char* data, size_t len );
+
+	char*		mData;		// the state of the network
+	size_t		mSize;		// number of bytes in use
+	size_t		mCapacity;	// number of bytes allocated
+	size_t		mPos;		// read position
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Tokenizer for the text pattern, feedback, parameter and weight files.
+					The whole file is read into memory at once and numbers are parsed
+					straight from the buffer. As with SkipComments, anything from a '#'
+					at the start of a token up to the end of the line is ignored.
+*/
+
+
+#ifndef __CALMTOKENIZER__
+#define __CALMTOKENIZER__
+
+#include <stddef.h>
+#include "CALMGlobal.h"
+
+
+class CALMTokenizer
+{
+public:
+
+	CALMTokenizer();
+	~CALMTokenizer();
+
+	bool				Open( const char* filename );
+	void				Close( void );
+
+		// read the next number. On failure, "value" is set to 0.
+	bool				Read( int& value );
+	bool				Read( data_type& value );
+
+	void				SkipComments( void );
+	void				SkipLines( const char* starts );
+	inline bool			AtEnd( void ) { SkipComments(); return mPos >= mEnd; }
+
+private:
+
+	char*				mBuffer;	// contents of the file, terminated with a 0
+	const char*			mPos;		// current position in the buffer
+	const char*			mEnd;		// end of the contents
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Records a timeline of a run, for viewing in chrome://tracing or
+					Perfetto. Code that is traced declares a TRACE_SCOPE, which records
+					a begin event and, at the end of the enclosing block, an end event.
+					Every thread records into a buffer of its own, so threads never
+					wait for each other; the buffers are written out as one file in
+					the Chrome JSON trace format when the trace is stopped. Stop the
+					trace while the background threads are idle, for example after
+					CALMWaitCheckpoints. Tracing is left out altogether if CALM_TRACE
+					is 0 (see CALMGlobal.h).
+*/
+
+
+#ifndef __CALMTRACE__
+#define __CALMTRACE__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+using namespace std;
+#include "CALMGlobal.h"
+
+#define kTraceChunk		16384		// events per chunk of a thread's buffer
+#define kTraceChunks	1024		// chunks per thread, after which events are dropped
+
+struct CALMTraceEvent
+{
+	const char*		name;		// a string constant
+	int64_t			time;		// nanoseconds since the start of the trace
+	int32_t			arg;		// shown as "n", unless kUndefined
+	char			phase;		// 'B' or 'E'
+};
+
+// the events of one thread
+struct CALMTraceBuffer
+{
+	CALMTraceEvent*		chunks[kTraceChunks];
+	atomic<size_t>		count;		// events recorded
+	size_t				dropped;	// events that did not fit
+	int					tid;		// thread number in the trace
+	char				name[32];	// thread name in the trace
+	bool				retired;	// its thread has finished
+	CALMTraceBuffer*	next;
+};
+
+
+class CALMTrace
+{
+public:
+
+						// "sampling" traces every so many iterations of a pattern, or none if 0
+	static bool			Start( const char* filename, int sampling = 1 );
+	static bool			Stop( void );
+	static inline bool	IsOn( void ) { return sOn.load( memory_order_relaxed ); }
+	static inline bool	Sampled( int ite ) { return sSampling > 0 && ite % sSampling == 0; }
+	static void			SetThreadName( const char* name );
+	static void			Record( char phase, const char* name, int arg );
+
+private:
+
+	friend struct CALMTraceThread;
+
+	static CALMTraceBuffer*	ThisThread( void );
+	static int64_t			Now( void );
+
+	static atomic<bool>		sOn;
+	static int				sSampling;
+	static int64_t			sStart;			// monotonic clock at Start, in nanoseconds
+	static char				sFileName[FILENAME_MAX];
+	static CALMTraceBuffer*	sBuffers;		// buffers of all threads so far
+	static int				sNumThreads;
+	static mutex			sLock;			// guards the list of buffers
+};
+
+
+// Records a span from here to the end of the enclosing block. Nothing is
+// recorded if "name" is NULL.
+class CALMTraceScope
+{
+public:
+
+	inline CALMTraceScope( const char* name, int arg )
+	{
+		mName = CALMTrace::IsOn() ? name : NULL;
+		if ( mName != NULL ) CALMTrace::Record( 'B', mName, arg );
+	}
+	inline ~CALMTraceScope() { if ( mName != NULL ) CALMTrace::Record( 'E', mName, kUndefined ); }
+
+private:
+
+	const char*			mName;
+};
+
+#if CALM_TRACE
+	#define TRACE_SCOPE( name, arg )	CALMTraceScope traceScope( name, arg )
+	#define TRACE_THREAD( name )		CALMTrace::SetThreadName( name )
+#else
+	#define TRACE_SCOPE( name, arg )
+	#define TRACE_THREAD( name )
+#endif
+
+#endif
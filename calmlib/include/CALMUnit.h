@@ -7,6 +7,8 @@
 #ifndef __CALMUNIT__
 #define __CALMUNIT__
 
+#include "CALMSnapshot.h"
+
 class CALMUnit 
 {
 
@@ -21,6 +23,9 @@ public:
 	inline void			Swap( void ) { mActCurrent = mActNew; }
 	inline data_type 	GetActivation( void ) { return mActCurrent; }
 	inline void			SetParameter( data_type* pars ) { mParameters = pars; }
+	inline void			Snapshot( CALMSnapshot* s ) { s->Put( &mActCurrent, sizeof(data_type) ); s->Put( &mActNew, sizeof(data_type) ); }
+	inline void			Restore( CALMSnapshot* s ) { s->Get( &mActCurrent, sizeof(data_type) ); s->Get( &mActNew, sizeof(data_type) ); }
+	static inline size_t	SnapshotSize( void ) { return 2 * sizeof(data_type); }
 	
 protected:
 
@@ -8,6 +8,7 @@
 #ifndef __CALMWEIGHT__
 #define __CALMWEIGHT__
 
+#include <type_traits>
 #include "CALMGlobal.h"
 
 
@@ -18,7 +19,7 @@ public:
 
 	CALMWeight() { mWeightValue = 0.0; mWeightChange = 0.0; mClamped = false; }
 	CALMWeight( data_type resetValue ) { mWeightValue = resetValue; mWeightChange = 0.0; mClamped = false; }
-	~CALMWeight() {}
+	~CALMWeight() = default;
 	
 	// Reset function. Either default or with supplied reset value
 	inline void			Reset( data_type resetValue ) { mWeightValue = resetValue; mWeightChange = 0.0; }
@@ -33,7 +34,9 @@ public:
 	inline void			SetWeight( data_type newWeight ) { mWeightValue = newWeight; }
 	inline bool			IsClamped( void ) { return mClamped; }
 	
-	void operator=(CALMWeight &source);
+	// no assignment operator, destructor or virtual functions: weights are trivially
+	// copyable, so rows of weights can be copied with memcpy when cloning or taking
+	// snapshots (see the assertion below)
 	
 private:
 	
@@ -44,4 +47,6 @@ private:
 	bool				mClamped;
 };
 
+static_assert( std::is_trivially_copyable<CALMWeight>::value, "CALMWeight is copied with memcpy" );
+
 #endif
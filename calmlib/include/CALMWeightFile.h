@@ -0,0 +1,71 @@
+/*
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-2015 Adriaan Tijsseling. All rights reserved.
+	Description:	Binary weight file. The file starts with a header and an index
+					with one entry per connection, followed by the weights of each
+					connection as a row-major block of data_type values. The file is
+					mapped into memory when opened, so the weights of any connection
+					can be read directly without parsing.
+*/
+
+
+#ifndef __CALMWEIGHTFILE__
+#define __CALMWEIGHTFILE__
+
+#include <stdint.h>
+#include "CALMGlobal.h"
+
+#define kWeightFileMagic	"CALMWTB"	// first bytes of every binary weight file
+#define kWeightFileVersion	1			// increase when the layout changes
+
+// header at the start of the file
+struct CALMWeightHeader
+{
+	char		magic[8];			// kWeightFileMagic
+	uint32_t	version;			// kWeightFileVersion
+	uint32_t	valueSize;			// sizeof(data_type) of the weights
+	uint32_t	numBlocks;			// number of connections in the index
+	uint32_t	reserved;
+};
+
+// index entry for the weights of one connection
+struct CALMWeightBlock
+{
+	char		toModule[32];		// name of the receiving module
+	char		fromModule[32];		// name of the sending module
+	int32_t		link;				// index of the connection in the receiving module
+	int32_t		rows;				// size of the receiving module
+	int32_t		cols;				// size of the sending module
+	int32_t		reserved;
+	uint64_t	offset;				// position of the weights in the file
+};
+
+
+class CALMWeightFile
+{
+public:
+
+	CALMWeightFile();
+	~CALMWeightFile();
+
+	bool				Open( const char* filename );
+	void				Close( void );
+	CALMWeightBlock*	FindBlock( const char* toModule, const char* fromModule, int link );
+
+	inline int				GetNumBlocks( void ) { return mHeader->numBlocks; }
+	inline CALMWeightBlock*	GetBlock( int idx ) { return mBlocks + idx; }
+	inline const data_type*	GetWeights( CALMWeightBlock* block ) { return (const data_type*)( mData + block->offset ); }
+
+	static bool			Save( const char* filename, int numBlocks, CALMWeightBlock* blocks, data_type* weights );
+	static bool			TextToBinary( const char* textname, const char* binname );
+	static bool			BinaryToText( const char* binname, const char* textname );
+
+private:
+
+	char*				mData;		// the mapped file
+	size_t				mSize;		// size of the file
+	CALMWeightHeader*	mHeader;	// header at the start of the file
+	CALMWeightBlock*	mBlocks;	// index following the header
+};
+
+#endif
@@ -10,16 +10,25 @@
 #include "CALMWeight.h"
 #include "Module.h"
 
+#define kWeightStride	4	// rows of weights are padded to a multiple of this
+
 
 class Connection
 {
 
 public:
 
-	Connection() {}
-	~Connection();
+	Connection() { mRows = 0; mStride = 0; }
+	~Connection() {}	// all memory is owned by the network's arena
 	
-	void 		Initialize( Module* inModule, int* toSize, int linkType, int delay, data_type* pars );
+	void 		Initialize( Module* inModule, int* toSize, int linkType, int delay, data_type* pars, CALMArena* arena );
+	void		Copy( Connection& source, Module* inModule, int* toSize, data_type* pars, CALMArena* arena );
+	void		Reshape( void );
+	void		Reserve( int rows, int cols );
+	void		CountMemory( size_t* bytes );
+	void		Snapshot( CALMSnapshot* s );
+	void		Restore( CALMSnapshot* s );
+	size_t		SnapshotSize( int fromSize, int toSize );
 	void		ResizeConnection( int fromsize, int tosize, int node, int direction );
 	void		Reset( data_type );
 	void		Reset( int );
@@ -38,9 +47,12 @@ public:
 	void		SumWeightChanges( data_type &dw_sum );
 	
 	void		CopyWeights( double** matrix );
+	void		CopyWeights( data_type* values );
+	void		SetWeights( const data_type* values );
 	void		SaveWeights( ofstream *outfile );
-	void		LoadWeights( ifstream *outfile );
+	void		LoadWeights( CALMTokenizer *infile );
 	void 		Print( ostream *os );	
+	static void	PrintWeights( ostream* os, const char* name, int rows, int cols, const data_type* values );
 	
 	inline void			SetWeight( int i, int j, data_type dw ) { mWeights[i][j].SetWeight( dw, mParameters[K_Lmax], mParameters[K_Lmin] ); }
 	inline data_type	GetWeight( int i, int j ) { return mWeights[i][j].GetWeight(); }	
@@ -53,6 +65,8 @@ public:
 	inline int			GetDelay( void ) { return mDelay; }
 	inline int			GetType( void ) { return mType; }
 	inline void			SetType( int linkType ) { mType = linkType; }
+	
+	static inline int	Stride( int cols ) { return ( cols + kWeightStride - 1 ) / kWeightStride * kWeightStride; }
 
 	friend ostream &operator<<( ostream &os, Connection &c );
 
@@ -66,12 +80,17 @@ protected:
 	int*			mToSize;		// number of R-nodes in to-Module
 	Module*			mInModule;		// from-Module
 	CALMWeight**	mWeights;		// weights on this connection
+	int				mRows;			// number of rows allocated
+	int				mStride;		// number of weights allocated per row
 	int				mType;			// normal or time-delay connection
 	// for time delay
 	int				mDelay;			// delay of connection
 	int				mTime;			// current time (in updates)
 	data_type*		mWtAct;			// local copy of weighted activation
 	data_type*		mParameters;	// pointer to Network's storage of parameters
+	CALMArena*		mArena;			// network's memory for weights
+	
+	CALMWeight**	NewWeights( int rows, int cols );
 };
 
 #endif
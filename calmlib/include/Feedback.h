@@ -18,7 +18,12 @@ public:
 	Feedback() { mModuleSize = 0; mNumInConn = 0; mModuleType = O_FB; mFeedback = 0; }
 	~Feedback() {}
 	
-	void 		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx );
+	void 		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena );
+	Module*		Clone( data_type* pars, CALMArena* arena );
+	void		Snapshot( CALMSnapshot* s );
+	void		Restore( CALMSnapshot* s );
+	inline size_t	SnapshotSize( const int* sizes ) { return Module::SnapshotSize( sizes ) + sizeof(int); }
+	inline void	CountMemory( size_t* bytes ) { Module::CountMemory( bytes, sizeof(Feedback) ); }
 	void		UpdateActivation( void );
 	void		UpdateWeights( data_type &dw_sum );
 
@@ -3,6 +3,12 @@
 	Modifications by:	Adriaan Tijsseling (AGT)
 	Copyright: 			(c) Copyright 2003 MECHwA Team. All rights reserved.
 	Description:		online plotting routines using GNUPlot. Supports 3D plots.
+						The values to plot are copied into a frame and passed to a
+						plotting thread, which talks to gnuplot. Only every n-th call
+						produces a frame, and if the plotting thread is still busy
+						with earlier frames, new ones are dropped, so a slow gnuplot
+						never holds up the simulation. Without gnuplot, each frame
+						is written to the data file "name.dat" instead.
 */
 
 #ifndef _GNUPLOT_H_
@@ -11,38 +17,93 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CALMGlobal.h"
 
-class GnuPlot 
+#define kPlotFrames		2		// frames waiting for the plotting thread
+#define kPlotEvery2D	10		// default decimation of the 2d plot
+
+enum
+{
+	kPlotLines = 0,		// one or more lines of values
+	kPlotMatrix = 1		// 3d display of a matrix
+};
+
+// values to plot, copied from the simulation
+struct GnuPlotFrame
+{
+	data_type*	data;
+	int			capacity;
+	int			kind;			// kPlotLines or kPlotMatrix
+	int			rows;			// number of lines, or rows of the matrix
+	int			cols;			// values per line, or columns of the matrix
+	bool		range;			// set the y range to [min:max]
+	double		min;
+	double		max;
+};
+
+class GnuPlot
 {
 
 public:
 	// Constructor and destructor
-	GnuPlot() {}   
-	GnuPlot( int, int, int, int );
-	GnuPlot( int, int );
+	GnuPlot( int, int, int, int, const char* name = "plot" );
+	GnuPlot( int, int, const char* name = "plot3d" );
 	~GnuPlot();
-	
+
 	// Functions
 	void resizePlot( int r, int c );
+	inline void setDecimation( int every ) { mEvery = ( every > 0 ) ? every : 1; }
+	inline int getDropped( void ) { return mDropped; }
 
 	void plot( double val );
 	void plot( double*, int );
 	void plot( double*, double*, int );
+
+	// 3d plot: fill the matrix returned by getFrame, row after row, and
+	// pass it on with plot(). Returns NULL if this frame is skipped.
+	data_type* getFrame( void );
 	void plot( void );
 
-	inline double**	GetMatrix( void ) { return mMatrix; }
-	
 private:
+	GnuPlotFrame* acquire( int kind, int rows, int cols );
+	void submit( void );
+	void run( void );
+	void openPipe( void );
+	void draw( GnuPlotFrame* frame );
+	void save( GnuPlotFrame* frame );
+
 	int			mBounds;
 	int			mCounter;
-	FILE*		mGnuPipe;
 	double*		mBuffer;
-	double**     mMatrix;
 	double		mMax;
 	double		mMin;
+	int			mXMin;
+	int			mXMax;
+	int			mYMin;
+	int			mYMax;
 	int			mRows;
 	int			mCols;
+	int			mEvery;			// produce a frame every mEvery calls
+	int			mCalls;
+	int			mDropped;		// frames dropped because the plotting thread was busy
+	GnuPlotFrame*	mPending;	// frame being filled
+	char		mName[FILENAME_MAX];
+
+	// owned by the plotting thread
+	FILE*		mGnuPipe;		// NULL if gnuplot is not available
+	int			mDrawnRows;		// size of the last matrix drawn
+	int			mDrawnCols;
 
+	GnuPlotFrame	mFrames[kPlotFrames];
+	int			mFirst;			// oldest frame waiting
+	int			mQueued;		// number of frames waiting, or being drawn
+	std::thread	mPlotter;
+	std::mutex	mLock;
+	std::condition_variable mSignal;
+	bool		mQuit;
 };
 
 #endif
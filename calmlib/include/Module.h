@@ -15,6 +15,8 @@ using namespace std;
 #include "EUnit.h"
 #include "RUnit.h"
 #include "VUnit.h"
+#include "CALMArena.h"
+#include "CALMTokenizer.h"
 
 class Connection;
 
@@ -24,10 +26,18 @@ class Module
 	
 public:
 
-	Module( ) { mModuleSize = 0; mNumInConn = 0; mModuleType = O_CALM; mModuleIndex = kUndefined; }
-	~Module();
+	Module( ) { mModuleSize = 0; mCapacity = 0; mNumInConn = 0; mModuleType = O_CALM; mModuleIndex = kUndefined; }
+	virtual ~Module() {}	// all memory is owned by the network's arena
 	
-	virtual void		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx );
+	virtual void		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena );
+	virtual Module*		Clone( data_type* pars, CALMArena* arena );
+	void				CopyConnections( Module* source, Module** modules );
+	virtual void		Snapshot( CALMSnapshot* s );
+	virtual void		Restore( CALMSnapshot* s );
+						// bytes that Snapshot writes if the modules have the given sizes
+	virtual size_t		SnapshotSize( const int* sizes );
+	void				Reshape( int newsize );
+	void				ReshapeConnections( int* oldSizes );
 	void				Connect( int idx, Module* fromModule, int link, int delay );
 	bool				NeedsResizing( int* node );
 	void				ResizeModule( int newsize, int node );
@@ -55,12 +65,19 @@ public:
 	void				SumActivationV( data_type &act_sum );
 	
 	void				PrintWeights( ostream* os );
+	void				CopyActs( data_type* acts );
 	void				PrintActs( ostream* os, int format );
+	static void			PrintActs( ostream* os, const char* name, int type, int size, const data_type* acts, int format );
+	void				CopyPotentials( data_type* pots );
 	void				PrintPotentials( ostream* os );
+	static void			PrintPotentials( ostream* os, const char* name, int size, const data_type* pots );
 	void				PrintSizes( ostream* os );
+		// add the memory of the module, its nodes and incoming connections to "bytes",
+		// by category of CALMMemory
+	virtual void		CountMemory( size_t* bytes );
 	virtual void 		Print( ostream *os );
 	void				SaveWeights( ofstream *outfile );
-	void				LoadWeights( ifstream *infile );
+	void				LoadWeights( CALMTokenizer *infile );
 	
 	inline int			GetModuleIndex( void ) { return mModuleIndex; }	
 	inline int			GetModuleType( void ) { return mModuleType; }
@@ -77,10 +94,14 @@ public:
 	virtual data_type	GetWeight( int inConIdx, int i, int j );
 	inline data_type	GetLearningRate( void ) { return mMu; }
 	
+	Connection*			GetConnection( int idx );
 	char*				GetConnModuleName( int idx );
 	int					GetConnType( int idx );
 	int					GetConnDelay( int idx );
+	int					GetConnModuleSize( int idx );
 	void				CopyWeights( int idx, double** matrix );
+	void				CopyWeights( int idx, data_type* values );
+	void				SetWeights( int idx, const data_type* values );
 
 	void				SetNumConn( int numInConn );
 	inline void			SetWinner( int idx ) { mWinner = idx; }
@@ -90,10 +111,15 @@ public:
 	
 protected:
 
+	void				CopyModule( Module* source, data_type* pars, CALMArena* arena );
+	void				Reserve( int size );
+	void				CountMemory( size_t* bytes, size_t objectSize );
+
 	int			mModuleIndex;		// reference index of this module
 	int			mModuleType;		// type of module
 	char		mModuleName[32];	// name of this module
 	int			mModuleSize;		// number of RV-pairs in the module
+	int			mCapacity;			// number of RV-pairs allocated
 	int			mNumInConn;			// number of incoming connections
 	Connection*	mInConn;			// array of incoming connections
 	int			mWinner;			// winning RV-pair
@@ -102,8 +128,10 @@ protected:
 	VUnit*		mV;					// array of V-nodes
 	AUnit		mA;					// A-node
 	EUnit		mE;					// E-node
+	data_type*	mActs;				// room for CopyActs and CopyPotentials, used when printing
 	data_type	mMu;				// copy of current learning rate
 	data_type*	mParameters;		// pointer to Network's storage of parameters
+	CALMArena*	mArena;				// network's memory for nodes and connections
 };
 
 #endif
@@ -15,11 +15,13 @@ class ModuleMap : public Module
 {
 public:
 
-	ModuleMap() { mModuleSize = 0; mNumInConn = 0; mModuleType = O_MAP; }
-	~ModuleMap();
+	ModuleMap() { mModuleSize = 0; mNumInConn = 0; mModuleType = O_MAP; mMapSize = 0; }
+	~ModuleMap() {}
 	
-	void 		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx );
+	void 		Initialize( int mModuleSize, char* moduleName, data_type* pars, int mtype, int idx, CALMArena* arena );
+	Module*		Clone( data_type* pars, CALMArena* arena );
 	void		SetInhibitionMap( void );
+	void		CountMemory( size_t* bytes );
 	void		UpdateActivation( void );
 	void		UpdateActivationTest( void );
 	void		ConvCheck( int t, int* winner, int* convtime );
@@ -27,6 +29,7 @@ public:
 protected:
 
 	data_type**		mMapWeights;	// matrix holding the V-weights
+	int				mMapSize;		// its rows and columns
 };
 
 #endif
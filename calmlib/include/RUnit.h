@@ -34,6 +34,9 @@ public:
 		
 	inline data_type 	GetDelayAct( void ) { return mActDelay; }
 	inline void			SetDelayAct( void ) { mActDelay = mActCurrent; }
+	void				Snapshot( CALMSnapshot* s );
+	void				Restore( CALMSnapshot* s );
+	static inline size_t	SnapshotSize( void ) { return CALMUnit::SnapshotSize() + 2 * sizeof(data_type) + sizeof(int) + sizeof(bool); }
 
 	void operator=(RUnit &source);
 	
@@ -4,8 +4,15 @@
 	Description:	API interface for Sequence Learning Network
 */
 
+#define kIntegerRNGMax		2147483647	// largest value returned by IntegerRNG
+#define kRandomStateSize	36			// number of ints in the state of the generators
+
 float	PseudoRNG( float low, float high );
 float	PseudoRNG( float range );
 float	PseudoRNG( void );
+int		IntegerRNG( void );
+void	SeedIntegerRNG( unsigned int seed );
 void	SetSeed( long );
 long	GetSeed( void );
+void	GetRandomState( int* state );
+void	SetRandomState( int* state );
@@ -23,6 +23,9 @@ public:
 	void			ClampUnit( data_type val );
 	inline void		ClampUnit( void ) { mClamped = false; }
 	inline bool		IsClamped( void ) { return mClamped; }
+	inline void		Snapshot( CALMSnapshot* s ) { CALMUnit::Snapshot( s ); s->Put( &mClamped, sizeof(bool) ); }
+	inline void		Restore( CALMSnapshot* s ) { CALMUnit::Restore( s ); s->Get( &mClamped, sizeof(bool) ); }
+	static inline size_t	SnapshotSize( void ) { return CALMUnit::SnapshotSize() + sizeof(bool); }
 
 protected:
 
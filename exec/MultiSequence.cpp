@@ -7,11 +7,14 @@
 
 #include "MultiSequence.h"
 #include "Rnd.h"
+#include "CALMTokenizer.h"
 
 #define FEEDBACK		1	// set whether to use feedback for training
 #define GROWING		1	// set whether to grow/prune modules
 #define GROWCHECK	5	// number of epochs after which the network is checked for resizing
 #define PLOT3D		1	// plot with GNUPlot (needs X11 server to be running)
+#define CHECKPOINT	0	// set whether to write checkpoints in the background
+#define CKPCHECK	10	// number of epochs after which a checkpoint is written
 
 extern CALMAPI* gCALMAPI;		// pointer to API interface
 
@@ -49,7 +52,7 @@ int	MultiSequence::LoadPatternFiles( void )
 	int 		err = kNoErr;
 	char		filename[256];
 	char		stridx[5];
-	ifstream	infile;
+	CALMTokenizer	infile;
 	int		numBits = gCALMAPI->CALMGetInputLen(); // make sure CALMOnlinePatterns was called earlier
 	
 	cerr << "input len is " << numBits << endl;
@@ -66,28 +69,23 @@ int	MultiSequence::LoadPatternFiles( void )
 		strcat( filename, stridx );
 		strcat( filename, ".pat" );
 	// open the file
-		infile.open( filename );
-		if ( infile.fail() )
+		if ( ! infile.Open( filename ) )
 		{
 			FileOpenError( filename );
 			return kCALMFileError;
 		}
 	// read the number of patterns
-		SkipComments( &infile );
-		infile >> mNumPats[i];
+		infile.Read( mNumPats[i] );
 	// create storage for this file
 		mPatterns[i] = CreateMatrix( 0.0, mNumPats[i], numBits );
 	// read in each pattern
 		for ( j = 0; j < mNumPats[i]; j++ )
 		{
 			for ( k = 0; k < numBits; k++ )
-			{
-				SkipComments( &infile );
-				infile >> mPatterns[i][j][k];
-			}
+				infile.Read( mPatterns[i][j][k] );
 		}
 	// close and return
-		infile.close();
+		infile.Close();
 	}
 
 	return err;
@@ -249,6 +247,10 @@ bool MultiSequence::RunMultiSequenceSimulation( void )
 		#endif
 		}
 	#endif
+	#if CHECKPOINT
+		// the checkpoint is written while training goes on
+		if ( totalEpochs % CKPCHECK == 0 ) gCALMAPI->CALMSaveCheckpointAsync( "multi" );
+	#endif
 	}
 
 bail: